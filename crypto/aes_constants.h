@@ -4,6 +4,8 @@
 #include <cstdint>
 #include <cstddef>
 
+#include "block_cipher_constants.h"
+
 namespace crypto::aes {
 
     /**
@@ -31,7 +33,7 @@ namespace crypto::aes {
      * @param x
      * @return
      */
-    static inline uint_fast32_t GF2(uint_fast32_t x) {
+    AES_CPP17_INLINE static constexpr uint_fast32_t GF2(uint_fast32_t x) {
         return (x << 1u)           //implicitly removes high bit because 8-bit, (so * 0x1b and not 0x11b)
                ^                  //xor
                (((x >> 7u) & 1u)    // arithmetic right shift, thus shifting in either zeros or ones
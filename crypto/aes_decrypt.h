@@ -2,7 +2,9 @@
 #define AES_CPP17_AES_DECRYPT_H
 
 #include <array>
+#include <utility>
 
+#include "aes_encrypt.h"
 #include "aes_reverse_constants.h"
 
 namespace crypto::aes {
@@ -11,6 +13,7 @@ namespace crypto::aes {
      * @brief AES block cipher algorithm implementation available choices are AES128, AES192, AES256.
      * The implementation is verified against the test vectors in:
      * National Institute of Standards and Technology Special Publication 800-38A 2001 ED
+     * Like encrypt, constexpr throughout.
      * @tparam R number of round keys needed (AES-256 default 15)
      * @tparam N length of the key in 32-bit words (AES-256 default 8)
      * @tparam T 8-bit type (default uint8_t) manipulating 8-bit bytes obviates the need to handle endianness across platforms.
@@ -39,9 +42,9 @@ namespace crypto::aes {
         constexpr static size_t K = N * 4;
 
         /**
-         * XK as the length of the expanded key in 8-bit bytes.
+         * XK as the length of the expanded key in 8-bit bytes - R round keys of a block each.
          */
-        constexpr static size_t XK = R * N * 2;
+        constexpr static size_t XK = R * BLOCK_SIZE;
 
         using key_t = std::array<T, K>;
         using expanded_key_t = std::array<T, XK>;
@@ -50,14 +53,36 @@ namespace crypto::aes {
 
         using value_type = T;
 
+        template<class Sequence, typename = enable_if_key_t<Sequence, decrypt, encrypt<R, N, T>>>
+        constexpr explicit decrypt(Sequence &&seq) noexcept;
+
+        /**
+         * @brief derive the schedule from the encrypt schedule of the same key - the straight inverse cipher runs the
+         * encrypt round keys backwards, so this is a copy rather than a second key expansion
+         * @param e
+         */
+        constexpr explicit decrypt(const encrypt<R, N, T> &e) noexcept: xkey(e.xkey) {
+            make_inverse_key();
+        }
+
+        //copying or moving is a copy of the expanded key, there is nothing to re-expand
+        decrypt(const decrypt&) = default;
+        decrypt(decrypt&&) noexcept = default;
+        decrypt& operator=(const decrypt&) = default;
+        decrypt& operator=(decrypt&&) noexcept = default;
+
+        /**
+         * @brief re-expand a new key in place, so a pooled cipher can rotate keys without being reconstructed
+         * @tparam Sequence
+         * @param seq the new key
+         */
         template<class Sequence>
-        explicit decrypt(Sequence&& seq) noexcept;
+        constexpr void rekey(const Sequence &seq) noexcept;
 
-        //Constructor accepting a forwarding reference can hide copy and move constructors
-        decrypt(const decrypt&) = delete;
-        decrypt(decrypt&&) = delete;
-        decrypt& operator=(const decrypt&) = delete;
-        decrypt& operator=(decrypt&&) = delete;
+        constexpr void rekey(const encrypt<R, N, T> &e) noexcept {
+            xkey = e.xkey;
+            make_inverse_key();
+        }
 
         /**
          * @brief Encrypt a 16 byte block of plaintext using the session key material
@@ -65,31 +90,65 @@ namespace crypto::aes {
          * @return 16 byte block of ciphertext
          */
         template<typename Iterator>
-        void block(Iterator i);
+        constexpr void block(Iterator i) const;
 
         /**
          * @brief retrieve this block cipher's block_size
          * @return size_t
          */
-        inline static size_t block_size();
+        constexpr static size_t block_size();
+
+        /**
+         * @brief the R round keys back to back in encryption order, for kernels that run the rounds themselves
+         * @note each round key is BLOCK_SIZE aligned
+         * @return const T*
+         */
+        constexpr const T* round_keys() const {
+            return xkey.data();
+        }
+
+        /**
+         * @brief the equivalent inverse cipher schedule (FIPS-197 5.3.5) that AESDEC runs: the round keys in reverse
+         * with InvMixColumns applied to all but the first and last, derived once at key setup
+         * @note each round key is BLOCK_SIZE aligned
+         * @return const T*
+         */
+        constexpr const T* inverse_round_keys() const {
+            return ixkey.data();
+        }
 
     private:
 
         /**
-         * GF add (XOR) the round key to the block in reverse order _decreasing_ the round - 16
-         * @note *has side effects* but saves time consuming multiplications
-         * @param rkey reference to the round key offset
+         * GF add (XOR) round key _ROUND_ to the block, its offset in to the expanded key is a constant
+         * @tparam ROUND
          * @param block
          */
-        template<typename Iterator>
-        inline void inv_round_key(size_t &rkey, Iterator i);
+        template<size_t ROUND, typename Iterator>
+        AES_CPP17_INLINE constexpr void inv_round_key(Iterator i) const;
+
+        /**
+         * @brief one full inverse round: inv_shift_rows, inv_sub_bytes, round key _ROUND_ then inv_mix_columns
+         * @tparam ROUND
+         * @param block
+         */
+        template<size_t ROUND, typename Iterator>
+        AES_CPP17_INLINE constexpr void inv_round(Iterator i) const;
+
+        /**
+         * @brief the R - 2 full inverse rounds, last round key first, unrolled by the fold so that every round key
+         * offset is a compile time constant
+         * @param block
+         */
+        template<typename Iterator, size_t... ROUND>
+        constexpr void inv_rounds(Iterator i, std::index_sequence<ROUND...>) const;
 
         /**
          * @brief Inverse S-box substitution
          * @param block
          */
         template<typename Iterator>
-        inline void inv_sub_bytes(Iterator i);
+        AES_CPP17_INLINE constexpr void inv_sub_bytes(Iterator i) const;
 
         /**
          * @brief inverse shifts the rows in the block to the right, each by the opposite offset.
@@ -101,42 +160,70 @@ namespace crypto::aes {
          * @param  block
          */
         template<typename Iterator>
-        inline void inv_shift_rows(Iterator i);
+        AES_CPP17_INLINE constexpr void inv_shift_rows(Iterator i) const;
 
         /**
-         * @brief inverse mix
+         * @brief inverse mix, as the forward mix_columns of a cheaply pre-multiplied column rather than the
+         * multiplications by 0E, 0B, 0D and 09
          * @param  block
          */
         template<typename Iterator>
-        inline void inv_mix_columns(Iterator i);
+        AES_CPP17_INLINE constexpr void inv_mix_columns(Iterator i) const;
 
         /**
          * @brief This function produces Nb(Nr+1) round keys.
          * The round keys are used in each round to decrypt the  blocks.
          * @param key
          */
-        void make_expanded_key(const key_t& key);
+        constexpr void make_expanded_key(const key_t& key);
+
+        /**
+         * @brief derive the equivalent inverse cipher schedule from the expanded key @see inverse_round_keys
+         */
+        constexpr void make_inverse_key();
 
-        expanded_key_t xkey;
+        alignas(CACHE_LINE) expanded_key_t xkey{}; // as encrypt, on its own cache lines
+
+        alignas(CACHE_LINE) expanded_key_t ixkey{};
 
     };
 
 // implementation
 
+    template<ROUNDS R, KEY_LENGTH N, typename T>
+    template<class Sequence, typename>
+    constexpr decrypt<R, N, T>::decrypt(Sequence &&seq) noexcept {
+        rekey(seq);
+    }
+
     template<ROUNDS R, KEY_LENGTH N, typename T>
     template<class Sequence>
-    decrypt<R, N, T>::decrypt(Sequence &&seq) noexcept {
-        key_t key;
+    constexpr void decrypt<R, N, T>::rekey(const Sequence &seq) noexcept {
+        key_t key{};
         auto it = std::begin(seq);
         for(size_t i{0}; i < key.size(); ++i) {
             key[i] = *it++;
         }
         make_expanded_key(key);
+        make_inverse_key();
     }
 
     template<ROUNDS R, KEY_LENGTH N, typename T>
-    void decrypt<R, N, T>::make_expanded_key(const decrypt::key_t &key) {
-        size_t j, k;
+    constexpr void decrypt<R, N, T>::make_inverse_key() {
+        for(size_t r{0}; r < R; ++r) {
+            const size_t from{(R - 1 - r) * BLOCK_SIZE};
+            for(size_t j{0}; j < BLOCK_SIZE; ++j) {
+                ixkey[r * BLOCK_SIZE + j] = xkey[from + j];
+            }
+            if(r != 0 && r != R - 1) {
+                inv_mix_columns(ixkey.begin() + r * BLOCK_SIZE);
+            }
+        }
+    }
+
+    template<ROUNDS R, KEY_LENGTH N, typename T>
+    constexpr void decrypt<R, N, T>::make_expanded_key(const decrypt::key_t &key) {
+        size_t j{0}, k{0};
         std::array<T, 4> w{}; // 32-bit Rijndael word used for the column/row operations
         // The first round key is the key itself.
         for (size_t i{0}; i < N; ++i) {
@@ -182,29 +269,31 @@ namespace crypto::aes {
     }
 
     template<ROUNDS R, KEY_LENGTH N, typename T>
-    template<typename Iterator>
-    void decrypt<R, N, T>::inv_round_key(size_t &rkey, Iterator i) {
-        *(i + 15) ^= xkey[--rkey];
-        *(i + 14) ^= xkey[--rkey];
-        *(i + 13) ^= xkey[--rkey];
-        *(i + 12) ^= xkey[--rkey];
-        *(i + 11) ^= xkey[--rkey];
-        *(i + 10) ^= xkey[--rkey];
-        *(i + 9 ) ^= xkey[--rkey];
-        *(i + 8 ) ^= xkey[--rkey];
-        *(i + 7 ) ^= xkey[--rkey];
-        *(i + 6 ) ^= xkey[--rkey];
-        *(i + 5 ) ^= xkey[--rkey];
-        *(i + 4 ) ^= xkey[--rkey];
-        *(i + 3 ) ^= xkey[--rkey];
-        *(i + 2 ) ^= xkey[--rkey];
-        *(i + 1 ) ^= xkey[--rkey];
-        *(i + 0 ) ^= xkey[--rkey];
+    template<size_t ROUND, typename Iterator>
+    constexpr void decrypt<R, N, T>::inv_round_key(Iterator i) const {
+        static_assert(ROUND < R, "round key out of range");
+        constexpr size_t rkey{ROUND * BLOCK_SIZE}; //offset in to the expanded key
+        *(i + 15) ^= xkey[rkey + 15];
+        *(i + 14) ^= xkey[rkey + 14];
+        *(i + 13) ^= xkey[rkey + 13];
+        *(i + 12) ^= xkey[rkey + 12];
+        *(i + 11) ^= xkey[rkey + 11];
+        *(i + 10) ^= xkey[rkey + 10];
+        *(i + 9 ) ^= xkey[rkey + 9 ];
+        *(i + 8 ) ^= xkey[rkey + 8 ];
+        *(i + 7 ) ^= xkey[rkey + 7 ];
+        *(i + 6 ) ^= xkey[rkey + 6 ];
+        *(i + 5 ) ^= xkey[rkey + 5 ];
+        *(i + 4 ) ^= xkey[rkey + 4 ];
+        *(i + 3 ) ^= xkey[rkey + 3 ];
+        *(i + 2 ) ^= xkey[rkey + 2 ];
+        *(i + 1 ) ^= xkey[rkey + 1 ];
+        *(i + 0 ) ^= xkey[rkey + 0 ];
     }
 
     template<ROUNDS R, KEY_LENGTH N, typename T>
     template<typename Iterator>
-    void decrypt<R, N, T>::inv_sub_bytes(Iterator i) {
+    constexpr void decrypt<R, N, T>::inv_sub_bytes(Iterator i) const {
         *(i + 0 ) = rsbox[*(i + 0 )];
         *(i + 1 ) = rsbox[*(i + 1 )];
         *(i + 2 ) = rsbox[*(i + 2 )];
@@ -225,7 +314,7 @@ namespace crypto::aes {
 
     template<ROUNDS R, KEY_LENGTH N, typename T>
     template<typename Iterator>
-    void decrypt<R, N, T>::inv_shift_rows(Iterator i) {
+    constexpr void decrypt<R, N, T>::inv_shift_rows(Iterator i) const {
         // Rotate first row 3 columns to right
         value_type ror{*(i + 13)};
         *(i + 13) = *(i + 9);
@@ -249,71 +338,69 @@ namespace crypto::aes {
 
     template<ROUNDS R, KEY_LENGTH N, typename T>
     template<typename Iterator>
-    void decrypt<R, N, T>::inv_mix_columns(Iterator i) {
-        //value_type a, b, c, d;
-        value_type a{ *(i + 0) };
-        value_type b{ *(i + 1) };
-        value_type c{ *(i + 2) };
-        value_type d{ *(i + 3) };
-
-        *(i + 0) = GFmul(a, 0x0e) ^ GFmul(b, 0x0b) ^ GFmul(c, 0x0d) ^ GFmul(d, 0x09);
-        *(i + 1) = GFmul(a, 0x09) ^ GFmul(b, 0x0e) ^ GFmul(c, 0x0b) ^ GFmul(d, 0x0d);
-        *(i + 2) = GFmul(a, 0x0d) ^ GFmul(b, 0x09) ^ GFmul(c, 0x0e) ^ GFmul(d, 0x0b);
-        *(i + 3) = GFmul(a, 0x0b) ^ GFmul(b, 0x0d) ^ GFmul(c, 0x09) ^ GFmul(d, 0x0e);
-
-        a = *(i + 4);
-        b = *(i + 5);
-        c = *(i + 6);
-        d = *(i + 7);
-
-        *(i + 4) = GFmul(a, 0x0e) ^ GFmul(b, 0x0b) ^ GFmul(c, 0x0d) ^ GFmul(d, 0x09);
-        *(i + 5) = GFmul(a, 0x09) ^ GFmul(b, 0x0e) ^ GFmul(c, 0x0b) ^ GFmul(d, 0x0d);
-        *(i + 6) = GFmul(a, 0x0d) ^ GFmul(b, 0x09) ^ GFmul(c, 0x0e) ^ GFmul(d, 0x0b);
-        *(i + 7) = GFmul(a, 0x0b) ^ GFmul(b, 0x0d) ^ GFmul(c, 0x09) ^ GFmul(d, 0x0e);
-
-        a = *(i + 8);
-        b = *(i + 9);
-        c = *(i + 10);
-        d = *(i + 11);
-
-        *(i + 8 ) = GFmul(a, 0x0e) ^ GFmul(b, 0x0b) ^ GFmul(c, 0x0d) ^ GFmul(d, 0x09);
-        *(i + 9 ) = GFmul(a, 0x09) ^ GFmul(b, 0x0e) ^ GFmul(c, 0x0b) ^ GFmul(d, 0x0d);
-        *(i + 10) = GFmul(a, 0x0d) ^ GFmul(b, 0x09) ^ GFmul(c, 0x0e) ^ GFmul(d, 0x0b);
-        *(i + 11) = GFmul(a, 0x0b) ^ GFmul(b, 0x0d) ^ GFmul(c, 0x09) ^ GFmul(d, 0x0e);
-
-        a = *(i + 12);
-        b = *(i + 13);
-        c = *(i + 14);
-        d = *(i + 15);
-
-        *(i + 12) = GFmul(a, 0x0e) ^ GFmul(b, 0x0b) ^ GFmul(c, 0x0d) ^ GFmul(d, 0x09);
-        *(i + 13) = GFmul(a, 0x09) ^ GFmul(b, 0x0e) ^ GFmul(c, 0x0b) ^ GFmul(d, 0x0d);
-        *(i + 14) = GFmul(a, 0x0d) ^ GFmul(b, 0x09) ^ GFmul(c, 0x0e) ^ GFmul(d, 0x0b);
-        *(i + 15) = GFmul(a, 0x0b) ^ GFmul(b, 0x0d) ^ GFmul(c, 0x09) ^ GFmul(d, 0x0e);
+    constexpr void decrypt<R, N, T>::inv_mix_columns(Iterator i) const {
+        // the inverse matrix factors in to the forward one times 05 00 04 00 (rotated per row), so each column is
+        // first pre-multiplied by the sparse factor: a0 a2 ^= 4 x (a0 + a2), a1 a3 ^= 4 x (a1 + a3)
+        for(size_t c{0}; c < BLOCK_SIZE; c += 4) {
+            const value_type u = static_cast<value_type>(GF2(GF2(*(i + c + 0) ^ *(i + c + 2))));
+            const value_type v = static_cast<value_type>(GF2(GF2(*(i + c + 1) ^ *(i + c + 3))));
+            *(i + c + 0) ^= u;
+            *(i + c + 1) ^= v;
+            *(i + c + 2) ^= u;
+            *(i + c + 3) ^= v;
+        }
+        encrypt<R, N, T>::mix_columns(i);
+    }
+
+    template<ROUNDS R, KEY_LENGTH N, typename T>
+    template<size_t ROUND, typename Iterator>
+    constexpr void decrypt<R, N, T>::inv_round(Iterator i) const {
+        inv_shift_rows(i);
+        inv_sub_bytes(i);
+        inv_round_key<ROUND>(i);
+        inv_mix_columns(i);
+    }
+
+    template<ROUNDS R, KEY_LENGTH N, typename T>
+    template<typename Iterator, size_t... ROUND>
+    constexpr void decrypt<R, N, T>::inv_rounds(Iterator i, std::index_sequence<ROUND...>) const {
+        (inv_round<R - 2 - ROUND>(i), ...);
     }
 
     template<ROUNDS R, KEY_LENGTH N, typename T>
     template<typename Iterator>
-    void decrypt<R, N, T>::block(Iterator i) {
-        size_t rkey{ R * BLOCK_SIZE }; //start at the back of the expanded key
+    constexpr void decrypt<R, N, T>::block(Iterator i) const {
+        std::array<T, BLOCK_SIZE> state{}; // a local state cannot alias xkey, the round keys are not reloaded after every store
+        for(size_t j{0}; j < BLOCK_SIZE; ++j) {
+            state[j] = *(i + j);
+        }
+        auto s = state.begin();
         // xor the last round key to the block before starting the inverse rounds
-        inv_round_key(rkey, i); //decrements the rkey offest - 16
-        for(auto j{ R - 1 }; --j;) { // the R - 1 rounds are identical...
-            inv_shift_rows(i);
-            inv_sub_bytes(i);
-            inv_round_key(rkey, i); //decrements the rkey offest - 16
-            inv_mix_columns(i);
+        inv_round_key<R - 1>(s);
+        inv_rounds(s, std::make_index_sequence<R - 2>()); // the R - 2 full rounds are identical...
+        inv_shift_rows(s);
+        inv_sub_bytes(s);
+        inv_round_key<0>(s);
+        for(size_t j{0}; j < BLOCK_SIZE; ++j) {
+            *(i + j) = state[j];
         }
-        inv_shift_rows(i);
-        inv_sub_bytes(i);
-        inv_round_key(rkey, i); //decrements the rkey offest - 16
     }
 
     template<ROUNDS R, KEY_LENGTH N, typename T>
-    size_t decrypt<R, N, T>::block_size() {
+    constexpr size_t decrypt<R, N, T>::block_size() {
         return BLOCK_SIZE;
     }
 
 }
 
+namespace crypto {
+
+    /**
+     * @brief the straight inverse cipher runs the encrypt round keys backwards @see decrypt(const encrypt&)
+     */
+    template<aes::ROUNDS R, aes::KEY_LENGTH N, typename T>
+    struct derives_from_encrypt<aes::decrypt<R, N, T>, aes::encrypt<R, N, T>> : std::true_type {};
+
+}
+
 #endif //AES_CPP17_AES_DECRYPT_H
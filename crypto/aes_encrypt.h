@@ -2,16 +2,24 @@
 #define AES_CPP17_AES_ENCRYPT_H
 
 #include <array>
+#include <utility>
 
 #include "block_cipher_constants.h"
 #include "aes_constants.h"
 
 namespace crypto::aes {
 
+    template<ROUNDS R, KEY_LENGTH N, typename T>
+    class decrypt;
+
     /**
     * @brief AES block cipher encrypt functor implementation available choices are AES128, AES192, AES256.
     * The implementation is verified against the test vectors in:
     * National Institute of Standards and Technology Special Publication 800-38A 2001 ED
+    * Key expansion and block encryption are constexpr so a constant key is expanded by the compiler, not at start up:
+    * ```
+    * constexpr crypto::aes::encrypt<> whitening(WHITENING_KEY);
+    * ```
     * @tparam R number of round keys needed (AES-256 default 15)
     * @tparam N length of the key in 32-bit words (AES-256 default 8)
     * @tparam T 8-bit type (default uint8_t) manipulating 8-bit bytes obviates the need to handle endianness across platforms.
@@ -29,9 +37,9 @@ namespace crypto::aes {
         constexpr static size_t K = N * WORD_SIZE;
 
         /**
-         * XK as the length of the expanded key in 8-bit bytes.
+         * XK as the length of the expanded key in 8-bit bytes - R round keys of a block each.
          */
-        constexpr static size_t XK = R * N * 2;
+        constexpr static size_t XK = R * BLOCK_SIZE;
 
         using key_t = std::array<T, K>;
         using expanded_key_t = std::array<T, XK>;
@@ -41,14 +49,36 @@ namespace crypto::aes {
         using value_type = T;
         using block_t = std::array<T, crypto::BLOCK_SIZE>;
 
-        template<class Sequence>
-        explicit encrypt(Sequence &&seq) noexcept;
+        template<class Sequence, typename = enable_if_key_t<Sequence, encrypt>>
+        constexpr explicit encrypt(Sequence &&seq) noexcept;
+
+        /**
+         * @brief an all zero, unkeyed schedule for an owner that rekey()s before first use e.g. ctr_drbg
+         */
+        constexpr encrypt() = default;
 
-        //Constructor accepting a forwarding reference can hide copy and move constructors
-        encrypt(const encrypt&) = delete;
-        encrypt(encrypt&&) = delete;
-        encrypt& operator=(const encrypt&) = delete;
-        encrypt& operator=(encrypt&&) = delete;
+        //copying or moving is a copy of the expanded key, there is nothing to re-expand
+        encrypt(const encrypt&) = default;
+        encrypt(encrypt&&) noexcept = default;
+        encrypt& operator=(const encrypt&) = default;
+        encrypt& operator=(encrypt&&) noexcept = default;
+
+        /**
+         * @brief a cipher from an already expanded key e.g. one lane of a key_batch
+         * @tparam ConstIterator
+         * @param first the R round keys, a block each, first round first
+         * @return encrypt
+         */
+        template<typename ConstIterator>
+        constexpr static encrypt from_round_keys(ConstIterator first);
+
+        /**
+         * @brief re-expand a new key in place, so a pooled cipher can rotate keys without being reconstructed
+         * @tparam Sequence
+         * @param seq the new key
+         */
+        template<class Sequence>
+        constexpr void rekey(const Sequence &seq) noexcept;
 
         /**
          * @brief Encrypt a 16 byte block of plaintext using the session key material
@@ -56,24 +86,47 @@ namespace crypto::aes {
          * @return 16 byte block of ciphertext
          */
         template<typename Iterator>
-        void block(Iterator i);
+        constexpr void block(Iterator i) const;
 
         /**
          * @brief retrieve this block cipher's block_size
          * @return size_t
          */
-        inline static size_t block_size();
+        constexpr static size_t block_size();
+
+        /**
+         * @brief the R round keys back to back, for engines that run the rounds themselves e.g. multi_buffer_ctr
+         * @note each round key is BLOCK_SIZE aligned
+         * @return const T*
+         */
+        constexpr const T* round_keys() const {
+            return xkey.data();
+        }
 
     private:
 
         /**
-         * @breif GF add (XOR) the round key to the block _increasing_ the round + 16
-         * @note *has side effects* but saves time consuming multiplications
-         * @param rkey reference to the round key offset
+         * @brief GF add (XOR) round key _ROUND_ to the block, its offset in to the expanded key is a constant
+         * @tparam ROUND
          * @param block
          */
-        template<typename Iterator>
-        inline void add_round_key(size_t &rkey, Iterator i);
+        template<size_t ROUND, typename Iterator>
+        AES_CPP17_INLINE constexpr void add_round_key(Iterator i) const;
+
+        /**
+         * @brief one full round: sub_bytes, shift_rows, mix_columns then round key _ROUND_
+         * @tparam ROUND
+         * @param block
+         */
+        template<size_t ROUND, typename Iterator>
+        AES_CPP17_INLINE constexpr void round(Iterator i) const;
+
+        /**
+         * @brief the R - 2 full rounds, unrolled by the fold so that every round key offset is a compile time constant
+         * @param block
+         */
+        template<typename Iterator, size_t... ROUND>
+        constexpr void rounds(Iterator i, std::index_sequence<ROUND...>) const;
 
         /**
          * @brief S-box substitution
@@ -81,14 +134,14 @@ namespace crypto::aes {
          * @param  block
          */
         template<typename Iterator>
-        inline void sub_bytes(Iterator i);
+        AES_CPP17_INLINE constexpr void sub_bytes(Iterator i) const;
 
         /**
          * @brief shifts the rows in the block to the left, each by a different offset.
          * @param  block
          */
         template<typename Iterator>
-        inline void shift_rows(Iterator i);
+        AES_CPP17_INLINE constexpr void shift_rows(Iterator i) const;
 
         /**
          * @brief consider 16 byte block as 4x4 matrix and mix columns as per Rijndael algorithm.
@@ -99,10 +152,11 @@ namespace crypto::aes {
          * 01 02 03 01
          * 01 01 02 03
          * 03 01 01 02
+         * @note static, decrypt reuses it for its inverse
          * @param  block
          */
         template<typename Iterator>
-        inline void mix_columns(Iterator i);
+        AES_CPP17_INLINE constexpr static void mix_columns(Iterator i);
 
 
         /**
@@ -110,18 +164,31 @@ namespace crypto::aes {
          * The round keys are used in each round to decrypt the  blocks.
          * @param key
          */
-        void make_expanded_key(const key_t &key);
+        constexpr void make_expanded_key(const key_t &key);
+
+        /**
+         * The schedule starts its own cache line, so each round key is 16 byte aligned for SIMD and AES-NI loads
+         * straight from round_keys(), the AES-256 schedule fills 4 lines rather than straddling 5, and ciphers owned by
+         * different threads never false-share.
+         */
+        alignas(CACHE_LINE) expanded_key_t xkey{};
 
-        expanded_key_t xkey;
+        friend class decrypt<R, N, T>; // derives its schedule from xkey
 
     };
 
 // implementation
 
+    template<aes::ROUNDS R, aes::KEY_LENGTH N, typename T>
+    template<class Sequence, typename>
+    constexpr encrypt<R, N, T>::encrypt(Sequence &&seq) noexcept {
+        rekey(seq);
+    }
+
     template<aes::ROUNDS R, aes::KEY_LENGTH N, typename T>
     template<class Sequence>
-    encrypt<R, N, T>::encrypt(Sequence &&seq) noexcept {
-        key_t key;
+    constexpr void encrypt<R, N, T>::rekey(const Sequence &seq) noexcept {
+        key_t key{};
         auto it = std::begin(seq);
         for (size_t i{0}; i < key.size(); ++i) {
             key[i] = *it++;
@@ -130,9 +197,19 @@ namespace crypto::aes {
     }
 
     template<aes::ROUNDS R, aes::KEY_LENGTH N, typename T>
-    void encrypt<R, N, T>::make_expanded_key(const encrypt::key_t &key) {
-        size_t j, k;
-        std::array<T, 4> w; // 32-bit Rijndael word used for the column/row operations
+    template<typename ConstIterator>
+    constexpr encrypt<R, N, T> encrypt<R, N, T>::from_round_keys(ConstIterator first) {
+        encrypt e{};
+        for(auto& b: e.xkey) {
+            b = static_cast<T>(*first++);
+        }
+        return e;
+    }
+
+    template<aes::ROUNDS R, aes::KEY_LENGTH N, typename T>
+    constexpr void encrypt<R, N, T>::make_expanded_key(const encrypt::key_t &key) {
+        size_t j{0}, k{0};
+        std::array<T, 4> w{}; // 32-bit Rijndael word used for the column/row operations
         // The first round key is the key itself.
         for (size_t i{0}; i < N; ++i) {
             xkey[(i * 4) + 0] =key[(i * 4) + 0];
@@ -177,29 +254,31 @@ namespace crypto::aes {
     }
 
     template<ROUNDS R, KEY_LENGTH N, typename T>
-    template<typename Iterator>
-    void encrypt<R, N, T>::add_round_key(size_t &rkey, Iterator i) {
-        *(i + 0 ) ^= xkey[rkey++];
-        *(i + 1 ) ^= xkey[rkey++];
-        *(i + 2 ) ^= xkey[rkey++];
-        *(i + 3 ) ^= xkey[rkey++];
-        *(i + 4 ) ^= xkey[rkey++];
-        *(i + 5 ) ^= xkey[rkey++];
-        *(i + 6 ) ^= xkey[rkey++];
-        *(i + 7 ) ^= xkey[rkey++];
-        *(i + 8 ) ^= xkey[rkey++];
-        *(i + 9 ) ^= xkey[rkey++];
-        *(i + 10) ^= xkey[rkey++];
-        *(i + 11) ^= xkey[rkey++];
-        *(i + 12) ^= xkey[rkey++];
-        *(i + 13) ^= xkey[rkey++];
-        *(i + 14) ^= xkey[rkey++];
-        *(i + 15) ^= xkey[rkey++];
+    template<size_t ROUND, typename Iterator>
+    constexpr void encrypt<R, N, T>::add_round_key(Iterator i) const {
+        static_assert(ROUND < R, "round key out of range");
+        constexpr size_t rkey{ROUND * BLOCK_SIZE}; //offset in to the expanded key
+        *(i + 0 ) ^= xkey[rkey + 0 ];
+        *(i + 1 ) ^= xkey[rkey + 1 ];
+        *(i + 2 ) ^= xkey[rkey + 2 ];
+        *(i + 3 ) ^= xkey[rkey + 3 ];
+        *(i + 4 ) ^= xkey[rkey + 4 ];
+        *(i + 5 ) ^= xkey[rkey + 5 ];
+        *(i + 6 ) ^= xkey[rkey + 6 ];
+        *(i + 7 ) ^= xkey[rkey + 7 ];
+        *(i + 8 ) ^= xkey[rkey + 8 ];
+        *(i + 9 ) ^= xkey[rkey + 9 ];
+        *(i + 10) ^= xkey[rkey + 10];
+        *(i + 11) ^= xkey[rkey + 11];
+        *(i + 12) ^= xkey[rkey + 12];
+        *(i + 13) ^= xkey[rkey + 13];
+        *(i + 14) ^= xkey[rkey + 14];
+        *(i + 15) ^= xkey[rkey + 15];
     }
 
     template<ROUNDS R, KEY_LENGTH N, typename T>
     template<typename Iterator>
-    void encrypt<R, N, T>::sub_bytes(Iterator i) {
+    constexpr void encrypt<R, N, T>::sub_bytes(Iterator i) const {
         *(i + 0 ) = sbox[*(i + 0 )];
         *(i + 1 ) = sbox[*(i + 1 )];
         *(i + 2 ) = sbox[*(i + 2 )];
@@ -220,7 +299,7 @@ namespace crypto::aes {
 
     template<ROUNDS R, KEY_LENGTH N, typename T>
     template<typename Iterator>
-    void encrypt<R, N, T>::shift_rows(Iterator i) {
+    constexpr void encrypt<R, N, T>::shift_rows(Iterator i) const {
         // Rotate first row 1 columns to left
         value_type rol{*(i + 1 )};
         *(i + 1 ) = *(i + 5 );
@@ -244,8 +323,8 @@ namespace crypto::aes {
 
     template<ROUNDS R, KEY_LENGTH N, typename T>
     template<typename Iterator>
-    void encrypt<R, N, T>::mix_columns(Iterator i) {
-        value_type a, b, c;
+    constexpr void encrypt<R, N, T>::mix_columns(Iterator i) {
+        value_type a{0}, b{0}, c{0};
         a = *(i + 0);
         b = *(i + 0) ^ *(i + 1);
         c = *(i + 0) ^ *(i + 1) ^ *(i + 2) ^ *(i + 3);
@@ -308,26 +387,43 @@ namespace crypto::aes {
         *(i + 15) ^= b ^ c;
     }
 
+    template<ROUNDS R, KEY_LENGTH N, typename T>
+    template<size_t ROUND, typename Iterator>
+    constexpr void encrypt<R, N, T>::round(Iterator i) const {
+        sub_bytes(i);
+        shift_rows(i);  // Rijndael diffusion
+        mix_columns(i); // Rijndael diffusion
+        add_round_key<ROUND>(i);
+    }
+
+    template<ROUNDS R, KEY_LENGTH N, typename T>
+    template<typename Iterator, size_t... ROUND>
+    constexpr void encrypt<R, N, T>::rounds(Iterator i, std::index_sequence<ROUND...>) const {
+        (round<ROUND + 1>(i), ...);
+    }
+
     template<ROUNDS R, KEY_LENGTH N, typename T>
     template<typename Iterator>
-    void encrypt<R, N, T>::block(Iterator i) {
-        size_t rkey{0}; //offset in to the expanded keystruct
-        // xor the first round key to the block before starting the rounds
-        add_round_key(rkey, i); //increments the rkey offest iterator _i_ + 16
-        for(auto j{ R - 1 }; --j;) { // the R - 1 rounds are identical...
-            sub_bytes(i);
-            shift_rows(i);  // Rijndael diffusion
-            mix_columns(i); // Rijndael diffusion
-            add_round_key(rkey, i);
+    constexpr void encrypt<R, N, T>::block(Iterator i) const {
+        block_t state{}; // a local state cannot alias xkey, the round keys are not reloaded after every store
+        for(size_t j{0}; j < BLOCK_SIZE; ++j) {
+            state[j] = *(i + j);
         }
+        auto s = state.begin();
+        // xor the first round key to the block before starting the rounds
+        add_round_key<0>(s);
+        rounds(s, std::make_index_sequence<R - 2>()); // the R - 2 full rounds are identical...
         // final round lacks mix_columns diffusion
-        sub_bytes(i);
-        shift_rows(i);
-        add_round_key(rkey, i);
+        sub_bytes(s);
+        shift_rows(s);
+        add_round_key<R - 1>(s);
+        for(size_t j{0}; j < BLOCK_SIZE; ++j) {
+            *(i + j) = state[j];
+        }
     }
 
     template<ROUNDS R, KEY_LENGTH N, typename T>
-    size_t encrypt<R, N, T>::block_size() {
+    constexpr size_t encrypt<R, N, T>::block_size() {
         return BLOCK_SIZE;
     }
 
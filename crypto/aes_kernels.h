@@ -0,0 +1,597 @@
+#ifndef AES_CPP17_AES_KERNELS_H
+#define AES_CPP17_AES_KERNELS_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#include "aes_encrypt.h"
+#include "aes_decrypt.h"
+#include "aes_key_schedule.h"
+#include "cipher_exception.h"
+#include "cpu_features.h"
+
+#ifdef AES_CPP17_X86
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+namespace crypto {
+
+    /**
+     * The AES kernels and the one place that picks between them: a table of function pointers per key size, one table
+     * per kernel_t, indexed by the process wide active_kernel() (CPUID, overridden by KERNEL_ENV or select_kernel()).
+     * block_cipher hands contiguous runs of blocks to the active table, so callers get the best kernel unchanged.
+     * ```
+     * crypto::select_kernel(crypto::PORTABLE); // A/B against crypto::AESNI
+     * crypto::block_cipher<crypto::CTR> aes(key);
+     * ```
+     * @note there is no GCM here and so no GHASH kernel, the table is the place to add one (and a PCLMULQDQ probe)
+     */
+    namespace kernel {
+
+        /**
+         * @brief the 128 bit big endian nonce-counter + 1
+         */
+        inline void increment(uint8_t* counter) {
+            for(size_t i{BLOCK_SIZE}; i-- > 0;) {
+                if(++counter[i]) break;
+            }
+        }
+
+        /**
+         * @brief the kernels of one key size
+         * @tparam R
+         * @tparam N
+         */
+        template<aes::ROUNDS R, aes::KEY_LENGTH N>
+        struct table_t {
+
+            using encrypt_t = aes::encrypt<R, N>;
+            using decrypt_t = aes::decrypt<R, N>;
+
+            kernel_t kernel;
+
+            /**
+             * @brief expand a key of N words into R round keys
+             */
+            void (*expand)(const uint8_t* key, uint8_t* round_keys);
+
+            /**
+             * @brief encrypt _blocks_ whole blocks in place
+             */
+            void (*encrypt)(const encrypt_t& cipher, uint8_t* data, size_t blocks);
+
+            /**
+             * @brief decrypt _blocks_ whole blocks in place
+             */
+            void (*decrypt)(const decrypt_t& cipher, uint8_t* data, size_t blocks);
+
+            /**
+             * @brief XOR the keystream of the big endian nonce-counter into _size_ bytes in place, the final block may
+             * be partial, and advance the counter past every block used
+             */
+            void (*ctr)(const encrypt_t& cipher, uint8_t* counter, uint8_t* data, size_t size);
+
+            /**
+             * @brief CBC encrypt _blocks_ whole blocks in place, chained from the _iv_ block
+             */
+            void (*cbc_encrypt)(const encrypt_t& cipher, const uint8_t* iv, uint8_t* data, size_t blocks);
+
+        };
+
+        namespace portable {
+
+            template<aes::ROUNDS R, aes::KEY_LENGTH N>
+            void expand(const uint8_t* key, uint8_t* round_keys) {
+                std::array<uint8_t, N * WORD_SIZE> k{};
+                std::copy(key, key + k.size(), k.begin());
+                const aes::encrypt<R, N> cipher(k);
+                std::copy(cipher.round_keys(), cipher.round_keys() + R * BLOCK_SIZE, round_keys);
+            }
+
+            template<aes::ROUNDS R, aes::KEY_LENGTH N>
+            void encrypt(const aes::encrypt<R, N>& cipher, uint8_t* data, size_t blocks) {
+                for(; blocks; --blocks, data += BLOCK_SIZE) {
+                    cipher.block(data);
+                }
+            }
+
+            template<aes::ROUNDS R, aes::KEY_LENGTH N>
+            void decrypt(const aes::decrypt<R, N>& cipher, uint8_t* data, size_t blocks) {
+                for(; blocks; --blocks, data += BLOCK_SIZE) {
+                    cipher.block(data);
+                }
+            }
+
+            template<aes::ROUNDS R, aes::KEY_LENGTH N>
+            void ctr(const aes::encrypt<R, N>& cipher, uint8_t* counter, uint8_t* data, size_t size) {
+                while(size) {
+                    std::array<uint8_t, BLOCK_SIZE> stream{};
+                    std::copy(counter, counter + BLOCK_SIZE, stream.begin());
+                    cipher.block(stream.begin());
+                    const size_t n = std::min(size, BLOCK_SIZE);
+                    for(size_t i{0}; i < n; ++i) {
+                        data[i] ^= stream[i];
+                    }
+                    increment(counter);
+                    data += n;
+                    size -= n;
+                }
+            }
+
+            template<aes::ROUNDS R, aes::KEY_LENGTH N>
+            void cbc_encrypt(const aes::encrypt<R, N>& cipher, const uint8_t* iv, uint8_t* data, size_t blocks) {
+                for(; blocks; --blocks, iv = data, data += BLOCK_SIZE) {
+                    for(size_t i{0}; i < BLOCK_SIZE; ++i) {
+                        data[i] ^= iv[i];
+                    }
+                    cipher.block(data);
+                }
+            }
+
+        }
+
+#ifdef AES_CPP17_X86
+
+        /**
+         * @note WAYS blocks are kept in flight, independent AESENCs pipeline on every core since Westmere
+         * @note only call when can_aesni()
+         */
+        namespace aesni {
+
+            constexpr static size_t WAYS = 4;
+
+            AES_CPP17_TARGET("sse2") inline __m128i load(const uint8_t* p) {
+                return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            }
+
+            AES_CPP17_TARGET("sse2") inline void store(uint8_t* p, __m128i x) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(p), x);
+            }
+
+            /**
+             * @brief the round keys are aligned, aes::encrypt and aes::decrypt schedules start on a cache line
+             * @note an aligned load is safe only because every caller passes round_keys() of an aes::encrypt or
+             * inverse_round_keys() of an aes::decrypt (alignas(CACHE_LINE) members) - never hand it a caller
+             * supplied schedule
+             */
+            template<aes::ROUNDS R>
+            AES_CPP17_TARGET("sse2") inline void load_keys(const uint8_t* round_keys, __m128i* k) {
+                for(size_t r{0}; r < R; ++r) {
+                    k[r] = _mm_load_si128(reinterpret_cast<const __m128i*>(round_keys + r * BLOCK_SIZE));
+                }
+            }
+
+            template<aes::ROUNDS R, size_t W>
+            AES_CPP17_TARGET("aes") inline void cipher(__m128i* s, const __m128i* k) {
+                for(size_t w{0}; w < W; ++w) {
+                    s[w] = _mm_xor_si128(s[w], k[0]);
+                }
+                for(size_t r{1}; r < R - 1; ++r) {
+                    for(size_t w{0}; w < W; ++w) {
+                        s[w] = _mm_aesenc_si128(s[w], k[r]);
+                    }
+                }
+                for(size_t w{0}; w < W; ++w) {
+                    s[w] = _mm_aesenclast_si128(s[w], k[R - 1]);
+                }
+            }
+
+            /**
+             * @brief _k_ the equivalent inverse cipher schedule @see aes::decrypt::inverse_round_keys
+             */
+            template<aes::ROUNDS R, size_t W>
+            AES_CPP17_TARGET("aes") inline void inv_cipher(__m128i* s, const __m128i* k) {
+                for(size_t w{0}; w < W; ++w) {
+                    s[w] = _mm_xor_si128(s[w], k[0]);
+                }
+                for(size_t r{1}; r < R - 1; ++r) {
+                    for(size_t w{0}; w < W; ++w) {
+                        s[w] = _mm_aesdec_si128(s[w], k[r]);
+                    }
+                }
+                for(size_t w{0}; w < W; ++w) {
+                    s[w] = _mm_aesdeclast_si128(s[w], k[R - 1]);
+                }
+            }
+
+            template<aes::ROUNDS R, aes::KEY_LENGTH N>
+            void expand(const uint8_t* key, uint8_t* round_keys) {
+                alignas(CACHE_LINE) aes::key_schedule::store_t<R, 1> store{};
+                aes::key_schedule::expand_aesni<R, N, 1>(&key, 1, store);
+                const uint8_t* first = store.data()->data()->data();
+                std::copy(first, first + R * BLOCK_SIZE, round_keys);
+            }
+
+            template<aes::ROUNDS R, aes::KEY_LENGTH N>
+            AES_CPP17_TARGET("aes") void encrypt(const aes::encrypt<R, N>& e, uint8_t* data, size_t blocks) {
+                __m128i k[R];
+                load_keys<R>(e.round_keys(), k);
+                for(; blocks >= WAYS; blocks -= WAYS, data += WAYS * BLOCK_SIZE) {
+                    __m128i s[WAYS];
+                    for(size_t w{0}; w < WAYS; ++w) {
+                        s[w] = load(data + w * BLOCK_SIZE);
+                    }
+                    cipher<R, WAYS>(s, k);
+                    for(size_t w{0}; w < WAYS; ++w) {
+                        store(data + w * BLOCK_SIZE, s[w]);
+                    }
+                }
+                for(; blocks; --blocks, data += BLOCK_SIZE) {
+                    __m128i s = load(data);
+                    cipher<R, 1>(&s, k);
+                    store(data, s);
+                }
+            }
+
+            template<aes::ROUNDS R, aes::KEY_LENGTH N>
+            AES_CPP17_TARGET("aes") void decrypt(const aes::decrypt<R, N>& d, uint8_t* data, size_t blocks) {
+                __m128i k[R];
+                load_keys<R>(d.inverse_round_keys(), k);
+                for(; blocks >= WAYS; blocks -= WAYS, data += WAYS * BLOCK_SIZE) {
+                    __m128i s[WAYS];
+                    for(size_t w{0}; w < WAYS; ++w) {
+                        s[w] = load(data + w * BLOCK_SIZE);
+                    }
+                    inv_cipher<R, WAYS>(s, k);
+                    for(size_t w{0}; w < WAYS; ++w) {
+                        store(data + w * BLOCK_SIZE, s[w]);
+                    }
+                }
+                for(; blocks; --blocks, data += BLOCK_SIZE) {
+                    __m128i s = load(data);
+                    inv_cipher<R, 1>(&s, k);
+                    store(data, s);
+                }
+            }
+
+            template<aes::ROUNDS R, aes::KEY_LENGTH N>
+            AES_CPP17_TARGET("aes") void ctr(const aes::encrypt<R, N>& e, uint8_t* counter, uint8_t* data,
+                                             size_t size) {
+                __m128i k[R];
+                load_keys<R>(e.round_keys(), k);
+                for(; size >= WAYS * BLOCK_SIZE; size -= WAYS * BLOCK_SIZE, data += WAYS * BLOCK_SIZE) {
+                    __m128i s[WAYS];
+                    for(size_t w{0}; w < WAYS; ++w) {
+                        s[w] = load(counter);
+                        increment(counter);
+                    }
+                    cipher<R, WAYS>(s, k);
+                    for(size_t w{0}; w < WAYS; ++w) {
+                        store(data + w * BLOCK_SIZE, _mm_xor_si128(load(data + w * BLOCK_SIZE), s[w]));
+                    }
+                }
+                while(size) {
+                    __m128i s = load(counter);
+                    increment(counter);
+                    cipher<R, 1>(&s, k);
+                    if(size >= BLOCK_SIZE) {
+                        store(data, _mm_xor_si128(load(data), s));
+                        data += BLOCK_SIZE;
+                        size -= BLOCK_SIZE;
+                    } else { // the final partial block
+                        alignas(BLOCK_SIZE) uint8_t stream[BLOCK_SIZE];
+                        _mm_store_si128(reinterpret_cast<__m128i*>(stream), s);
+                        for(size_t i{0}; i < size; ++i) {
+                            data[i] ^= stream[i];
+                        }
+                        size = 0;
+                    }
+                }
+            }
+
+            /**
+             * @brief each block waits on the one before, so one block in flight but the round keys stay in registers
+             * for the whole message
+             */
+            template<aes::ROUNDS R, aes::KEY_LENGTH N>
+            AES_CPP17_TARGET("aes") void cbc_encrypt(const aes::encrypt<R, N>& e, const uint8_t* iv, uint8_t* data,
+                                                     size_t blocks) {
+                __m128i k[R];
+                load_keys<R>(e.round_keys(), k);
+                __m128i s = load(iv);
+                for(; blocks; --blocks, data += BLOCK_SIZE) {
+                    s = _mm_xor_si128(s, load(data));
+                    cipher<R, 1>(&s, k);
+                    store(data, s);
+                }
+            }
+
+        }
+
+#endif
+
+        /**
+         * @brief the kernels of one key size for _kernel_, regardless of the active one e.g. to cross check kernels
+         * @note on a CPU without _kernel_ the table is the portable one, its _kernel_ member says so
+         */
+        template<aes::ROUNDS R, aes::KEY_LENGTH N>
+        const table_t<R, N>& table(kernel_t kernel) {
+            static const table_t<R, N> tables[] = {
+                    {PORTABLE, portable::expand<R, N>, portable::encrypt<R, N>, portable::decrypt<R, N>,
+                     portable::ctr<R, N>, portable::cbc_encrypt<R, N>},
+#ifdef AES_CPP17_X86
+                    {AESNI, aesni::expand<R, N>, aesni::encrypt<R, N>, aesni::decrypt<R, N>, aesni::ctr<R, N>,
+                     aesni::cbc_encrypt<R, N>}
+#else
+                    {PORTABLE, portable::expand<R, N>, portable::encrypt<R, N>, portable::decrypt<R, N>,
+                     portable::ctr<R, N>, portable::cbc_encrypt<R, N>}
+#endif
+            };
+            return tables[kernel_available(kernel) ? kernel : PORTABLE];
+        }
+
+        /**
+         * @brief the kernels of one key size for the active kernel
+         */
+        template<aes::ROUNDS R, aes::KEY_LENGTH N>
+        inline const table_t<R, N>& table() {
+            return table<R, N>(active_kernel());
+        }
+
+        /**
+         * @brief ciphers with kernel tables, the 8-bit AES functors
+         * @tparam C
+         */
+        template<class C>
+        struct traits_t: std::false_type {};
+
+        template<aes::ROUNDS R, aes::KEY_LENGTH N>
+        struct traits_t<aes::encrypt<R, N, uint8_t>>: std::true_type {
+            constexpr static aes::ROUNDS rounds = R;
+            constexpr static aes::KEY_LENGTH key_length = N;
+        };
+
+        template<aes::ROUNDS R, aes::KEY_LENGTH N>
+        struct traits_t<aes::decrypt<R, N, uint8_t>>: std::true_type {};
+
+        /**
+         * @brief iterators known to address contiguous bytes, so that a run of blocks is one pointer and a count
+         */
+        template<typename Iterator>
+        constexpr static bool contiguous_v = std::is_same_v<Iterator, uint8_t*>
+                                             || std::is_same_v<Iterator, std::vector<uint8_t>::iterator>;
+
+        /**
+         * @brief whether the cipher _C_ over the range of _Iterator_ can be handed to a kernel
+         */
+        template<class C, typename Iterator>
+        constexpr static bool dispatches_v = traits_t<C>::value && contiguous_v<Iterator>;
+
+        template<aes::ROUNDS R, aes::KEY_LENGTH N>
+        inline void encrypt(const aes::encrypt<R, N>& cipher, uint8_t* data, size_t blocks) {
+            table<R, N>().encrypt(cipher, data, blocks);
+        }
+
+        template<aes::ROUNDS R, aes::KEY_LENGTH N>
+        inline void decrypt(const aes::decrypt<R, N>& cipher, uint8_t* data, size_t blocks) {
+            table<R, N>().decrypt(cipher, data, blocks);
+        }
+
+        template<aes::ROUNDS R, aes::KEY_LENGTH N>
+        inline void ctr(const aes::encrypt<R, N>& cipher, uint8_t* counter, uint8_t* data, size_t size) {
+            table<R, N>().ctr(cipher, counter, data, size);
+        }
+
+        template<aes::ROUNDS R, aes::KEY_LENGTH N>
+        inline void cbc_encrypt(const aes::encrypt<R, N>& cipher, const uint8_t* iv, uint8_t* data, size_t blocks) {
+            table<R, N>().cbc_encrypt(cipher, iv, data, blocks);
+        }
+
+        /**
+         * @brief construct the cipher _C_ keyed with _seq_, expanding the key with the active kernel if it has one
+         * (_seq_ may also be a keyed _C_ to copy)
+         * @tparam C
+         * @tparam KeySequence
+         * @param seq
+         * @return C
+         */
+        template<class C, class KeySequence>
+        C make(const KeySequence& seq) {
+            if constexpr (std::is_same_v<KeySequence, C>) { // already keyed e.g. key_batch::cipher()
+                return seq;
+            } else if constexpr (traits_t<C>::value) {
+                constexpr auto R = traits_t<C>::rounds;
+                constexpr auto N = traits_t<C>::key_length;
+                std::array<uint8_t, N * WORD_SIZE> key{};
+                auto it = std::begin(seq);
+                for(auto& b: key) {
+                    b = static_cast<uint8_t>(*it++);
+                }
+                std::array<uint8_t, R * BLOCK_SIZE> round_keys{};
+                table<R, N>().expand(key.data(), round_keys.data());
+                return C::from_round_keys(round_keys.begin());
+            } else {
+                return C(seq);
+            }
+        }
+
+        /**
+         * @brief re-key _cipher_ in place with _seq_, expanding the key with the active kernel if it has one
+         */
+        template<class C, class KeySequence>
+        void rekey(C& cipher, const KeySequence& seq) {
+            if constexpr (traits_t<C>::value || std::is_same_v<KeySequence, C>) {
+                cipher = make<C>(seq);
+            } else {
+                cipher.rekey(seq);
+            }
+        }
+
+        /**
+         * NIST SP 800-38A F.1 ECB known answers, the first block for each key size
+         */
+        constexpr static std::array<uint8_t, BLOCK_SIZE> NIST_PLAIN = {
+                0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a};
+
+        constexpr static std::array<uint8_t, 16> NIST_KEY_128 = {
+                0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+
+        constexpr static std::array<uint8_t, BLOCK_SIZE> NIST_CIPHER_128 = {
+                0x3a, 0xd7, 0x7b, 0xb4, 0x0d, 0x7a, 0x36, 0x60, 0xa8, 0x9e, 0xca, 0xf3, 0x24, 0x66, 0xef, 0x97};
+
+        constexpr static std::array<uint8_t, 24> NIST_KEY_192 = {
+                0x8e, 0x73, 0xb0, 0xf7, 0xda, 0x0e, 0x64, 0x52, 0xc8, 0x10, 0xf3, 0x2b, 0x80, 0x90, 0x79, 0xe5,
+                0x62, 0xf8, 0xea, 0xd2, 0x52, 0x2c, 0x6b, 0x7b};
+
+        constexpr static std::array<uint8_t, BLOCK_SIZE> NIST_CIPHER_192 = {
+                0xbd, 0x33, 0x4f, 0x1d, 0x6e, 0x45, 0xf2, 0x5f, 0xf7, 0x12, 0xa2, 0x14, 0x57, 0x1f, 0xa5, 0xcc};
+
+        constexpr static std::array<uint8_t, 32> NIST_KEY_256 = {
+                0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+                0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4};
+
+        constexpr static std::array<uint8_t, BLOCK_SIZE> NIST_CIPHER_256 = {
+                0xf3, 0xee, 0xd1, 0xbd, 0xb5, 0xd2, 0xa0, 0x3c, 0x06, 0x4b, 0x5a, 0x7e, 0x3d, 0xb1, 0x81, 0xf8};
+
+        /**
+         * Pseudo random blocks per key size compared against the portable reference: half random, half a run of
+         * nonce-counters whose reference encryption doubles as the expected CTR keystream.
+         * @note the portable reference encryptions dominate the cost, 3 x 384 keep the self-test well under a millisecond
+         * while each kernel still runs some 3000 blocks through its encrypt, decrypt and CTR entries
+         */
+        constexpr static size_t SELF_TEST_BLOCKS = 384;
+
+        /**
+         * @brief the fixed seed, a failure reproduces
+         */
+        constexpr static uint64_t SELF_TEST_SEED = 0x9E3779B97F4A7C15ull;
+
+        /**
+         * @brief SplitMix64, plenty for test data
+         */
+        inline uint64_t split_mix(uint64_t& state) {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30u)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27u)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31u);
+        }
+
+        /**
+         * @brief encrypt and decrypt the NIST known answer with _kernels_
+         */
+        template<aes::ROUNDS R, aes::KEY_LENGTH N, size_t K>
+        bool known_answer(const table_t<R, N>& kernels, const std::array<uint8_t, K>& key,
+                          const std::array<uint8_t, BLOCK_SIZE>& expect) {
+            std::array<uint8_t, R * BLOCK_SIZE> round_keys{};
+            kernels.expand(key.data(), round_keys.data());
+            const auto encrypt = aes::encrypt<R, N>::from_round_keys(round_keys.begin());
+            const aes::decrypt<R, N> decrypt(encrypt);
+            std::array<uint8_t, BLOCK_SIZE> block = NIST_PLAIN;
+            kernels.encrypt(encrypt, block.data(), 1);
+            if(block != expect) {
+                return false;
+            }
+            kernels.decrypt(decrypt, block.data(), 1);
+            return block == NIST_PLAIN;
+        }
+
+        /**
+         * @brief differential check of every entry of _candidate_ against the portable kernels over pseudo random keys
+         * and blocks, including the single block and partial block tails and a CBC chain split across two calls
+         * @return bool true if _candidate_ agrees
+         */
+        template<aes::ROUNDS R, aes::KEY_LENGTH N>
+        bool agrees(const table_t<R, N>& candidate, uint64_t seed = SELF_TEST_SEED) {
+            const auto& reference = table<R, N>(PORTABLE);
+            constexpr size_t HALF = SELF_TEST_BLOCKS / 2;
+            auto random_fill = [&seed](uint8_t* p, size_t n) {
+                for(size_t i{0}; i < n; ++i) {
+                    p[i] = static_cast<uint8_t>(split_mix(seed));
+                }
+            };
+
+            std::array<uint8_t, N * WORD_SIZE> key{};
+            random_fill(key.data(), key.size());
+            std::array<uint8_t, R * BLOCK_SIZE> expect{}, actual{};
+            reference.expand(key.data(), expect.data());
+            candidate.expand(key.data(), actual.data());
+            if(actual != expect) {
+                return false;
+            }
+            const auto encrypt = aes::encrypt<R, N>::from_round_keys(expect.begin());
+            const aes::decrypt<R, N> decrypt(encrypt);
+
+            std::vector<uint8_t> plain(SELF_TEST_BLOCKS * BLOCK_SIZE);
+            random_fill(plain.data(), HALF * BLOCK_SIZE);
+            std::array<uint8_t, BLOCK_SIZE> nonce{}, counter{};
+            random_fill(nonce.data(), nonce.size());
+            counter = nonce;
+            for(size_t i{HALF}; i < SELF_TEST_BLOCKS; ++i, increment(counter.data())) {
+                std::copy(counter.begin(), counter.end(), plain.begin() + i * BLOCK_SIZE);
+            }
+
+            std::vector<uint8_t> a(plain), b(plain);
+            reference.encrypt(encrypt, a.data(), SELF_TEST_BLOCKS);
+            candidate.encrypt(encrypt, b.data(), SELF_TEST_BLOCKS - 1);
+            candidate.encrypt(encrypt, b.data() + (SELF_TEST_BLOCKS - 1) * BLOCK_SIZE, 1);
+            if(a != b) {
+                return false;
+            }
+            candidate.decrypt(decrypt, b.data(), SELF_TEST_BLOCKS - 1);
+            candidate.decrypt(decrypt, b.data() + (SELF_TEST_BLOCKS - 1) * BLOCK_SIZE, 1);
+            if(b != plain) {
+                return false;
+            }
+
+            std::vector<uint8_t> c(plain.begin(), plain.begin() + HALF * BLOCK_SIZE), d(c); // the last block chained
+            reference.cbc_encrypt(encrypt, nonce.data(), c.data(), HALF);                   // on from a second call
+            candidate.cbc_encrypt(encrypt, nonce.data(), d.data(), HALF - 1);
+            candidate.cbc_encrypt(encrypt, d.data() + (HALF - 2) * BLOCK_SIZE, d.data() + (HALF - 1) * BLOCK_SIZE, 1);
+            if(c != d) {
+                return false;
+            }
+
+            std::vector<uint8_t> stream(HALF * BLOCK_SIZE - 7, 0x00); // the keystream itself, ending part way through
+            std::array<uint8_t, BLOCK_SIZE> next = nonce;
+            candidate.ctr(encrypt, next.data(), stream.data(), stream.size());
+            return std::equal(stream.begin(), stream.end(), a.begin() + HALF * BLOCK_SIZE) && next == counter;
+        }
+
+        /**
+         * @brief Power-on self-test, for process start up: the NIST known answers through every kernel, then a
+         * differential check of every kernel the CPU supports against the portable reference, for each key size.
+         * A kernel that disagrees is refused - never selected again in this process - so a miscompiled or
+         * mis-dispatched kernel fails safe to a slower one rather than corrupting data at line rate.
+         * ```
+         * int main() {
+         *     if(!crypto::kernel::power_on_self_test()) log.warn("AES kernel refused, running {}", ...);
+         * ```
+         * @note well under a millisecond, the portable reference encryptions are the bulk of it
+         * @throws doh::cipher_exception if the portable reference itself fails the known answers
+         * @return bool true if every supported kernel passed
+         */
+        inline bool power_on_self_test() {
+            auto known_answers = [](kernel_t kernel) {
+                return known_answer(table<aes::R128, aes::N128>(kernel), NIST_KEY_128, NIST_CIPHER_128)
+                       && known_answer(table<aes::R192, aes::N192>(kernel), NIST_KEY_192, NIST_CIPHER_192)
+                       && known_answer(table<aes::R256, aes::N256>(kernel), NIST_KEY_256, NIST_CIPHER_256);
+            };
+            if(!known_answers(PORTABLE)) {
+                throw doh::cipher_exception(doh::SELF_TEST);
+            }
+            bool passed{true};
+            for(kernel_t kernel: {AESNI}) {
+                if(!kernel_available(kernel)) {
+                    continue;
+                }
+                if(!(known_answers(kernel)
+                     && agrees(table<aes::R128, aes::N128>(kernel))
+                     && agrees(table<aes::R192, aes::N192>(kernel))
+                     && agrees(table<aes::R256, aes::N256>(kernel)))) {
+                    refuse_kernel(kernel);
+                    passed = false;
+                }
+            }
+            return passed;
+        }
+
+    }
+
+}
+
+#endif //AES_CPP17_AES_KERNELS_H
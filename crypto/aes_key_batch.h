@@ -0,0 +1,111 @@
+#ifndef AES_CPP17_AES_KEY_BATCH_H
+#define AES_CPP17_AES_KEY_BATCH_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+
+#include "aes_encrypt.h"
+#include "aes_key_schedule.h"
+#include "cpu_features.h"
+
+namespace crypto::aes {
+
+    /**
+     * @brief A batch of up to LANES expanded keys filled at once - bulk rekeying (say on a key rotation across every
+     * tenant) runs LANES keys per pass through the expansion, with AES-NI when that is the active_kernel().
+     * ```
+     * crypto::aes::key_batch<> batch(keys.begin(), keys.end()); // the first 8 keys
+     * crypto::block_cipher<crypto::CTR> aes(batch.cipher(3));
+     * ```
+     * @tparam R
+     * @tparam N
+     * @tparam LANES 4 to 16 keys per batch
+     */
+    template<ROUNDS R = R256, KEY_LENGTH N = N256, size_t LANES = 8>
+    class key_batch {
+
+        static_assert(LANES >= 4 && LANES <= 16, "4 to 16 lanes");
+
+    public:
+
+        using block_t = std::array<uint8_t, BLOCK_SIZE>;
+
+        key_batch() = default;
+
+        /**
+         * @brief expand the first LANES (or fewer) keys of the range
+         * @tparam KeyIterator to key sequences, each contiguous in memory e.g. std::array or std::vector
+         */
+        template<typename KeyIterator>
+        key_batch(KeyIterator first, KeyIterator last) {
+            rekey(first, last);
+        }
+
+        /**
+         * @brief re-expand the batch in place with the first LANES (or fewer) keys of the range
+         * @return size_t the number of keys taken
+         */
+        template<typename KeyIterator>
+        size_t rekey(KeyIterator first, KeyIterator last) {
+            std::array<const uint8_t*, LANES> keys{};
+            size_ = 0;
+            for(; first != last && size_ < LANES; ++first) {
+                keys[size_++] = reinterpret_cast<const uint8_t*>(&*std::begin(*first));
+            }
+#ifdef AES_CPP17_X86
+            if(active_kernel() == AESNI) {
+                key_schedule::expand_aesni<R, N, LANES>(keys.data(), size_, store_);
+                return size_;
+            }
+#endif
+            key_schedule::expand_portable<R, N, LANES>(keys.data(), size_, store_);
+            return size_;
+        }
+
+        /**
+         * @return const block_t& round key _round_ of _lane_
+         */
+        inline const block_t& round_key(size_t round, size_t lane) const {
+            return store_[round][lane];
+        }
+
+        /**
+         * @return const uint8_t* round key _round_ of every lane, LANES blocks back to back
+         */
+        inline const uint8_t* round(size_t round) const {
+            return store_[round].data()->data();
+        }
+
+        /**
+         * @brief the cipher for _lane_, a copy of its round keys rather than an expansion
+         */
+        encrypt<R, N> cipher(size_t lane) const {
+            std::array<uint8_t, R * BLOCK_SIZE> xkey;
+            for(size_t r{0}; r < R; ++r) {
+                std::copy(store_[r][lane].begin(), store_[r][lane].end(), xkey.begin() + r * BLOCK_SIZE);
+            }
+            return encrypt<R, N>::from_round_keys(xkey.begin());
+        }
+
+        inline size_t size() const {
+            return size_;
+        }
+
+        constexpr static size_t lanes() {
+            return LANES;
+        }
+
+    private:
+
+        alignas(CACHE_LINE) key_schedule::store_t<R, LANES> store_{};
+
+        size_t size_{0};
+
+    };
+
+}
+
+#endif //AES_CPP17_AES_KEY_BATCH_H
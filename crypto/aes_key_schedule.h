@@ -0,0 +1,199 @@
+#ifndef AES_CPP17_AES_KEY_SCHEDULE_H
+#define AES_CPP17_AES_KEY_SCHEDULE_H
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#include "aes_encrypt.h"
+#include "cpu_features.h"
+
+#ifdef AES_CPP17_X86
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+namespace crypto::aes {
+
+    /**
+     * Key expansion kernels filling a structure-of-arrays store: round r of lane l is at store[r][l], so a multi-key
+     * engine reads the r-th round key of every lane from one contiguous run.
+     */
+    namespace key_schedule {
+
+        template<ROUNDS R, size_t LANES>
+        using store_t = std::array<std::array<std::array<uint8_t, BLOCK_SIZE>, LANES>, R>;
+
+        /**
+         * @brief portable expansion of up to LANES keys in lock step a 32 bit word at a time
+         * The lanes are the inner loop so the word XORs, the bulk of the work, compile to SIMD; the S-box lookups
+         * remain scalar.
+         * @param keys LANES pointers to contiguous keys of N words, only the first _count_ are read
+         * @param count
+         * @param store
+         */
+        template<ROUNDS R, KEY_LENGTH N, size_t LANES>
+        void expand_portable(const uint8_t* const* keys, size_t count, store_t<R, LANES>& store) {
+            std::array<std::array<uint32_t, LANES>, R * 4> w{}; // word i of every lane, little endian bytes
+            for(size_t l{0}; l < count; ++l) {
+                for(size_t i{0}; i < N; ++i) {
+                    w[i][l] = keys[l][4 * i] | keys[l][4 * i + 1] << 8u | keys[l][4 * i + 2] << 16u
+                              | static_cast<uint32_t>(keys[l][4 * i + 3]) << 24u;
+                }
+            }
+            auto sub_word = [](uint32_t x) {
+                return static_cast<uint32_t>(sbox[x & 0xFFu]) | sbox[(x >> 8u) & 0xFFu] << 8u
+                       | sbox[(x >> 16u) & 0xFFu] << 16u | static_cast<uint32_t>(sbox[x >> 24u]) << 24u;
+            };
+            for(size_t i{N}; i < R * 4; ++i) {
+                std::array<uint32_t, LANES> temp = w[i - 1];
+                if(i % N == 0) {
+                    for(auto& t: temp) {
+                        t = sub_word(t >> 8u | t << 24u) ^ Rcon[i / N]; // RotWord then SubWord
+                    }
+                } else if(N > 6 && i % N == 4) { // extension for AES-256
+                    for(auto& t: temp) {
+                        t = sub_word(t);
+                    }
+                }
+                for(size_t l{0}; l < LANES; ++l) {
+                    w[i][l] = w[i - N][l] ^ temp[l];
+                }
+            }
+            for(size_t r{0}; r < R; ++r) {
+                for(size_t l{0}; l < count; ++l) {
+                    for(size_t j{0}; j < BLOCK_SIZE; ++j) {
+                        store[r][l][j] = static_cast<uint8_t>(w[4 * r + j / 4][l] >> (8 * (j % 4)));
+                    }
+                }
+            }
+        }
+
+#ifdef AES_CPP17_X86
+
+        /**
+         * @brief the AES-NI expansions after Intel's AES New Instructions Set white paper (Gueron), each step is run
+         * across every lane before the next so that the AESKEYGENASSIST latencies of independent keys overlap
+         */
+        namespace aesni {
+
+            AES_CPP17_TARGET("sse2") inline __m128i fold(__m128i key) {
+                key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+                key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+                return _mm_xor_si128(key, _mm_slli_si128(key, 4));
+            }
+
+            /**
+             * @note the round constant is a template argument because AESKEYGENASSIST takes an 8-bit immediate, which
+             * ```Rcon[I]``` is not to GCC at -O0 where the intrinsic is a macro
+             */
+            template<size_t I, int RC = Rcon[I]>
+            AES_CPP17_TARGET("aes") inline void step_128(__m128i* k, size_t count, __m128i* out, size_t stride) {
+                for(size_t l{0}; l < count; ++l) {
+                    const __m128i t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(k[l], RC), 0xFF);
+                    k[l] = _mm_xor_si128(fold(k[l]), t);
+                    _mm_storeu_si128(out + I * stride + l, k[l]);
+                }
+            }
+
+            template<size_t LANES, size_t... I>
+            AES_CPP17_TARGET("aes") void expand_128(const uint8_t* const* keys, size_t count, __m128i* out,
+                                                    size_t stride, std::index_sequence<I...>) {
+                __m128i k[LANES];
+                for(size_t l{0}; l < count; ++l) {
+                    k[l] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys[l]));
+                    _mm_storeu_si128(out + l, k[l]);
+                }
+                (step_128<I + 1>(k, count, out, stride), ...);
+            }
+
+            template<size_t I, int RC = Rcon[I]>
+            AES_CPP17_TARGET("aes") inline void step_256(__m128i* a, __m128i* b, size_t count, __m128i* out,
+                                                         size_t stride) {
+                for(size_t l{0}; l < count; ++l) {
+                    __m128i t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(b[l], RC), 0xFF);
+                    a[l] = _mm_xor_si128(fold(a[l]), t);
+                    _mm_storeu_si128(out + 2 * I * stride + l, a[l]);
+                    if(I < 7) { // the 15th round key is the last
+                        t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(a[l], 0x00), 0xAA);
+                        b[l] = _mm_xor_si128(fold(b[l]), t);
+                        _mm_storeu_si128(out + (2 * I + 1) * stride + l, b[l]);
+                    }
+                }
+            }
+
+            template<size_t LANES, size_t... I>
+            AES_CPP17_TARGET("aes") void expand_256(const uint8_t* const* keys, size_t count, __m128i* out,
+                                                    size_t stride, std::index_sequence<I...>) {
+                __m128i a[LANES], b[LANES];
+                for(size_t l{0}; l < count; ++l) {
+                    a[l] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys[l]));
+                    b[l] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys[l] + 16));
+                    _mm_storeu_si128(out + l, a[l]);
+                    _mm_storeu_si128(out + stride + l, b[l]);
+                }
+                (step_256<I + 1>(a, b, count, out, stride), ...);
+            }
+
+            /**
+             * @brief AES-192 produces 1.5 round keys per step, _a_ the full 4 words and _b_ the low 2
+             */
+            template<size_t I, int RC = Rcon[I]>
+            AES_CPP17_TARGET("aes") inline void step_192(__m128i* a, __m128i* b, size_t count, uint8_t* out,
+                                                         size_t stride) {
+                for(size_t l{0}; l < count; ++l) {
+                    __m128i t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(b[l], RC), 0x55);
+                    a[l] = _mm_xor_si128(fold(a[l]), t);
+                    t = _mm_shuffle_epi32(a[l], 0xFF);
+                    b[l] = _mm_xor_si128(_mm_xor_si128(b[l], _mm_slli_si128(b[l], 4)), t);
+                    std::array<uint8_t, 24> words; // 6 words, 24 * I bytes into the schedule
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(words.data()), a[l]);
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(words.data() + 16), b[l]);
+                    const size_t offset = 24 * I;
+                    for(size_t j{0}; j < words.size() && offset + j < R192 * BLOCK_SIZE; ++j) {
+                        const size_t byte = offset + j;
+                        out[((byte / BLOCK_SIZE) * stride + l) * BLOCK_SIZE + byte % BLOCK_SIZE] = words[j];
+                    }
+                }
+            }
+
+            template<size_t LANES, size_t... I>
+            AES_CPP17_TARGET("aes") void expand_192(const uint8_t* const* keys, size_t count, uint8_t* out,
+                                                    size_t stride, std::index_sequence<I...>) {
+                __m128i a[LANES], b[LANES];
+                for(size_t l{0}; l < count; ++l) {
+                    a[l] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys[l]));
+                    b[l] = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(keys[l] + 16));
+                    for(size_t j{0}; j < 24; ++j) {
+                        out[((j / BLOCK_SIZE) * stride + l) * BLOCK_SIZE + j % BLOCK_SIZE] = keys[l][j];
+                    }
+                }
+                (step_192<I + 1>(a, b, count, out, stride), ...);
+            }
+
+        }
+
+        /**
+         * @brief AES-NI expansion of up to LANES keys
+         * @note only call when can_aesni()
+         */
+        template<ROUNDS R, KEY_LENGTH N, size_t LANES>
+        void expand_aesni(const uint8_t* const* keys, size_t count, store_t<R, LANES>& store) {
+            auto* out = reinterpret_cast<__m128i*>(store.data()->data()->data());
+            if constexpr (N == N128) {
+                aesni::expand_128<LANES>(keys, count, out, LANES, std::make_index_sequence<10>());
+            } else if constexpr (N == N192) {
+                aesni::expand_192<LANES>(keys, count, store.data()->data()->data(), LANES,
+                                         std::make_index_sequence<8>());
+            } else {
+                aesni::expand_256<LANES>(keys, count, out, LANES, std::make_index_sequence<7>());
+            }
+        }
+
+#endif
+
+    }
+
+}
+
+#endif //AES_CPP17_AES_KEY_SCHEDULE_H
@@ -7,34 +7,10 @@
 
 namespace crypto::aes {
 
-    /**
-     * TODO table lookup of values for x×9, x×11, x×13 and x×14 https://en.wikipedia.org/wiki/Rijndael_MixColumns
-     * @brief Inverse multiplication in a finite field for the inverse mix column directions.
-     * A series of GF(2^8) multiplications however, instead of multiplying by 1, 2 and 3, as for encrypt multiplying
-     * by 9, 11, 13 and 14.
-     * Mix column matrix _M_, it is true that M^4 = I, therefore performing this transformation thrice...
-     * results in its inverse (M^3=M^−1).
-     * So the multiplication rule is a little more complex than the x 2 rule @see GF2 but can be intuitively achieved
-     * by taking the x×2 function and using it three times over: (GF '+' is XOR)
-     * x×9=(((x×2)×2)×2)+x
-     * x×11=((((x×2)×2)+x)×2)+x
-     * x×13=((((x×2)+x)×2)×2)+x
-     * x×14=((((x×2)+x)×2)+x)×2
-     * @note it is slower than using a lookup table
-     * @param x
-     * @param y
-     * @return
-     */
-    static inline uint_fast32_t GFmul(uint_fast32_t x, uint_fast32_t y) {
-        return ((y & 1u) * x) ^
-               ((y >> 1u & 1u) * GF2(x)) ^
-               ((y >> 2u & 1u) * GF2(GF2(x))) ^
-               (y >> 3u & 1u) * GF2(GF2(GF2(x))) ^
-               ((y >> 4u & 1u) * GF2(GF2(GF2(GF2(x)))));
-    }
-
     /**
      * The Rijndael inverse S-Box lookup table for decryption if using ECB or CBC
+     * @note inverse mix columns needs no ×9, ×11, ×13, ×14 table or multiply, it factors in to the forward mix
+     * columns of a pre-multiplied column @see decrypt::inv_mix_columns
      */
     static constexpr uint8_t rsbox[256] = {
             //0     1    2      3     4    5     6     7      8    9     A      B    C     D     E     F
@@ -0,0 +1,156 @@
+#ifndef AES_CPP17_ASYNC_CIPHER_H
+#define AES_CPP17_ASYNC_CIPHER_H
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+
+#include <algorithm>
+#include <coroutine>
+#include <exception>
+#include <iterator>
+
+#include "chained_cipher.h"
+
+namespace crypto {
+
+    /**
+     * @brief tuning for the awaitable cipher jobs
+     * + chunk_size bytes encrypted per step before yielding back to the executor
+     * + inline_limit jobs up to this size never leave the awaiting coroutine's thread
+     */
+    struct async_options {
+        size_t chunk_size = 64 * 1024;
+        size_t inline_limit = 16 * 1024;
+    };
+
+    /**
+     * @brief C++20 awaitable block_cipher job
+     * Small jobs are done inline in await_ready and never suspend. Large jobs suspend the awaiting coroutine and are
+     * posted to the executor one chunk at a time: each step re-posts the next so that other tasks queued on the same
+     * executor get a turn in between, and the final step resumes the awaiting coroutine on the executor.
+     * Chunk by chunk gives exactly the same result as block_cipher::encrypt/decrypt on the whole range.
+     * @note the same predicates as the block_cipher API apply, e.g. the IV or nonce-counter block precedes _front_,
+     * and the cipher, range and executor must outlive the co_await
+     * @tparam C block_cipher<M, T, U>
+     * @tparam Iterator random access
+     * @tparam Executor anything with ```post(F&&)``` e.g. util::thread_pool
+     * @tparam Encrypt true encrypt, false decrypt
+     */
+    template<typename C, typename Iterator, typename Executor, bool Encrypt>
+    class cipher_awaitable {
+
+    public:
+
+        using block_t = typename C::block_t;
+
+        cipher_awaitable(C& cipher, Iterator front, Iterator back, Executor& executor, async_options options):
+            executor_(executor), chain_(cipher, iv(front)), front_(front), back_(back), options_(options)
+        {
+            options_.chunk_size = std::max(options_.chunk_size - options_.chunk_size % BLOCK_SIZE, BLOCK_SIZE);
+        }
+
+        bool await_ready() {
+            if(static_cast<size_t>(std::distance(front_, back_)) > options_.inline_limit) {
+                return false;
+            }
+            while(front_ != back_) {
+                step();
+            }
+            return true;
+        }
+
+        void await_suspend(std::coroutine_handle<> awaiting) {
+            awaiting_ = awaiting;
+            executor_.post([this] { resume(); });
+        }
+
+        void await_resume() {
+            if(error_) {
+                std::rethrow_exception(error_);
+            }
+        }
+
+    private:
+
+        static block_t iv(Iterator front) {
+            block_t b{};
+            if constexpr (C::mode() != ECB) {
+                std::copy(front - BLOCK_SIZE, front, b.begin());
+            }
+            return b;
+        }
+
+        /**
+         * @brief one chunk, with the block in front of it (the previous chunk's last block) preserved because
+         * chained_cipher uses it as scratch
+         */
+        void step() {
+            const auto n = std::min(static_cast<size_t>(std::distance(front_, back_)), options_.chunk_size);
+            Iterator next = front_ + n;
+            block_t saved{};
+            if constexpr (C::mode() != ECB) {
+                std::copy(front_ - BLOCK_SIZE, front_, saved.begin());
+            }
+            if constexpr (Encrypt) {
+                chain_.encrypt(front_, next);
+            } else {
+                chain_.decrypt(front_, next);
+            }
+            if constexpr (C::mode() != ECB) {
+                std::copy(saved.begin(), saved.end(), front_ - BLOCK_SIZE);
+            }
+            front_ = next;
+        }
+
+        void resume() {
+            try {
+                step();
+            } catch(...) {
+                error_ = std::current_exception();
+                front_ = back_;
+            }
+            if(front_ == back_) {
+                awaiting_.resume();
+            } else {
+                executor_.post([this] { resume(); }); // yield to whatever else is queued
+            }
+        }
+
+        Executor& executor_;
+
+        chained_cipher<C> chain_;
+
+        Iterator front_;
+
+        Iterator back_;
+
+        async_options options_;
+
+        std::coroutine_handle<> awaiting_;
+
+        std::exception_ptr error_;
+
+    };
+
+    /**
+     * @brief ```co_await crypto::async_encrypt(aes, data.begin() + 16, data.end(), pool);```
+     */
+    template<typename C, typename Iterator, typename Executor>
+    cipher_awaitable<C, Iterator, Executor, true> async_encrypt(C& cipher, Iterator front, Iterator back,
+                                                                Executor& executor, async_options options = {}) {
+        return {cipher, front, back, executor, options};
+    }
+
+    /**
+     * @brief ```co_await crypto::async_decrypt(aes, data.begin() + 16, data.end(), pool);```
+     */
+    template<typename C, typename Iterator, typename Executor>
+    cipher_awaitable<C, Iterator, Executor, false> async_decrypt(C& cipher, Iterator front, Iterator back,
+                                                                 Executor& executor, async_options options = {}) {
+        return {cipher, front, back, executor, options};
+    }
+
+}
+
+#endif
+
+#endif //AES_CPP17_ASYNC_CIPHER_H
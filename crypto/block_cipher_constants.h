@@ -2,6 +2,20 @@
 #define AES_CPP17_BLOCK_CIPHER_CONSTANTS_H
 
 #include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * Force inlining of the small round helpers: once the rounds are unrolled each helper is called R times, which the
+ * compiler's code growth heuristics otherwise take as a reason to call it out of line.
+ */
+#if defined(_MSC_VER)
+#define AES_CPP17_INLINE __forceinline
+#elif defined(__GNUC__)
+#define AES_CPP17_INLINE __attribute__((always_inline)) inline
+#else
+#define AES_CPP17_INLINE inline
+#endif
 
 namespace crypto {
 
@@ -20,6 +34,12 @@ namespace crypto {
 
     constexpr static size_t WORD_SIZE = 4; //bytes
 
+    /**
+     * Cache line size (bytes) on x86-64 and most ARMv8 cores - state written by one thread and read by others is
+     * aligned to it so that unrelated writes do not false-share a line.
+     */
+    constexpr static size_t CACHE_LINE = 64;
+
     /**
      * Nonce size (bytes)
      * @warning An 8 byte nonce is not secure as a general recommendation.
@@ -27,13 +47,41 @@ namespace crypto {
      */
     constexpr static size_t NONCE_SIZE = 12;
 
-#ifdef _MSC_VER
+    /**
+     * @brief SFINAE guard for the constructors taking a key sequence by forwarding reference, which would otherwise be
+     * a better match than the copy constructor for a non-const lvalue of the class itself (or of the other classes
+     * it has constructors for)
+     * @tparam Sequence
+     * @tparam Self
+     */
+    template<typename Sequence, typename... Self>
+    using enable_if_key_t = std::enable_if_t<(!std::is_same_v<std::decay_t<Sequence>, Self> && ...)>;
 
-    constexpr static size_t bit_RDRAND = 0x40000000; // bit 30 EBX set if RDSEED instruction implemented
+    /**
+     * @brief opt-in for a decrypt cipher _U_ that can take its schedule from a constructed encrypt cipher _T_ rather
+     * than expanding the key again - block_cipher otherwise keys _U_ from the key sequence, so a third party pair
+     * whose constructors forward any sequence is never handed the encrypt object as its "key"
+     * @tparam U decrypt cipher
+     * @tparam T encrypt cipher
+     */
+    template<typename U, typename T>
+    struct derives_from_encrypt : std::false_type {};
 
-    constexpr static size_t bit_RDSEED = 0x00040000; // bit 18 EBX set if RDSEED instruction implemented
+    template<typename U, typename T>
+    constexpr bool derives_from_encrypt_v = derives_from_encrypt<U, T>::value;
 
-#endif
+    /**
+     * @brief zero _n_ bytes of key material through a volatile pointer, so that the stores are not optimised away as
+     * dead stores just before the memory is freed or goes out of scope
+     * @param p
+     * @param n
+     */
+    inline void secure_wipe(void* p, size_t n) {
+        volatile auto* v = static_cast<volatile uint8_t*>(p);
+        while(n--) {
+            *v++ = 0;
+        }
+    }
 
 }
 
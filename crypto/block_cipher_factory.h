@@ -7,6 +7,9 @@
 
 #include "aes_encrypt.h"
 #include "aes_decrypt.h"
+#include "aes_kernels.h"
+#include "cipher_exception.h"
+#include "padder_factory.h"
 
 namespace crypto {
 
@@ -24,6 +27,81 @@ namespace crypto {
         ECB, CBC, CTR // PCBC, CFB, OFB,
     };
 
+    /**
+     * @brief the decrypt cipher for a key: derived from the already expanded encrypt cipher when _U_ opts in with
+     * derives_from_encrypt, keyed from the key sequence otherwise
+     */
+    template<typename U, typename T, class KeySequence>
+    U make_decrypt(const T& encrypt, const KeySequence& kseq) {
+        if constexpr (derives_from_encrypt_v<U, T>) {
+            return U(encrypt);
+        } else {
+            return U(kseq);
+        }
+    }
+
+    template<typename U, typename T, class KeySequence>
+    void rekey_decrypt(U& decrypt, const T& encrypt, const KeySequence& kseq) {
+        if constexpr (derives_from_encrypt_v<U, T>) {
+            decrypt.rekey(encrypt);
+        } else {
+            decrypt.rekey(kseq);
+        }
+    }
+
+    /**
+     * @brief encrypt an unpadded message into _out_ a block at a time, padding the final block on the fly - shared by
+     * the block modes, whose encrypt chains or not as the mode requires
+     * @tparam P padder, its block size must be the cipher's
+     * @tparam C block cipher
+     * @tparam ConstIterator
+     * @tparam Iterator
+     * @param cipher
+     * @param first
+     * @param last
+     * @param out
+     * @return size_t cipher text bytes written
+     */
+    template<typename P, class C, typename ConstIterator, typename Iterator>
+    size_t padded_encrypt(C& cipher, ConstIterator first, ConstIterator last, Iterator out) {
+        static_assert(P::block_size() == BLOCK_SIZE, "the padder must pad to the cipher block size");
+        const auto n = static_cast<size_t>(std::distance(first, last));
+        const size_t whole = n - n % BLOCK_SIZE;
+        for(size_t i{0}; i < whole; i += BLOCK_SIZE, first += BLOCK_SIZE) { // a block at a time while it is hot
+            std::copy(first, first + BLOCK_SIZE, out + i);
+            cipher.encrypt(out + i, out + i + BLOCK_SIZE);
+        }
+        typename C::block_t last_block{};
+        auto it = std::copy(first, last, last_block.begin());
+        if(n - whole + P().pad(first, last, it) == 0) { // zero padding adds nothing to an aligned message
+            return whole;
+        }
+        std::copy(last_block.begin(), last_block.end(), out + whole);
+        cipher.encrypt(out + whole, out + whole + BLOCK_SIZE);
+        return whole + BLOCK_SIZE;
+    }
+
+    /**
+     * @brief decrypt in place and check and strip the padding
+     * @tparam P padder, its block size must be the cipher's
+     * @tparam C block cipher
+     * @tparam Iterator
+     * @param cipher
+     * @param front
+     * @param back
+     * @return size_t the length of the plain text without its padding
+     */
+    template<typename P, class C, typename Iterator>
+    size_t unpadded_decrypt(C& cipher, Iterator front, Iterator back) {
+        static_assert(P::block_size() == BLOCK_SIZE, "the padder must pad to the cipher block size");
+        const auto n = static_cast<size_t>(std::distance(front, back));
+        if(n % BLOCK_SIZE) {
+            throw doh::cipher_exception(doh::ALIGNMENT);
+        }
+        cipher.decrypt(front, back);
+        return n - P().unpad(front, back);
+    }
+
     /**
      * @brief Electronic Codebook
      * @warning  Not recommended for use in cryptographic protocols at all!
@@ -41,30 +119,88 @@ namespace crypto {
         using block_t = typename T::block_t;
         using value_type = typename T::value_type;
 
-        template<class KeySequence>
-        explicit block_cipher(KeySequence &&kseq): encrypt_(kseq), decrypt_(kseq) {}
+        /**
+         * @note the key is expanded once when the decrypt schedule derives from the encrypt schedule @see derives_from_encrypt
+         */
+        template<class KeySequence, typename = enable_if_key_t<KeySequence, block_cipher>>
+        explicit block_cipher(KeySequence &&kseq):
+                encrypt_(kernel::make<T>(kseq)), decrypt_(make_decrypt<U>(encrypt_, kseq)) {}
+
+        //copying or moving copies the expanded keys, there is nothing to re-expand
+        block_cipher(const block_cipher&) = default;
+        block_cipher(block_cipher&&) noexcept = default;
+        block_cipher& operator=(const block_cipher&) = default;
+        block_cipher& operator=(block_cipher&&) noexcept = default;
 
-        //Constructor accepting a forwarding reference can hide copy and move constructors
-        block_cipher(const block_cipher&) = delete;
-        block_cipher(block_cipher&&) = delete;
-        block_cipher& operator=(const block_cipher&) = delete;
-        block_cipher& operator=(block_cipher&&) = delete;
+        /**
+         * @brief re-expand the key schedules in place e.g. to rotate the key of a pooled cipher
+         * @tparam KeySequence
+         * @param kseq
+         */
+        template<class KeySequence>
+        void rekey(const KeySequence &kseq) {
+            kernel::rekey(encrypt_, kseq);
+            rekey_decrypt(decrypt_, encrypt_, kseq);
+        }
 
+        /**
+         * @note contiguous bytes are encrypted by the active kernel in one call @see aes_kernels.h
+         */
         template<typename Iterator>
         void encrypt(Iterator front, Iterator back) {
-            for(Iterator it = front; it != back; it += 16) {
-                encrypt_.block(it);
+            if constexpr (kernel::dispatches_v<T, Iterator>) {
+                if(front != back) {
+                    kernel::encrypt(encrypt_, &*front, static_cast<size_t>(back - front) / BLOCK_SIZE);
+                }
+            } else {
+                for(Iterator it = front; it != back; it += 16) {
+                    encrypt_.block(it);
+                }
             }
         }
 
         template<typename Iterator>
         void decrypt(Iterator front, Iterator back) {
-            for(Iterator it = front; it != back; it += 16) {
-                decrypt_.block(it);
+            if constexpr (kernel::dispatches_v<U, Iterator>) {
+                if(front != back) {
+                    kernel::decrypt(decrypt_, &*front, static_cast<size_t>(back - front) / BLOCK_SIZE);
+                }
+            } else {
+                for(Iterator it = front; it != back; it += 16) {
+                    decrypt_.block(it);
+                }
             }
         }
 
-        static inline cipher_mode_t mode() {
+        /**
+         * @brief encrypt an unpadded message into _out_ applying the padding to the final block on the fly, so the
+         * plain text container never has to grow (and perhaps reallocate) to make room for it
+         * @note _out_ may be _first_ i.e. in place, but needs room for padded_size(last - first) bytes
+         * @see crypto::padded_encrypt
+         */
+        template<typename P = padder<>, typename ConstIterator, typename Iterator>
+        size_t encrypt_padded(ConstIterator first, ConstIterator last, Iterator out) {
+            return padded_encrypt<P>(*this, first, last, out);
+        }
+
+        /**
+         * @brief decrypt in place and check and strip the padding
+         * @see crypto::unpadded_decrypt
+         */
+        template<typename P = padder<>, typename Iterator>
+        size_t decrypt_and_unpad(Iterator front, Iterator back) {
+            return unpadded_decrypt<P>(*this, front, back);
+        }
+
+        /**
+         * @brief room needed for a padded _n_ byte message - every padding scheme adds 1 to BLOCK_SIZE bytes, save
+         * zero padding which adds nothing to an aligned message (encrypt_padded returns the actual size)
+         */
+        constexpr static size_t padded_size(size_t n) {
+            return n - n % BLOCK_SIZE + BLOCK_SIZE;
+        }
+
+        constexpr static cipher_mode_t mode() {
             return M;
         }
 
@@ -96,14 +232,29 @@ namespace crypto {
         using block_t = typename T::block_t;
         using value_type = typename T::value_type;
 
-        template<class KeySequence>
-        explicit block_cipher(KeySequence &&kseq): encrypt_(kseq), decrypt_(kseq) {}
+        /**
+         * @note the key is expanded once when the decrypt schedule derives from the encrypt schedule @see derives_from_encrypt
+         */
+        template<class KeySequence, typename = enable_if_key_t<KeySequence, block_cipher>>
+        explicit block_cipher(KeySequence &&kseq):
+                encrypt_(kernel::make<T>(kseq)), decrypt_(make_decrypt<U>(encrypt_, kseq)) {}
 
-        //Constructor accepting a forwarding reference can hide copy and move constructors
-        block_cipher(const block_cipher&) = delete;
-        block_cipher(block_cipher&&) = delete;
-        block_cipher& operator=(const block_cipher&) = delete;
-        block_cipher& operator=(block_cipher&&) = delete;
+        //copying or moving copies the expanded keys, there is nothing to re-expand
+        block_cipher(const block_cipher&) = default;
+        block_cipher(block_cipher&&) noexcept = default;
+        block_cipher& operator=(const block_cipher&) = default;
+        block_cipher& operator=(block_cipher&&) noexcept = default;
+
+        /**
+         * @brief re-expand the key schedules in place e.g. to rotate the key of a pooled cipher
+         * @tparam KeySequence
+         * @param kseq
+         */
+        template<class KeySequence>
+        void rekey(const KeySequence &kseq) {
+            kernel::rekey(encrypt_, kseq);
+            rekey_decrypt(decrypt_, encrypt_, kseq);
+        }
 
         /**
          * @note predicated on the presence of the initialisation vector prepended to the front
@@ -113,6 +264,13 @@ namespace crypto {
          */
         template<typename Iterator>
         void encrypt(Iterator front, Iterator back) {
+            if constexpr (kernel::dispatches_v<T, Iterator>) { // the whole chain in one call, round keys loaded once
+                if(front != back) {
+                    const auto blocks = static_cast<size_t>(back - front) / BLOCK_SIZE;
+                    kernel::cbc_encrypt(encrypt_, &*(front - 16), &*front, blocks);
+                }
+                return;
+            }
             for(Iterator it = front; it != back; it += 16) {
                 //reach back 16 bytes to xor the previous block into this one
                 //std::transform(it, it + 16, it - 16, it, std::bit_xor<uint8_t>());
@@ -129,6 +287,20 @@ namespace crypto {
          */
         template<typename Iterator>
         void decrypt(Iterator front, Iterator back) {
+            if constexpr (kernel::dispatches_v<U, Iterator>) { // decryption is parallel, a chunk of blocks per call
+                constexpr size_t CHUNK = 8 * BLOCK_SIZE;
+                std::array<value_type, BLOCK_SIZE + CHUNK> cipher_text; // the preceding block then the chunk
+                std::copy(front - 16, front, cipher_text.begin());
+                for(Iterator it = front; it != back;) {
+                    const size_t n = std::min(CHUNK, static_cast<size_t>(back - it));
+                    std::copy(it, it + n, cipher_text.begin() + BLOCK_SIZE);
+                    kernel::decrypt(decrypt_, &*it, n / BLOCK_SIZE);
+                    std::transform(it, it + n, cipher_text.begin(), it, std::bit_xor<>());
+                    std::copy(cipher_text.begin() + n, cipher_text.begin() + n + BLOCK_SIZE, cipher_text.begin());
+                    it += n;
+                }
+                return;
+            }
             //initialize the xor block with the iv block preceding the front
             std::vector<value_type>xor_block(front - 16, front);
             std::vector<value_type>xor_next(block_size());
@@ -143,7 +315,37 @@ namespace crypto {
             }
         }
 
-        static inline cipher_mode_t mode() {
+        /**
+         * @brief encrypt an unpadded message into _out_ applying the padding to the final block on the fly, so the
+         * plain text container never has to grow (and perhaps reallocate) to make room for it
+         * @note _out_ may be _first_ i.e. in place, but needs room for padded_size(last - first) bytes
+         * @note predicated on the presence of the initialisation vector prepended to the output
+         * @see crypto::padded_encrypt
+         */
+        template<typename P = padder<>, typename ConstIterator, typename Iterator>
+        size_t encrypt_padded(ConstIterator first, ConstIterator last, Iterator out) {
+            return padded_encrypt<P>(*this, first, last, out);
+        }
+
+        /**
+         * @brief decrypt in place and check and strip the padding
+         * @note predicated on the presence of the initialisation vector prepended to the front
+         * @see crypto::unpadded_decrypt
+         */
+        template<typename P = padder<>, typename Iterator>
+        size_t decrypt_and_unpad(Iterator front, Iterator back) {
+            return unpadded_decrypt<P>(*this, front, back);
+        }
+
+        /**
+         * @brief room needed for a padded _n_ byte message - every padding scheme adds 1 to BLOCK_SIZE bytes, save
+         * zero padding which adds nothing to an aligned message (encrypt_padded returns the actual size)
+         */
+        constexpr static size_t padded_size(size_t n) {
+            return n - n % BLOCK_SIZE + BLOCK_SIZE;
+        }
+
+        constexpr static cipher_mode_t mode() {
             return CBC;
         }
 
@@ -170,8 +372,9 @@ namespace crypto {
      * + Counter  mode (CM) is also known as integer counter mode (ICM) and segmented integer counter (SIC) mode
      * + CTR mode was introduced by Whitfield Diffie and Martin Hellman in 1979.
      * + Along with CBC, CTR mode is one of two block cipher modes recommended by Niels Ferguson and Bruce Schneier.
+     * + Only the forward cipher is ever run, so there is no decrypt key schedule to expand at all.
      * @tparam T
-     * @tparam U
+     * @tparam U unused
      */
     template<typename T, typename U>
     class block_cipher<CTR, T, U> {
@@ -181,14 +384,24 @@ namespace crypto {
         using block_t = typename T::block_t;
         using value_type = typename T::value_type;
 
-        template<class KeySequence>
-        explicit block_cipher(KeySequence &&kseq): encrypt_(kseq), decrypt_(kseq) {}
+        template<class KeySequence, typename = enable_if_key_t<KeySequence, block_cipher>>
+        explicit block_cipher(KeySequence &&kseq): encrypt_(kernel::make<T>(kseq)) {}
 
-        //Constructor accepting a forwarding reference can hide copy and move constructors
-        block_cipher(const block_cipher&) = delete;
-        block_cipher(block_cipher&&) = delete;
-        block_cipher& operator=(const block_cipher&) = delete;
-        block_cipher& operator=(block_cipher&&) = delete;
+        //copying or moving copies the expanded keys, there is nothing to re-expand
+        block_cipher(const block_cipher&) = default;
+        block_cipher(block_cipher&&) noexcept = default;
+        block_cipher& operator=(const block_cipher&) = default;
+        block_cipher& operator=(block_cipher&&) noexcept = default;
+
+        /**
+         * @brief re-expand the key schedules in place e.g. to rotate the key of a pooled cipher
+         * @tparam KeySequence
+         * @param kseq
+         */
+        template<class KeySequence>
+        void rekey(const KeySequence &kseq) {
+            kernel::rekey(encrypt_, kseq);
+        }
 
         /**
          * @note predicated on the presence of a nonce prepended to the front
@@ -198,6 +411,14 @@ namespace crypto {
          */
         template<typename Iterator>
         void encrypt(Iterator front, Iterator back) {
+            if constexpr (kernel::dispatches_v<T, Iterator>) {
+                block_t counter;
+                std::copy(front - 16, front, counter.begin());
+                if(front != back) {
+                    kernel::ctr(encrypt_, counter.data(), &*front, static_cast<size_t>(back - front));
+                }
+                return;
+            }
             //initialize the counter with the nonce block preceding the front
             std::vector<value_type>ctr(front - 16, front);
             //copy it into the xor block
@@ -233,13 +454,28 @@ namespace crypto {
             if (block[0 ] == 255) block[0 ] = 0; else { block[0 ] += 1; return; }
         }
 
+        /**
+         * @brief advance the 128 bit big endian counter by _n_ blocks in one go
+         * @note lets a chunked or random access caller seek the counter without _n_ calls to inc_block
+         * @param block
+         * @param n number of blocks to advance
+         */
+        template<class Sequence>
+        static inline void inc_block(Sequence& block, uint64_t n) {
+            for(size_t i{16}; n && i--;) {
+                uint_fast32_t sum = block[i] + (n & 0xFFu);
+                block[i] = static_cast<value_type>(sum & 0xFFu);
+                n = (n >> 8u) + (sum >> 8u);
+            }
+        }
+
         template<typename Iterator>
         void decrypt(Iterator front, Iterator back) {
             //just call encrypt
             encrypt(front, back);
         }
 
-        static inline cipher_mode_t mode() {
+        constexpr static cipher_mode_t mode() {
             return CTR;
         }
 
@@ -251,8 +487,6 @@ namespace crypto {
 
         T encrypt_;
 
-        U decrypt_;
-
     };
 
 
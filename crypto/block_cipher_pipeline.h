@@ -0,0 +1,220 @@
+#ifndef AES_CPP17_BLOCK_CIPHER_PIPELINE_H
+#define AES_CPP17_BLOCK_CIPHER_PIPELINE_H
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "chained_cipher.h"
+#include "../util/spsc_queue.h"
+
+namespace crypto {
+
+    /**
+     * @brief Three stage read -> encrypt -> write pipeline around a block_cipher mode.
+     * Whilst one thread reads into buffer A the cipher stage works on buffer B and a third thread writes buffer C,
+     * so that the CPU is not idle during I/O and the I/O is not idle during AES. Buffers circulate between the stages
+     * through bounded lock-free single producer single consumer queues:
+     *
+     *     free -> [reader] -> filled -> [cipher] -> done -> [writer] -> free
+     *
+     * For sockets and pipes where mmap does not apply.
+     * @note The reader and writer stages run on their own threads, the cipher stage runs on the calling thread.
+     * @tparam C block_cipher<M, T, U>
+     */
+    template<typename C>
+    class pipeline {
+
+        constexpr static size_t END = std::numeric_limits<size_t>::max(); // end of stream marker
+
+        struct chunk_t {
+            std::vector<typename C::value_type> data; // BLOCK_SIZE headroom + chunk
+            size_t size;
+        };
+
+    public:
+
+        using value_type = typename C::value_type;
+        using block_t = typename C::block_t;
+
+        /**
+         * @brief read up to _n_ bytes into the buffer
+         * @return number of bytes read, 0 at end of stream (short reads are fine, the reader stage keeps filling)
+         */
+        using reader_t = std::function<size_t(value_type*, size_t)>;
+
+        /**
+         * @brief write exactly _n_ bytes from the buffer
+         */
+        using writer_t = std::function<void(const value_type*, size_t)>;
+
+        constexpr static size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+        constexpr static size_t DEFAULT_DEPTH = 4;
+
+        /**
+         * @param cipher keyed block cipher
+         * @param chunk_size bytes per buffer - rounded up to a multiple of the block size
+         * @param depth number of buffers in flight (at least 3, one per stage)
+         */
+        explicit pipeline(C& cipher, size_t chunk_size = DEFAULT_CHUNK_SIZE, size_t depth = DEFAULT_DEPTH):
+            cipher_(cipher),
+            chunk_size_(((chunk_size + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_SIZE),
+            depth_(depth < 3 ? 3 : depth)
+        {}
+
+        pipeline(const pipeline&) = delete;
+        pipeline& operator=(const pipeline&) = delete;
+
+        /**
+         * @brief stream encrypt everything _read_ produces into _write_
+         * @note ECB & CBC input must already be padded to a multiple of the block size
+         * @param read
+         * @param write
+         * @param iv initialisation vector (CBC) or nonce-counter block (CTR), ignored by ECB
+         * @return size_t total bytes written
+         */
+        size_t encrypt(const reader_t& read, const writer_t& write, const block_t& iv = {}) {
+            return run<true>(read, write, iv);
+        }
+
+        /**
+         * @brief stream decrypt everything _read_ produces into _write_
+         * @param read
+         * @param write
+         * @param iv initialisation vector (CBC) or nonce-counter block (CTR), ignored by ECB
+         * @return size_t total bytes written
+         */
+        size_t decrypt(const reader_t& read, const writer_t& write, const block_t& iv = {}) {
+            return run<false>(read, write, iv);
+        }
+
+        inline size_t chunk_size() const {
+            return chunk_size_;
+        }
+
+        inline size_t depth() const {
+            return depth_;
+        }
+
+    private:
+
+        template<bool Encrypt>
+        size_t run(const reader_t& read, const writer_t& write, const block_t& iv) {
+            std::vector<chunk_t> chunks(depth_, chunk_t{std::vector<value_type>(BLOCK_SIZE + chunk_size_), 0});
+            util::spsc_queue<size_t> free(depth_ + 1), filled(depth_ + 1), done(depth_ + 1);
+            for(size_t i{0}; i < depth_; ++i) {
+                free.try_push(i);
+            }
+            std::atomic<bool> abort{false};
+            std::exception_ptr reader_error, writer_error;
+            size_t written{0};
+
+            std::thread reader([&] {
+                try {
+                    size_t i;
+                    for(;;) {
+                        if(!pop(free, i, abort)) return;
+                        value_type* p = chunks[i].data.data() + BLOCK_SIZE;
+                        size_t n{0}, r{1};
+                        while(n < chunk_size_ && (r = read(p + n, chunk_size_ - n))) {
+                            n += r;
+                        }
+                        if(n) {
+                            chunks[i].size = n;
+                            if(!push(filled, i, abort)) return;
+                        }
+                        if(!r) {
+                            push(filled, END, abort);
+                            return;
+                        }
+                    }
+                } catch(...) {
+                    reader_error = std::current_exception();
+                    abort = true;
+                }
+            });
+
+            std::thread writer([&] {
+                try {
+                    size_t i;
+                    for(;;) {
+                        if(!pop(done, i, abort) || i == END) return;
+                        write(chunks[i].data.data() + BLOCK_SIZE, chunks[i].size);
+                        written += chunks[i].size;
+                        if(!push(free, i, abort)) return;
+                    }
+                } catch(...) {
+                    writer_error = std::current_exception();
+                    abort = true;
+                }
+            });
+
+            std::exception_ptr cipher_error;
+            try {
+                chained_cipher<C> chain(cipher_, iv);
+                size_t i;
+                for(;;) {
+                    if(!pop(filled, i, abort)) break;
+                    if(i == END) {
+                        push(done, END, abort);
+                        break;
+                    }
+                    auto front = chunks[i].data.begin() + BLOCK_SIZE;
+                    auto back = front + chunks[i].size;
+                    if constexpr (Encrypt) {
+                        chain.encrypt(front, back);
+                    } else {
+                        chain.decrypt(front, back);
+                    }
+                    if(!push(done, i, abort)) break;
+                }
+            } catch(...) {
+                cipher_error = std::current_exception();
+                abort = true;
+            }
+
+            reader.join();
+            writer.join();
+            for(auto& e: {cipher_error, reader_error, writer_error}) {
+                if(e) std::rethrow_exception(e);
+            }
+            return written;
+        }
+
+        /**
+         * @brief spin (politely) until the queue accepts the value or the pipeline aborts
+         */
+        static bool push(util::spsc_queue<size_t>& q, size_t i, const std::atomic<bool>& abort) {
+            while(!q.try_push(i)) {
+                if(abort) return false;
+                std::this_thread::yield();
+            }
+            return true;
+        }
+
+        /**
+         * @brief spin (politely) until the queue yields a value or the pipeline aborts
+         */
+        static bool pop(util::spsc_queue<size_t>& q, size_t& i, const std::atomic<bool>& abort) {
+            while(!q.try_pop(i)) {
+                if(abort) return false;
+                std::this_thread::yield();
+            }
+            return true;
+        }
+
+        C& cipher_;
+
+        const size_t chunk_size_;
+
+        const size_t depth_;
+
+    };
+
+}
+
+#endif //AES_CPP17_BLOCK_CIPHER_PIPELINE_H
@@ -0,0 +1,173 @@
+#ifndef AES_CPP17_CHAINED_CIPHER_H
+#define AES_CPP17_CHAINED_CIPHER_H
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+
+#include "block_cipher_factory.h"
+#include "cipher_exception.h"
+
+namespace crypto {
+
+    template<typename C>
+    class chained_cipher;
+
+    /**
+     * @brief Carry a block_cipher's chaining state across successive chunks of one message.
+     * The block_cipher modes expect the whole message in one container with the IV or nonce-counter prepended, which
+     * rules out streaming from sockets and pipes. A chained_cipher remembers where the previous chunk left off:
+     * + ECB no state
+     * + CBC the last cipher text block becomes the IV of the next chunk
+     * + CTR the nonce-counter advanced by the number of blocks consumed, and the unused keystream of a partial block
+     * so that encrypting a message chunk by chunk gives exactly the same cipher text as encrypting it in one go.
+     * @note The block preceding _front_ is used as scratch for the chaining block (as per the block_cipher API)
+     * therefore every CBC and CTR chunk must have BLOCK_SIZE bytes of writable headroom in front of it.
+     * @tparam M
+     * @tparam T
+     * @tparam U
+     */
+    template<cipher_mode_t M, typename T, typename U>
+    class chained_cipher<block_cipher<M, T, U>> {
+
+    public:
+
+        using cipher_t = block_cipher<M, T, U>;
+        using block_t = typename cipher_t::block_t;
+        using value_type = typename cipher_t::value_type;
+
+        /**
+         * @param cipher the keyed block cipher to drive
+         * @param iv the initialisation vector (CBC) or nonce-counter block (CTR), ignored by ECB
+         */
+        explicit chained_cipher(cipher_t& cipher, const block_t& iv = {}): cipher_(cipher), chain_(iv) {}
+
+        /**
+         * @brief encrypt the next chunk of the message in place
+         * @note ECB and CBC chunks must be block aligned, a CTR chunk may end part way through a block and the next
+         * chunk carries on with the rest of that block's keystream
+         * @tparam Iterator
+         * @param front
+         * @param back
+         */
+        template<typename Iterator>
+        void encrypt(Iterator front, Iterator back) {
+            if constexpr (M == CTR) {
+                ctr(front, back);
+                return;
+            }
+            const size_t whole = aligned_size(front, back);
+            if(whole) {
+                if constexpr (M != ECB) {
+                    std::copy(chain_.begin(), chain_.end(), front - BLOCK_SIZE);
+                }
+                cipher_.encrypt(front, front + whole);
+                advance(front + whole);
+            }
+        }
+
+        /**
+         * @brief decrypt the next chunk of the message in place
+         * @tparam Iterator
+         * @param front
+         * @param back
+         */
+        template<typename Iterator>
+        void decrypt(Iterator front, Iterator back) {
+            if constexpr (M == CTR) {
+                ctr(front, back);
+                return;
+            }
+            const size_t whole = aligned_size(front, back);
+            if(whole) {
+                if constexpr (M != ECB) {
+                    std::copy(chain_.begin(), chain_.end(), front - BLOCK_SIZE);
+                }
+                if constexpr (M == CBC) { //the next IV is the cipher text about to be overwritten
+                    std::copy(front + whole - BLOCK_SIZE, front + whole, chain_.begin());
+                }
+                cipher_.decrypt(front, front + whole);
+            }
+        }
+
+        /**
+         * @brief the chaining block that will be applied to the next chunk
+         * @note for CTR after a partial block, the counter of the block after it - the rest of the partial block's
+         * keystream is used first
+         * @return const block_t&
+         */
+        inline const block_t& chain() const {
+            return chain_;
+        }
+
+    private:
+
+        template<typename Iterator>
+        size_t aligned_size(Iterator front, Iterator back) const {
+            const auto n = static_cast<size_t>(std::distance(front, back));
+            if(n % BLOCK_SIZE) {
+                throw doh::cipher_exception(doh::ALIGNMENT);
+            }
+            return n;
+        }
+
+        template<typename Iterator>
+        void advance(Iterator end) {
+            if constexpr (M == CBC) {
+                std::copy(end - BLOCK_SIZE, end, chain_.begin());
+            }
+        }
+
+        /**
+         * @brief CTR is a stream cipher: the keystream left over from a previous partial block is used up first, then
+         * the whole blocks, then a final partial block by way of a zero filled scratch block whose keystream is kept
+         * @note the headroom in front of the whole blocks may overlap the bytes just taken from the leftover
+         * keystream, so it is restored after the block_cipher has used it
+         */
+        template<typename Iterator>
+        void ctr(Iterator front, Iterator back) {
+            auto n = static_cast<size_t>(std::distance(front, back));
+            const size_t k = std::min(n, pending_);
+            for(size_t i{0}; i < k; ++i) {
+                front[i] ^= stream_[BLOCK_SIZE - pending_ + i];
+            }
+            pending_ -= k;
+            front += k;
+            n -= k;
+            const size_t whole = n - n % BLOCK_SIZE;
+            if(whole) {
+                block_t headroom;
+                std::copy(front - BLOCK_SIZE, front, headroom.begin());
+                std::copy(chain_.begin(), chain_.end(), front - BLOCK_SIZE);
+                cipher_.encrypt(front, front + whole);
+                std::copy(headroom.begin(), headroom.end(), front - BLOCK_SIZE);
+                cipher_t::inc_block(chain_, whole / BLOCK_SIZE);
+                front += whole;
+                n -= whole;
+            }
+            if(n) {
+                std::array<value_type, BLOCK_SIZE * 2> scratch{};
+                std::copy(chain_.begin(), chain_.end(), scratch.begin());
+                cipher_.encrypt(scratch.begin() + BLOCK_SIZE, scratch.end());
+                std::copy(scratch.begin() + BLOCK_SIZE, scratch.end(), stream_.begin());
+                for(size_t i{0}; i < n; ++i) {
+                    front[i] ^= stream_[i];
+                }
+                pending_ = BLOCK_SIZE - n;
+                cipher_t::inc_block(chain_, 1);
+            }
+        }
+
+        cipher_t& cipher_;
+
+        block_t chain_;
+
+        block_t stream_{}; // CTR keystream of the last partial block
+
+        size_t pending_{0}; // bytes of stream_ not yet used, at its end
+
+    };
+
+}
+
+#endif //AES_CPP17_CHAINED_CIPHER_H
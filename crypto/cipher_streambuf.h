@@ -0,0 +1,252 @@
+#ifndef AES_CPP17_CIPHER_STREAMBUF_H
+#define AES_CPP17_CIPHER_STREAMBUF_H
+
+#include <algorithm>
+#include <array>
+#include <streambuf>
+#include <vector>
+
+#include "chained_cipher.h"
+#include "padder_factory.h"
+
+namespace crypto {
+
+    /**
+     * @brief std::streambuf filter that encrypts everything written through it into an underlying streambuf
+     * Writes are gathered into a large internal buffer and only whole blocks are handed to the cipher, so that
+     * ```<<``` heavy code does not turn into one AES call per byte and nothing is held in memory beyond one buffer:
+     * ```
+     * crypto::encrypting_streambuf<crypto::block_cipher<crypto::CBC>> enc(file.rdbuf(), aes, iv);
+     * std::ostream out(&enc);
+     * out << "log line " << 42 << '\n';
+     * enc.close();
+     * ```
+     * @note The IV (CBC) or nonce-counter (CTR) is _not_ written to the underlying stream, that is up to the caller.
+     * @note close() (or destruction) writes the final block: ECB & CBC padded with _P_, CTR as a partial block.
+     * @tparam C block_cipher<M, T, U>
+     * @tparam P padder (ignored by CTR)
+     */
+    template<typename C, typename P = padder<>>
+    class encrypting_streambuf: public std::streambuf {
+
+    public:
+
+        using cipher_t = C;
+        using block_t = typename C::block_t;
+        using value_type = typename C::value_type;
+
+        constexpr static size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+        /**
+         * @param sink the underlying streambuf to write cipher text to
+         * @param cipher keyed block cipher
+         * @param iv initialisation vector (CBC) or nonce-counter block (CTR), ignored by ECB
+         * @param buffer_size bytes buffered before encrypting - rounded up to a multiple of the block size
+         */
+        encrypting_streambuf(std::streambuf* sink, C& cipher, const block_t& iv = {},
+                             size_t buffer_size = DEFAULT_BUFFER_SIZE):
+            sink_(sink),
+            chain_(cipher, iv),
+            buffer_(BLOCK_SIZE + std::max((buffer_size + BLOCK_SIZE - 1) / BLOCK_SIZE, size_t{1}) * BLOCK_SIZE
+                    + BLOCK_SIZE)
+        {
+            reset(0);
+        }
+
+        encrypting_streambuf(const encrypting_streambuf&) = delete;
+        encrypting_streambuf& operator=(const encrypting_streambuf&) = delete;
+
+        ~encrypting_streambuf() override {
+            try {
+                close();
+            } catch(...) {} // destructors must not throw, call close() explicitly to see errors
+        }
+
+        /**
+         * @brief encrypt and write the final (padded or partial) block, further writes fail
+         */
+        void close() {
+            if(closed_) return;
+            closed_ = true;
+            size_t n = pending();
+            if constexpr (C::mode() != CTR) { // room for the padding is reserved at the back of the buffer
+                n += P().pad(data(), data() + n, data() + n);
+            }
+            chain_.encrypt(data(), data() + n);
+            write(n);
+            setp(nullptr, nullptr);
+            sink_->pubsync();
+        }
+
+    protected:
+
+        int_type overflow(int_type ch) override {
+            if(closed_) {
+                return traits_type::eof();
+            }
+            flush_blocks();
+            if(!traits_type::eq_int_type(ch, traits_type::eof())) {
+                *pptr() = traits_type::to_char_type(ch);
+                pbump(1);
+            }
+            return traits_type::not_eof(ch);
+        }
+
+        /**
+         * @note only whole blocks can be flushed before close()
+         */
+        int sync() override {
+            if(closed_) {
+                return 0;
+            }
+            flush_blocks();
+            return sink_->pubsync();
+        }
+
+    private:
+
+        inline value_type* data() {
+            return buffer_.data() + BLOCK_SIZE;
+        }
+
+        inline size_t pending() const {
+            return static_cast<size_t>(pptr() - pbase());
+        }
+
+        /**
+         * @brief (re)start the put area with _carry_ bytes already at the front, the last block is kept in reserve
+         */
+        void reset(size_t carry) {
+            auto p = reinterpret_cast<char*>(data());
+            setp(p, p + buffer_.size() - 2 * BLOCK_SIZE);
+            pbump(static_cast<int>(carry));
+        }
+
+        void flush_blocks() {
+            const size_t n = pending();
+            const size_t whole = n - n % BLOCK_SIZE;
+            chain_.encrypt(data(), data() + whole);
+            write(whole);
+            std::copy(data() + whole, data() + n, data());
+            reset(n - whole);
+        }
+
+        void write(size_t n) {
+            if(sink_->sputn(reinterpret_cast<const char*>(data()), static_cast<std::streamsize>(n))
+               != static_cast<std::streamsize>(n)) {
+                throw std::ios_base::failure("encrypting_streambuf: short write");
+            }
+        }
+
+        std::streambuf* sink_;
+
+        chained_cipher<C> chain_;
+
+        std::vector<value_type> buffer_; // BLOCK_SIZE headroom + buffer + BLOCK_SIZE padding reserve
+
+        bool closed_{false};
+
+    };
+
+    /**
+     * @brief std::streambuf filter that decrypts everything read from an underlying streambuf
+     * The underlying stream is read and decrypted a large buffer at a time, ECB & CBC hold back the last block until
+     * end of stream so that the padding can be checked and stripped.
+     * @note A bad padding checksum throws doh::cipher_exception out of the read
+     * @tparam C block_cipher<M, T, U>
+     * @tparam P padder (ignored by CTR)
+     */
+    template<typename C, typename P = padder<>>
+    class decrypting_streambuf: public std::streambuf {
+
+    public:
+
+        using cipher_t = C;
+        using block_t = typename C::block_t;
+        using value_type = typename C::value_type;
+
+        constexpr static size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+        /**
+         * @param source the underlying streambuf to read cipher text from
+         * @param cipher keyed block cipher
+         * @param iv initialisation vector (CBC) or nonce-counter block (CTR), ignored by ECB
+         * @param buffer_size bytes read at a time - rounded up to a multiple of the block size (at least 2 blocks)
+         */
+        decrypting_streambuf(std::streambuf* source, C& cipher, const block_t& iv = {},
+                             size_t buffer_size = DEFAULT_BUFFER_SIZE):
+            source_(source),
+            chain_(cipher, iv),
+            buffer_(BLOCK_SIZE + std::max((buffer_size + BLOCK_SIZE - 1) / BLOCK_SIZE, size_t{2}) * BLOCK_SIZE)
+        {
+            setg(nullptr, nullptr, nullptr);
+        }
+
+        decrypting_streambuf(const decrypting_streambuf&) = delete;
+        decrypting_streambuf& operator=(const decrypting_streambuf&) = delete;
+
+    protected:
+
+        int_type underflow() override {
+            while(gptr() == egptr()) {
+                if(end_) {
+                    return traits_type::eof();
+                }
+                fill();
+            }
+            return traits_type::to_int_type(*gptr());
+        }
+
+    private:
+
+        inline value_type* data() {
+            return buffer_.data() + BLOCK_SIZE;
+        }
+
+        /**
+         * @brief read the next buffer full and decrypt whatever can safely be decrypted
+         */
+        void fill() {
+            const size_t capacity = buffer_.size() - BLOCK_SIZE;
+            std::copy(carry_.begin(), carry_.begin() + carried_, data());
+            size_t n = carried_;
+            const auto wanted = static_cast<std::streamsize>(capacity - n);
+            const auto got = source_->sgetn(reinterpret_cast<char*>(data() + n), wanted);
+            n += static_cast<size_t>(got);
+            end_ = got < wanted;
+            size_t ready = n;
+            if(!end_) {
+                ready -= n % BLOCK_SIZE;
+                if constexpr (C::mode() != CTR) { // the last block might be the padding
+                    ready -= BLOCK_SIZE;
+                }
+            }
+            carried_ = n - ready;
+            std::copy(data() + ready, data() + n, carry_.begin());
+            chain_.decrypt(data(), data() + ready);
+            if constexpr (C::mode() != CTR) {
+                if(end_ && ready) {
+                    ready -= P().unpad(data(), data() + ready);
+                }
+            }
+            auto p = reinterpret_cast<char*>(data());
+            setg(p, p, p + ready);
+        }
+
+        std::streambuf* source_;
+
+        chained_cipher<C> chain_;
+
+        std::vector<value_type> buffer_; // BLOCK_SIZE headroom + buffer
+
+        std::array<value_type, BLOCK_SIZE * 2> carry_{};
+
+        size_t carried_{0};
+
+        bool end_{false};
+
+    };
+
+}
+
+#endif //AES_CPP17_CIPHER_STREAMBUF_H
@@ -0,0 +1,139 @@
+#ifndef AES_CPP17_CMAC_H
+#define AES_CPP17_CMAC_H
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+#include "aes_encrypt.h"
+
+namespace crypto {
+
+    /**
+     * @brief Cipher-based Message Authentication Code (NIST SP 800-38B, RFC 4493)
+     * A CBC-MAC variant that is secure for variable length messages: the final block is xor'd with one of two subkeys
+     * derived from the cipher key before the last encryption - K1 if the final block is complete, K2 if it had to be
+     * 10* padded.
+     * The implementation is verified against the AES-256 test vectors in NIST SP 800-38B.
+     * @note supports incremental update() calls, the final block is held back until final() is called
+     * @note the key schedule, subkeys and chaining value are wiped on destruction
+     * @tparam T block cipher encrypt functor (default AES-256)
+     */
+    template<typename T = aes::encrypt<>>
+    class cmac {
+
+        static_assert(std::is_trivially_copyable_v<T>, "the cipher is wiped as raw bytes on destruction");
+
+    public:
+
+        using value_type = typename T::value_type;
+        using block_t = typename T::block_t;
+
+        template<class KeySequence>
+        explicit cmac(KeySequence&& kseq): encrypt_(kseq) {
+            block_t l{};
+            encrypt_.block(l.begin());
+            k1_ = dbl(l);
+            k2_ = dbl(k1_);
+            secure_wipe(l.data(), l.size());
+        }
+
+        //Constructor accepting a forwarding reference can hide copy and move constructors
+        cmac(const cmac&) = delete;
+        cmac(cmac&&) = delete;
+        cmac& operator=(const cmac&) = delete;
+        cmac& operator=(cmac&&) = delete;
+
+        ~cmac() {
+            secure_wipe(&encrypt_, sizeof(encrypt_));
+            secure_wipe(k1_.data(), k1_.size());
+            secure_wipe(k2_.data(), k2_.size());
+            secure_wipe(x_.data(), x_.size());
+        }
+
+        /**
+         * @brief one shot tag of the range
+         * @tparam ConstIterator
+         * @param first
+         * @param last
+         * @return block_t the 16 byte tag
+         */
+        template<typename ConstIterator>
+        block_t operator()(ConstIterator first, ConstIterator last) {
+            update(first, last);
+            return final();
+        }
+
+        /**
+         * @brief absorb more of the message
+         * @tparam ConstIterator
+         * @param first
+         * @param last
+         */
+        template<typename ConstIterator>
+        void update(ConstIterator first, ConstIterator last) {
+            for(; first != last; ++first) {
+                if(n_ == BLOCK_SIZE) { // only now is it known that the buffered block is not the last
+                    encrypt_.block(x_.begin());
+                    n_ = 0;
+                }
+                x_[n_++] ^= static_cast<value_type>(*first);
+            }
+        }
+
+        /**
+         * @brief finish the tag and reset ready for the next message
+         * @return block_t the 16 byte tag
+         */
+        block_t final() {
+            if(n_ == BLOCK_SIZE) {
+                xor_block(x_, k1_);
+            } else {
+                x_[n_] ^= 0x80;
+                xor_block(x_, k2_);
+            }
+            encrypt_.block(x_.begin());
+            block_t tag = x_;
+            x_ = block_t{};
+            n_ = 0;
+            return tag;
+        }
+
+        inline static size_t block_size() {
+            return T::block_size();
+        }
+
+    private:
+
+        /**
+         * @brief multiply by x in GF(2^128) i.e. shift the 128 bit big endian value left one, xor 0x87 on carry out
+         */
+        static block_t dbl(const block_t& b) {
+            block_t d;
+            for(size_t i{0}; i < BLOCK_SIZE - 1; ++i) {
+                d[i] = static_cast<value_type>((b[i] << 1u) | (b[i + 1] >> 7u));
+            }
+            d[BLOCK_SIZE - 1] = static_cast<value_type>((b[BLOCK_SIZE - 1] << 1u) ^ ((b[0] >> 7u) * 0x87u));
+            return d;
+        }
+
+        static inline void xor_block(block_t& a, const block_t& b) {
+            for(size_t i{0}; i < BLOCK_SIZE; ++i) {
+                a[i] ^= b[i];
+            }
+        }
+
+        T encrypt_;
+
+        block_t k1_, k2_;
+
+        block_t x_{}; // CBC-MAC chaining value with the pending message block xor'd in
+
+        size_t n_{0}; // bytes of the pending block absorbed
+
+    };
+
+}
+
+#endif //AES_CPP17_CMAC_H
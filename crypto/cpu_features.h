@@ -0,0 +1,217 @@
+#ifndef AES_CPP17_CPU_FEATURES_H
+#define AES_CPP17_CPU_FEATURES_H
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define AES_CPP17_X86
+#endif
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(AES_CPP17_X86)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+/**
+ * Instruction set extensions are detected at run time so one binary serves every CPU in the fleet: the functions
+ * using them are compiled for their target individually (GCC et al) rather than the whole program with -m flags.
+ * MSVC needs no such attribute for its intrinsics.
+ */
+#if defined(AES_CPP17_X86) && defined(__GNUC__)
+#define AES_CPP17_TARGET(isa) __attribute__((target(isa)))
+#else
+#define AES_CPP17_TARGET(isa)
+#endif
+
+namespace crypto {
+
+    /**
+     * @brief the processor features this library can make use of
+     */
+    struct cpu_features_t {
+        bool aes{false};
+        bool rdrand{false};
+        bool rdseed{false};
+    };
+
+    /**
+     * @brief Use the processor supplementary instruction CPUID to discover CPU functionality once, at first use
+     * @note leaf 1 ECX bit 25 AES-NI, leaf 1 ECX bit 30 RDRAND, leaf 7 (sub-leaf 0) EBX bit 18 RDSEED
+     * @return const cpu_features_t&
+     */
+    inline const cpu_features_t& cpu_features() {
+        static const cpu_features_t features = [] {
+            cpu_features_t f;
+#if defined(_MSC_VER) && defined(AES_CPP17_X86)
+            int regs[4];
+            __cpuid(regs, 0);
+            const int max_leaf = regs[0];
+            __cpuid(regs, 1);
+            f.aes = regs[2] & (1 << 25);
+            f.rdrand = regs[2] & (1 << 30);
+            if(max_leaf >= 7) {
+                __cpuidex(regs, 7, 0);
+                f.rdseed = regs[1] & (1 << 18);
+            }
+#elif defined(AES_CPP17_X86)
+            unsigned int regs[4]{};
+            if(__get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3])) {
+                f.aes = regs[2] & bit_AES; //bit_AES predefined in GNU et al
+                f.rdrand = regs[2] & bit_RDRND; //bit_RDRND predefined in GNU et al
+            }
+            if(__get_cpuid_count(7, 0, &regs[0], &regs[1], &regs[2], &regs[3])) {
+                f.rdseed = regs[1] & bit_RDSEED; //bit_RDSEED predefined in GNU et al
+            }
+#endif
+            return f;
+        }();
+        return features;
+    }
+
+    /**
+     * @brief test if can use the AES-NI instructions AESENC, AESKEYGENASSIST et al
+     * @return bool true = AES-NI
+     */
+    inline bool can_aesni() {
+        return cpu_features().aes;
+    }
+
+    /**
+     * @brief test if can use HRNG intrinsic RDRAND
+     * @return bool true = HRNG can RDRAND
+     */
+    inline bool can_rdrand() {
+        return cpu_features().rdrand;
+    }
+
+    /**
+     * @brief test if can use HRNG intrinsic RDSEED
+     * @note RDSEED is slower but offers greater entropy
+     * @return bool true = HRNG can RDSEED
+     */
+    inline bool can_rdseed() {
+        return cpu_features().rdseed;
+    }
+
+    /**
+     * The AES implementations (kernels) to choose from @see aes_kernels.h
+     * + PORTABLE the constexpr C++ of aes::encrypt and aes::decrypt, runs anywhere
+     * + AESNI the Intel AES New Instructions
+     */
+    enum kernel_t {
+        PORTABLE, AESNI
+    };
+
+    /**
+     * Environment variable naming the kernel to run, _portable_ or _aesni_, read once at first use e.g.
+     * `AES_CPP17_KERNEL=portable ./server` to A/B a deployment or rule out the hardware path. A kernel the CPU lacks, or
+     * that was refused, (or an unknown name) is ignored in favour of the best available.
+     */
+    constexpr static const char* KERNEL_ENV = "AES_CPP17_KERNEL";
+
+    inline const char* kernel_name(kernel_t kernel) {
+        return kernel == AESNI ? "aesni" : "portable";
+    }
+
+    /**
+     * @brief test if the CPU can run _kernel_
+     */
+    inline bool kernel_supported(kernel_t kernel) {
+        return kernel == PORTABLE || (kernel == AESNI && can_aesni());
+    }
+
+    /**
+     * @brief the kernels refused by the power-on self-test, a bit per kernel_t
+     */
+    inline std::atomic<unsigned>& kernel_refusals() {
+        static std::atomic<unsigned> refusals{0};
+        return refusals;
+    }
+
+    /**
+     * @brief test if _kernel_ was refused by the power-on self-test @see kernel::power_on_self_test
+     */
+    inline bool kernel_refused(kernel_t kernel) {
+        return kernel_refusals().load(std::memory_order_relaxed) & (1u << kernel);
+    }
+
+    /**
+     * @brief test if _kernel_ can be selected: the CPU runs it and it has not been refused
+     */
+    inline bool kernel_available(kernel_t kernel) {
+        return kernel_supported(kernel) && !kernel_refused(kernel);
+    }
+
+    /**
+     * @brief the fastest kernel the CPU can run
+     */
+    inline kernel_t best_kernel() {
+        return kernel_available(AESNI) ? AESNI : PORTABLE;
+    }
+
+    /**
+     * @brief the kernel a KERNEL_ENV value names, or the best available if it is unset (nullptr), unknown, or names
+     * a kernel that is not available
+     * @param env
+     * @return kernel_t
+     */
+    inline kernel_t kernel_from_env(const char* env) {
+        if(env) {
+            for(kernel_t k: {PORTABLE, AESNI}) {
+                if(std::strcmp(env, kernel_name(k)) == 0 && kernel_available(k)) {
+                    return k;
+                }
+            }
+        }
+        return best_kernel();
+    }
+
+    /**
+     * @brief the process wide kernel selection, initialised once from CPUID and the KERNEL_ENV override
+     */
+    inline std::atomic<int>& kernel_selection() {
+        static std::atomic<int> selection{static_cast<int>(kernel_from_env(std::getenv(KERNEL_ENV)))};
+        return selection;
+    }
+
+    /**
+     * @brief the kernel every dispatching cipher runs
+     * @return kernel_t
+     */
+    inline kernel_t active_kernel() {
+        return static_cast<kernel_t>(kernel_selection().load(std::memory_order_relaxed));
+    }
+
+    /**
+     * @brief switch the whole process to _kernel_ e.g. to benchmark A against B, or force the portable path
+     * @note ciphers already mid-call finish on the kernel they started with
+     * @return bool false, and no change, if the CPU cannot run _kernel_
+     */
+    inline bool select_kernel(kernel_t kernel) {
+        if(!kernel_available(kernel)) {
+            return false;
+        }
+        kernel_selection().store(static_cast<int>(kernel), std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief never select _kernel_ again in this process, falling back to the best remaining kernel if it is active
+     * @note the portable kernel is the reference, it cannot be refused
+     */
+    inline void refuse_kernel(kernel_t kernel) {
+        if(kernel == PORTABLE) {
+            return;
+        }
+        kernel_refusals().fetch_or(1u << kernel, std::memory_order_relaxed);
+        int active = kernel;
+        kernel_selection().compare_exchange_strong(active, static_cast<int>(best_kernel()), std::memory_order_relaxed);
+    }
+
+}
+
+#endif //AES_CPP17_CPU_FEATURES_H
@@ -0,0 +1,269 @@
+#ifndef AES_CPP17_CTR_DRBG_H
+#define AES_CPP17_CTR_DRBG_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+#include "aes_encrypt.h"
+#include "aes_kernels.h"
+#include "entropy_pool.h"
+
+namespace crypto {
+
+    /**
+     * @brief AES CTR_DRBG deterministic random bit generator (NIST SP 800-90A Rev 1, section 10.2.1)
+     * Seeded from the entropy_pool (hardware entropy or getrandom) then generating at AES-CTR speed, which makes it
+     * suitable for nonces, IVs and session keys in bulk:
+     * ```
+     * crypto::ctr_drbg<>::local().generate(key.data(), key.size());
+     * ```
+     * Implemented without the derivation function, so entropy input is full entropy of seedlen = key + block bytes,
+     * and with the backtracking resistance update after every request.
+     * The implementation is verified against OpenSSL's CTR-DRBG (AES-256-CTR, no derivation function).
+     * @note reseeds itself from the entropy_pool once the reseed interval is reached
+     * @warning an instance is not thread safe, use one per thread e.g. local()
+     * @tparam R number of round keys (AES-256 default 15)
+     * @tparam N length of the key in 32-bit words (AES-256 default 8)
+     */
+    template<aes::ROUNDS R = aes::R256, aes::KEY_LENGTH N = aes::N256>
+    class ctr_drbg {
+
+    public:
+
+        using cipher_t = aes::encrypt<R, N>;
+        using block_t = typename cipher_t::block_t;
+
+        constexpr static size_t KEY_SIZE = N * WORD_SIZE;
+
+        constexpr static size_t SEED_SIZE = KEY_SIZE + BLOCK_SIZE;
+
+        using key_t = std::array<uint8_t, KEY_SIZE>;
+        using seed_t = std::array<uint8_t, SEED_SIZE>;
+
+        /**
+         * @brief the most bytes a single generate request may produce (SP 800-90A table 3: 2^19 bits), larger
+         * generate() calls are split into several requests
+         */
+        constexpr static size_t MAX_REQUEST = 1 << 16;
+
+        /**
+         * @brief SP 800-90A allows up to 2^48 requests between reseeds, far fewer is the prudent default
+         */
+        constexpr static uint64_t DEFAULT_RESEED_INTERVAL = 1ull << 20;
+
+        /**
+         * @brief instantiate from the entropy_pool
+         * @param personalization optional data to distinguish this instance
+         * @param reseed_interval generate requests between reseeds
+         */
+        explicit ctr_drbg(const seed_t& personalization = {}, uint64_t reseed_interval = DEFAULT_RESEED_INTERVAL):
+            reseed_interval_(reseed_interval)
+        {
+            seed_t entropy;
+            entropy_pool<>::local().fill(entropy.data(), SEED_SIZE);
+            instantiate(entropy, personalization);
+            wipe(entropy);
+        }
+
+        /**
+         * @brief instantiate from caller supplied entropy e.g. known answer tests
+         * ```
+         * auto drbg = crypto::ctr_drbg<>::from_entropy(entropy, personalization);
+         * ```
+         * @param entropy full entropy input
+         * @param personalization optional data to distinguish this instance
+         * @param reseed_interval generate requests between reseeds
+         */
+        static ctr_drbg from_entropy(const seed_t& entropy, const seed_t& personalization = {},
+                                     uint64_t reseed_interval = DEFAULT_RESEED_INTERVAL) {
+            return ctr_drbg(entropy_t{}, entropy, personalization, reseed_interval);
+        }
+
+        ctr_drbg(const ctr_drbg&) = delete;
+        ctr_drbg& operator=(const ctr_drbg&) = delete;
+
+        /**
+         * @note the cipher is wiped too - its expanded schedule begins with the key itself
+         */
+        ~ctr_drbg() {
+            secure_wipe(&cipher_, sizeof(cipher_));
+            wipe(key_);
+            wipe(v_);
+        }
+
+        /**
+         * @brief the calling thread's generator, instantiated on first use
+         */
+        static ctr_drbg& local() {
+            thread_local ctr_drbg drbg;
+            return drbg;
+        }
+
+        /**
+         * @brief reseed from the entropy_pool
+         * @param additional optional additional input
+         */
+        void reseed(const seed_t& additional = {}) {
+            seed_t entropy;
+            entropy_pool<>::local().fill(entropy.data(), SEED_SIZE);
+            reseed(entropy, additional);
+            wipe(entropy);
+        }
+
+        /**
+         * @brief reseed from caller supplied entropy
+         * @param entropy full entropy input
+         * @param additional additional input
+         */
+        void reseed(const seed_t& entropy, const seed_t& additional) {
+            seed_t seed_material;
+            for(size_t i{0}; i < SEED_SIZE; ++i) {
+                seed_material[i] = entropy[i] ^ additional[i];
+            }
+            update(seed_material);
+            wipe(seed_material);
+            reseed_counter_ = 1;
+        }
+
+        /**
+         * @brief fill _out_ with _n_ random bytes
+         * @param out
+         * @param n
+         */
+        void generate(uint8_t* out, size_t n) {
+            generate(out, n, seed_t{}, false);
+        }
+
+        /**
+         * @brief fill _out_ with _n_ random bytes mixing in additional input
+         * @param out
+         * @param n
+         * @param additional
+         */
+        void generate(uint8_t* out, size_t n, const seed_t& additional) {
+            generate(out, n, additional, true);
+        }
+
+        /**
+         * @brief a random T e.g. ```drbg.get<block_t>()``` for an IV
+         */
+        template<typename T>
+        T get() {
+            T t;
+            generate(reinterpret_cast<uint8_t*>(&t), sizeof(T));
+            return t;
+        }
+
+        inline uint64_t reseed_counter() const {
+            return reseed_counter_;
+        }
+
+        inline uint64_t reseed_interval() const {
+            return reseed_interval_;
+        }
+
+    private:
+
+        /**
+         * @brief tag for the from_entropy() constructor, which would otherwise be ambiguous with the pool seeded one
+         */
+        struct entropy_t {};
+
+        ctr_drbg(entropy_t, const seed_t& entropy, const seed_t& personalization, uint64_t reseed_interval):
+            reseed_interval_(reseed_interval)
+        {
+            instantiate(entropy, personalization);
+        }
+
+        void instantiate(const seed_t& entropy, const seed_t& personalization) {
+            key_ = key_t{};
+            v_ = block_t{};
+            kernel::rekey(cipher_, key_);
+            reseed(entropy, personalization);
+        }
+
+        void generate(uint8_t* out, size_t n, const seed_t& additional, bool has_additional) {
+            do {
+                const size_t k = std::min(n, MAX_REQUEST);
+                if(reseed_counter_ > reseed_interval_) { // SP 800-90A 9.3.1 the additional input goes into the reseed...
+                    reseed(has_additional ? additional : seed_t{});
+                    has_additional = false; // ...and is Null for the rest of the request
+                }
+                if(has_additional) {
+                    update(additional);
+                }
+                keystream(out, k);
+                update(has_additional ? additional : seed_t{}); // backtracking resistance
+                ++reseed_counter_;
+                out += k;
+                n -= k;
+            } while(n);
+        }
+
+        /**
+         * @brief CTR_DRBG_Update - run the generator for seedlen bytes and take them, xor _provided_, as the new key
+         * and counter
+         */
+        void update(const seed_t& provided) {
+            seed_t temp;
+            keystream(temp.data(), SEED_SIZE);
+            for(size_t i{0}; i < SEED_SIZE; ++i) {
+                temp[i] ^= provided[i];
+            }
+            std::copy(temp.begin(), temp.begin() + KEY_SIZE, key_.begin());
+            std::copy(temp.begin() + KEY_SIZE, temp.end(), v_.begin());
+            wipe(temp);
+            kernel::rekey(cipher_, key_);
+        }
+
+        /**
+         * @brief _n_ bytes of E(Key, V + 1) | E(Key, V + 2) | ... into _out_, leaving V at the last counter used
+         * @note run as CTR over a zeroed buffer by the active kernel, which encrypts then increments where SP 800-90A
+         * increments then encrypts - hence starting from V + 1 and stepping back one at the end
+         */
+        void keystream(uint8_t* out, size_t n) {
+            std::fill(out, out + n, uint8_t{0});
+            increment();
+            kernel::ctr(cipher_, v_.data(), out, n);
+            decrement();
+        }
+
+        /**
+         * @brief V = (V + 1) mod 2^128 big endian
+         */
+        void increment() {
+            for(size_t i{BLOCK_SIZE}; i-- > 0;) {
+                if(++v_[i]) break;
+            }
+        }
+
+        /**
+         * @brief V = (V - 1) mod 2^128 big endian
+         */
+        void decrement() {
+            for(size_t i{BLOCK_SIZE}; i-- > 0;) {
+                if(v_[i]--) break;
+            }
+        }
+
+        template<typename Sequence>
+        static void wipe(Sequence& seq) {
+            secure_wipe(seq.data(), seq.size());
+        }
+
+        cipher_t cipher_;
+
+        key_t key_{};
+
+        block_t v_{};
+
+        uint64_t reseed_counter_{0};
+
+        uint64_t reseed_interval_;
+
+    };
+
+}
+
+#endif //AES_CPP17_CTR_DRBG_H
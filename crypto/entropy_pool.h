@@ -0,0 +1,208 @@
+#ifndef AES_CPP17_ENTROPY_POOL_H
+#define AES_CPP17_ENTROPY_POOL_H
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <random>
+
+#if defined(__linux__)
+#include <sys/random.h>
+#endif
+
+#include "block_cipher_constants.h"
+#include "cipher_exception.h"
+#include "cpu_features.h"
+
+namespace crypto {
+
+    namespace entropy {
+
+        /**
+         * @brief RDSEED and RDRAND can transiently fail when the entropy hardware is drained by other cores, Intel's
+         * guidance is to retry RDRAND 10 times before declaring failure
+         */
+        constexpr static int HARDWARE_RETRIES = 10;
+
+#if defined(__x86_64__) || defined(_M_X64)
+        using hardware_word_t = unsigned long long;
+#else
+        using hardware_word_t = unsigned int;
+#endif
+
+#ifdef AES_CPP17_X86
+
+        AES_CPP17_TARGET("rdseed") inline int rdseed_step(unsigned short* word) {
+            return _rdseed16_step(word);
+        }
+
+        AES_CPP17_TARGET("rdseed") inline int rdseed_step(unsigned int* word) {
+            return _rdseed32_step(word);
+        }
+
+        AES_CPP17_TARGET("rdrnd") inline int rdrand_step(unsigned int* word) {
+            return _rdrand32_step(word);
+        }
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+        AES_CPP17_TARGET("rdseed") inline int rdseed_step(unsigned long long* word) {
+            return _rdseed64_step(word);
+        }
+
+        AES_CPP17_TARGET("rdrnd") inline int rdrand_step(unsigned long long* word) {
+            return _rdrand64_step(word);
+        }
+
+#endif
+
+#endif
+
+        /**
+         * @brief fill from the hardware entropy source a word at a time, RDSEED first then RDRAND once RDSEED is
+         * exhausted, whichever of them the CPU turns out to have
+         * @return size_t the number of bytes actually filled (whole words), may be short or zero
+         */
+        inline size_t hardware_fill(uint8_t* out, size_t n) {
+            size_t done{0};
+#ifdef AES_CPP17_X86
+            bool seed{can_rdseed()};
+            const bool rand{can_rdrand()};
+            while(n - done >= sizeof(hardware_word_t)) {
+                hardware_word_t word{};
+                int ok{0};
+                for(int retry{0}; seed && !ok && retry < HARDWARE_RETRIES; ++retry) {
+                    ok = rdseed_step(&word);
+                    if(!ok) {
+                        _mm_pause();
+                    }
+                }
+                seed = ok; // RDSEED starved, don't keep paying for the retries
+                for(int retry{0}; rand && !ok && retry < HARDWARE_RETRIES; ++retry) {
+                    ok = rdrand_step(&word);
+                }
+                if(!ok) {
+                    break;
+                }
+                std::memcpy(out + done, &word, sizeof(word));
+                done += sizeof(word);
+            }
+#else
+            (void)out;
+            (void)n;
+#endif
+            return done;
+        }
+
+        /**
+         * @brief fill from the operating system CSPRNG
+         * + Linux getrandom(2) - blocks only until the kernel pool is first initialised at boot
+         * + elsewhere std::random_device, which MSVC documents as cryptographically secure
+         */
+        inline void os_fill(uint8_t* out, size_t n) {
+#if defined(__linux__)
+            while(n) {
+                const auto got = getrandom(out, n, 0);
+                if(got < 0) {
+                    if(errno == EINTR) continue;
+                    throw doh::cipher_exception(doh::DETERMINISTIC);
+                }
+                out += got;
+                n -= static_cast<size_t>(got);
+            }
+#else
+            std::random_device rd;
+            if(rd.entropy() == 0) {
+                throw doh::cipher_exception(doh::DETERMINISTIC);
+            }
+            for(size_t i{0}; i < n; ++i) {
+                out[i] = static_cast<uint8_t>(rd());
+            }
+#endif
+        }
+
+    }
+
+    /**
+     * @brief Per-thread buffer of cryptographically secure random bytes.
+     * Asking the entropy hardware for a few bytes at a time is slow (a RDSEED can take thousands of cycles and fails
+     * under contention), so the pool is refilled POOL_SIZE bytes at a time - from RDSEED with retries, then RDRAND,
+     * then getrandom for whatever the hardware could not supply - and draws are then just a memcpy.
+     * Consumed bytes are wiped from the pool so that a later memory disclosure does not reveal them.
+     * ```
+     * crypto::entropy_pool<>::local().fill(key.data(), key.size());
+     * ```
+     * @tparam POOL_SIZE bytes fetched per refill
+     */
+    template<size_t POOL_SIZE = 4096>
+    class entropy_pool {
+
+        static_assert(POOL_SIZE % sizeof(uint64_t) == 0, "POOL_SIZE must be a whole number of 64 bit words");
+
+    public:
+
+        entropy_pool() = default;
+
+        entropy_pool(const entropy_pool&) = delete;
+        entropy_pool& operator=(const entropy_pool&) = delete;
+
+        ~entropy_pool() {
+            secure_wipe(pool_.data(), pool_.size());
+        }
+
+        /**
+         * @brief the calling thread's pool - no locking, no sharing of random bytes between threads
+         */
+        static entropy_pool& local() {
+            thread_local entropy_pool pool;
+            return pool;
+        }
+
+        /**
+         * @brief copy out _n_ random bytes
+         * @throws doh::cipher_exception(DETERMINISTIC) if no secure source could supply them
+         */
+        void fill(uint8_t* out, size_t n) {
+            while(n) {
+                if(pos_ == POOL_SIZE) {
+                    refill();
+                }
+                const size_t k = std::min(n, POOL_SIZE - pos_);
+                std::memcpy(out, pool_.data() + pos_, k);
+                secure_wipe(pool_.data() + pos_, k);
+                pos_ += k;
+                out += k;
+                n -= k;
+            }
+        }
+
+        template<typename T>
+        T get() {
+            T t;
+            fill(reinterpret_cast<uint8_t*>(&t), sizeof(T));
+            return t;
+        }
+
+        constexpr static size_t size() {
+            return POOL_SIZE;
+        }
+
+    private:
+
+        void refill() {
+            const size_t hw = entropy::hardware_fill(pool_.data(), POOL_SIZE);
+            entropy::os_fill(pool_.data() + hw, POOL_SIZE - hw);
+            pos_ = 0;
+        }
+
+        std::array<uint8_t, POOL_SIZE> pool_{};
+
+        size_t pos_{POOL_SIZE};
+
+    };
+
+}
+
+#endif //AES_CPP17_ENTROPY_POOL_H
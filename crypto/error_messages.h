@@ -14,6 +14,13 @@ namespace doh {
      */
     static const std::string UNPADDING = " Decryption Failed - Padding Checksum Error! ";
     static const std::string DETERMINISTIC = " Deterministic Random Number Generator! ";
+    static const std::string ALIGNMENT = " Block Cipher Input Not Block Aligned! ";
+    static const std::string AUTHENTICATION = " Decryption Failed - Authentication Tag Mismatch! ";
+    static const std::string MALFORMED = " Malformed Cipher Container! ";
+    static const std::string EXHAUSTED = " Nonce Space Exhausted! ";
+    static const std::string HRNG = " Hardware Random Number Generator Unavailable! ";
+    static const std::string NONCE_REUSE = " Encryption Refused - Probable Nonce Reuse! ";
+    static const std::string SELF_TEST = " Power-On Self-Test Failed - Portable AES Known Answer Mismatch! ";
 
 #endif
 
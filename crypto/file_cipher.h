@@ -0,0 +1,282 @@
+#ifndef AES_CPP17_FILE_CIPHER_H
+#define AES_CPP17_FILE_CIPHER_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "chained_cipher.h"
+#include "../util/uring.h"
+
+namespace crypto {
+
+    template<typename C>
+    class file_cipher;
+
+    /**
+     * @brief classify one read or write of a chunk that moved _res_ bytes, or failed with -errno as io_uring reports it
+     * @return int 0 to carry on - bytes moved, or EINTR / EAGAIN to retry - otherwise the errno to fail with: EIO for
+     * a transfer of 0 bytes, since the file was truncated underneath us or the device takes no more, and retrying would
+     * spin for ever
+     */
+    inline int transfer_error(int64_t res) {
+        if(res > 0) {
+            return 0;
+        }
+        if(res == 0) {
+            return EIO;
+        }
+        return (res == -EINTR || res == -EAGAIN) ? 0 : static_cast<int>(-res);
+    }
+
+    /**
+     * @brief Bulk CTR encryption of one file descriptor into another (or the same one, in place).
+     * CTR is random access - the counter for the chunk at byte offset _o_ is simply nonce + o / 16 - so chunks are
+     * independent and can complete in any order. On Linux a queue depth of fixed buffer reads and writes is kept in
+     * flight through io_uring with the buffers registered with the kernel, each completed read is encrypted in place
+     * and handed straight back as a write. This takes the syscall per chunk and the thread hand offs out of bulk
+     * archival. Where io_uring is unavailable (older kernels, seccomp'd containers, RLIMIT_MEMLOCK) it falls back to
+     * a plain pread/pwrite loop with identical output.
+     * @note I/O errors are reported as std::system_error
+     * @tparam T
+     * @tparam U
+     */
+    template<typename T, typename U>
+    class file_cipher<block_cipher<CTR, T, U>> {
+
+        struct slot_t {
+            uint64_t offset; // file offset of this chunk
+            size_t size;     // chunk size
+            size_t done;     // bytes transferred so far by the current read or write
+        };
+
+    public:
+
+        using cipher_t = block_cipher<CTR, T, U>;
+        using block_t = typename cipher_t::block_t;
+        using value_type = typename cipher_t::value_type;
+
+        constexpr static size_t DEFAULT_CHUNK_SIZE = 256 * 1024;
+
+        constexpr static unsigned DEFAULT_QUEUE_DEPTH = 8;
+
+        /**
+         * @param cipher keyed CTR block cipher
+         * @param chunk_size bytes per I/O - rounded up to a multiple of the block size
+         * @param queue_depth number of chunks in flight
+         * @param use_io_uring false forces the pread/pwrite path
+         */
+        explicit file_cipher(cipher_t& cipher,
+                             size_t chunk_size = DEFAULT_CHUNK_SIZE,
+                             unsigned queue_depth = DEFAULT_QUEUE_DEPTH,
+                             bool use_io_uring = true):
+            cipher_(cipher),
+            chunk_size_(((chunk_size + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_SIZE),
+            depth_(queue_depth ? queue_depth : 1),
+            use_io_uring_(use_io_uring)
+        {}
+
+        file_cipher(const file_cipher&) = delete;
+        file_cipher& operator=(const file_cipher&) = delete;
+
+        /**
+         * @brief encrypt the whole of _in_ into _out_ at the same offsets
+         * @param in readable file descriptor
+         * @param out writable file descriptor (may be _in_ for in place encryption)
+         * @param nonce the nonce-counter block for offset 0
+         * @return uint64_t bytes encrypted
+         * @throws std::system_error(ESPIPE) if _in_ is not a regular file - a pipe, socket or device has no size to
+         * read up to and cannot be read at an offset
+         */
+        uint64_t encrypt(int in, int out, const block_t& nonce) {
+            struct stat st{};
+            if(fstat(in, &st) != 0) {
+                throw std::system_error(errno, std::generic_category());
+            }
+            if(!S_ISREG(st.st_mode)) {
+                throw std::system_error(ESPIPE, std::generic_category());
+            }
+            const auto size = static_cast<uint64_t>(st.st_size);
+            std::vector<value_type> buffers((BLOCK_SIZE + chunk_size_) * depth_);
+#ifdef AES_CPP17_HAS_IO_URING
+            if(use_io_uring_) {
+                util::uring ring(depth_);
+                if(ring.ok() && ring.entries() >= depth_) {
+                    std::vector<iovec> iov(depth_);
+                    for(unsigned i{0}; i < depth_; ++i) {
+                        iov[i].iov_base = payload(buffers, i);
+                        iov[i].iov_len = chunk_size_;
+                    }
+                    if(ring.register_buffers(iov.data(), depth_)) {
+                        uring_ = true;
+                        return encrypt(ring, in, out, size, nonce, buffers);
+                    }
+                }
+            }
+#endif
+            uring_ = false;
+            return encrypt(in, out, size, nonce, buffers);
+        }
+
+        /**
+         * @brief CTR decryption is encryption
+         */
+        uint64_t decrypt(int in, int out, const block_t& nonce) {
+            return encrypt(in, out, nonce);
+        }
+
+        /**
+         * @brief did the last encrypt run on io_uring?
+         * @return bool
+         */
+        inline bool uring() const {
+            return uring_;
+        }
+
+        inline size_t chunk_size() const {
+            return chunk_size_;
+        }
+
+    private:
+
+        value_type* payload(std::vector<value_type>& buffers, unsigned i) const {
+            return buffers.data() + (BLOCK_SIZE + chunk_size_) * i + BLOCK_SIZE;
+        }
+
+        /**
+         * @brief encrypt one chunk in place with the counter seeked to its file offset
+         */
+        void apply(value_type* p, const slot_t& s, const block_t& nonce) {
+            block_t ctr = nonce;
+            cipher_t::inc_block(ctr, s.offset / BLOCK_SIZE);
+            chained_cipher<cipher_t>(cipher_, ctr).encrypt(p, p + s.size);
+        }
+
+        /**
+         * @brief count the bytes a read or write of _s_ moved
+         * @throws std::system_error @see transfer_error
+         */
+        static void advance(slot_t& s, int64_t res) {
+            if(const int error = transfer_error(res)) {
+                throw std::system_error(error, std::generic_category());
+            }
+            if(res > 0) {
+                s.done += static_cast<size_t>(res);
+            }
+        }
+
+        /**
+         * @brief portable fallback
+         */
+        uint64_t encrypt(int in, int out, uint64_t size, const block_t& nonce, std::vector<value_type>& buffers) {
+            value_type* p = payload(buffers, 0);
+            for(uint64_t offset{0}; offset < size; offset += chunk_size_) {
+                slot_t s{offset, static_cast<size_t>(std::min<uint64_t>(chunk_size_, size - offset)), 0};
+                while(s.done < s.size) {
+                    ssize_t r = pread(in, p + s.done, s.size - s.done, static_cast<off_t>(s.offset + s.done));
+                    advance(s, r < 0 ? -errno : r);
+                }
+                apply(p, s, nonce);
+                for(s.done = 0; s.done < s.size;) {
+                    ssize_t r = pwrite(out, p + s.done, s.size - s.done, static_cast<off_t>(s.offset + s.done));
+                    advance(s, r < 0 ? -errno : r);
+                }
+            }
+            return size;
+        }
+
+#ifdef AES_CPP17_HAS_IO_URING
+
+        /**
+         * @brief every slot cycles read -> encrypt -> write -> read the next unclaimed chunk, until the file is done
+         * @note user_data carries the slot index << 1 | is_write
+         * @note on a failed read or write no new chunk is claimed and nothing is resubmitted, but the error is only
+         * thrown once every operation in flight has completed - until then the kernel may still read or write the
+         * registered buffers, which the caller frees as the exception unwinds
+         */
+        uint64_t encrypt(util::uring& ring, int in, int out, uint64_t size, const block_t& nonce,
+                         std::vector<value_type>& buffers) {
+            std::vector<slot_t> slots(depth_);
+            uint64_t next{0};
+            unsigned inflight{0};
+            auto read = [&](unsigned i) {
+                slot_t& s = slots[i];
+                ring.prepare(IORING_OP_READ_FIXED, in, payload(buffers, i) + s.done,
+                             static_cast<unsigned>(s.size - s.done), s.offset + s.done, i, i << 1u);
+            };
+            auto write = [&](unsigned i) {
+                slot_t& s = slots[i];
+                ring.prepare(IORING_OP_WRITE_FIXED, out, payload(buffers, i) + s.done,
+                             static_cast<unsigned>(s.size - s.done), s.offset + s.done, i, (i << 1u) | 1u);
+            };
+            auto claim = [&](unsigned i) {
+                if(next >= size) return false;
+                slots[i] = slot_t{next, static_cast<size_t>(std::min<uint64_t>(chunk_size_, size - next)), 0};
+                next += slots[i].size;
+                read(i);
+                return true;
+            };
+            for(unsigned i{0}; i < depth_ && claim(i); ++i) {
+                ++inflight;
+            }
+            int error{0}; // the first failure, thrown once the kernel is done with the buffers
+            while(inflight) {
+                if(!ring.submit(1) && errno != EAGAIN && errno != EBUSY) { // busy: reap completions to make room
+                    throw std::system_error(errno, std::generic_category()); // the ring itself is unusable
+                }
+                uint64_t user_data;
+                int res;
+                while(ring.next(user_data, res)) {
+                    const auto i = static_cast<unsigned>(user_data >> 1u);
+                    const bool is_write = user_data & 1u;
+                    slot_t& s = slots[i];
+                    if(!error) {
+                        error = transfer_error(res);
+                    }
+                    if(error) { // drain: this slot is idle for good
+                        --inflight;
+                        continue;
+                    }
+                    if(res > 0) {
+                        s.done += static_cast<size_t>(res);
+                    }
+                    if(s.done < s.size) { // short transfer - resubmit the remainder
+                        is_write ? write(i) : read(i);
+                    } else if(!is_write) {
+                        apply(payload(buffers, i), s, nonce);
+                        s.done = 0;
+                        write(i);
+                    } else if(!claim(i)) {
+                        --inflight;
+                    }
+                }
+            }
+            if(error) {
+                throw std::system_error(error, std::generic_category());
+            }
+            return size;
+        }
+
+#endif
+
+        cipher_t& cipher_;
+
+        const size_t chunk_size_;
+
+        const unsigned depth_;
+
+        const bool use_io_uring_;
+
+        bool uring_{false};
+
+    };
+
+}
+
+#endif //AES_CPP17_FILE_CIPHER_H
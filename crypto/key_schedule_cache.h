@@ -0,0 +1,254 @@
+#ifndef AES_CPP17_KEY_SCHEDULE_CACHE_H
+#define AES_CPP17_KEY_SCHEDULE_CACHE_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+
+#include "block_cipher_factory.h"
+
+namespace crypto {
+
+    /**
+     * @brief Sharded, concurrent LRU cache of keyed ciphers (i.e. expanded key schedules) indexed by a caller supplied
+     * key identifier, so that a hot tenant's key is expanded once rather than once per request.
+     * + the key id is hashed to one of SHARDS independently locked shards - threads serving different tenants rarely
+     * contend
+     * + each shard holds at most capacity / SHARDS schedules, the least recently used is evicted and zeroised, its
+     * list node reused for the newcomer by rekeying in place
+     * + ciphers are handed out by value - a copy of the expanded key with no re-expansion - so an entry can be evicted
+     * while a request still uses its copy
+     * ```
+     * crypto::key_schedule_cache<crypto::block_cipher<crypto::CBC>> cache(10'000);
+     * auto aes = cache.get(tenant_id, [&] { return fetch_key(tenant_id); }); // the key is only fetched on a miss
+     * ```
+     * @warning the cache trusts the key id - one id must only ever name one key, erase() it (or use a new id) on rotation
+     * @note copies handed out are the caller's to wipe
+     * @tparam C keyed cipher e.g. block_cipher<M, T, U>
+     * @tparam SHARDS
+     */
+    template<typename C = block_cipher<>, size_t SHARDS = 16>
+    class key_schedule_cache {
+
+        static_assert(SHARDS > 0 && (SHARDS & (SHARDS - 1)) == 0, "SHARDS must be a power of 2");
+        static_assert(std::is_trivially_copyable_v<C>, "the cipher is zeroised as raw bytes on eviction");
+
+    public:
+
+        using cipher_t = C;
+
+        constexpr static size_t DEFAULT_CAPACITY = 1 << 12;
+
+        /**
+         * @param capacity maximum number of schedules held, rounded up to a whole number per shard
+         */
+        explicit key_schedule_cache(size_t capacity = DEFAULT_CAPACITY):
+            per_shard_((std::max(capacity, size_t{1}) + SHARDS - 1) / SHARDS) {}
+
+        key_schedule_cache(const key_schedule_cache&) = delete;
+        key_schedule_cache& operator=(const key_schedule_cache&) = delete;
+
+        ~key_schedule_cache() {
+            wipe();
+        }
+
+        /**
+         * @brief look up the cipher for _key_id_ without expanding anything
+         * @note a hit counts as one, a miss does not - it is counted by the get() that follows it
+         * @param key_id
+         * @return std::optional<C> empty on a miss
+         */
+        std::optional<C> find(uint64_t key_id) {
+            auto& s = shard(key_id);
+            std::lock_guard<std::mutex> lock(s.mutex);
+            const auto it = s.index.find(key_id);
+            if(it == s.index.end()) {
+                return std::nullopt;
+            }
+            s.hits.fetch_add(1, std::memory_order_relaxed);
+            s.lru.splice(s.lru.begin(), s.lru, it->second);
+            return it->second->cipher;
+        }
+
+        /**
+         * @brief the cipher for _key_id_, expanding _key_ only if it is not already cached
+         * @tparam KeySequence
+         * @param key_id
+         * @param key
+         * @return C
+         */
+        template<class KeySequence, typename = std::enable_if_t<!std::is_invocable_v<const KeySequence&>>>
+        C get(uint64_t key_id, const KeySequence& key) {
+            return get(key_id, [&key]() -> const KeySequence& { return key; });
+        }
+
+        /**
+         * @brief the cipher for _key_id_, calling _fetch_ for the key only on a miss - the hot path never needs the key
+         * @note _fetch_ is called with the shard locked, a key it returns by value is wiped once expanded
+         * @tparam Fetch callable returning a key sequence
+         * @param key_id
+         * @param fetch
+         * @return C
+         */
+        template<class Fetch, typename = std::enable_if_t<std::is_invocable_v<Fetch&>>>
+        C get(uint64_t key_id, Fetch&& fetch) {
+            auto& s = shard(key_id);
+            std::lock_guard<std::mutex> lock(s.mutex);
+            const auto it = s.index.find(key_id);
+            if(it != s.index.end()) {
+                s.hits.fetch_add(1, std::memory_order_relaxed);
+                s.lru.splice(s.lru.begin(), s.lru, it->second);
+                return it->second->cipher;
+            }
+            s.misses.fetch_add(1, std::memory_order_relaxed);
+            decltype(auto) key = fetch();
+            insert(s, key_id, key);
+            if constexpr (!std::is_reference_v<decltype(key)>) {
+                secure_wipe(std::data(key), std::size(key) * sizeof(*std::data(key)));
+            }
+            return s.lru.front().cipher;
+        }
+
+        /**
+         * @brief evict and zeroise the schedule for _key_id_ e.g. when the tenant's key is rotated or revoked
+         * @return bool true if it was cached
+         */
+        bool erase(uint64_t key_id) {
+            auto& s = shard(key_id);
+            std::lock_guard<std::mutex> lock(s.mutex);
+            const auto it = s.index.find(key_id);
+            if(it == s.index.end()) {
+                return false;
+            }
+            zeroise(it->second->cipher);
+            s.lru.erase(it->second);
+            s.index.erase(it);
+            return true;
+        }
+
+        /**
+         * @brief evict and zeroise every schedule, the counters are kept
+         */
+        void wipe() {
+            for(auto& s: shards_) {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                for(auto& e: s.lru) {
+                    zeroise(e.cipher);
+                }
+                s.lru.clear();
+                s.index.clear();
+            }
+        }
+
+        size_t size() const {
+            size_t n{0};
+            for(auto& s: shards_) {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                n += s.lru.size();
+            }
+            return n;
+        }
+
+        inline size_t capacity() const {
+            return per_shard_ * SHARDS;
+        }
+
+        uint64_t hits() const {
+            return sum(&shard_t::hits);
+        }
+
+        uint64_t misses() const {
+            return sum(&shard_t::misses);
+        }
+
+        uint64_t evictions() const {
+            return sum(&shard_t::evictions);
+        }
+
+    private:
+
+        struct entry_t {
+
+            template<class KeySequence>
+            entry_t(uint64_t id, const KeySequence& key): key_id(id), cipher(key) {}
+
+            uint64_t key_id;
+
+            C cipher;
+
+        };
+
+        struct alignas(CACHE_LINE) shard_t {
+
+            mutable std::mutex mutex;
+
+            std::list<entry_t> lru; // most recently used at the front
+
+            std::unordered_map<uint64_t, typename std::list<entry_t>::iterator> index;
+
+            std::atomic<uint64_t> hits{0};
+
+            std::atomic<uint64_t> misses{0};
+
+            std::atomic<uint64_t> evictions{0};
+
+        };
+
+        /**
+         * @brief MurmurHash3 64 bit finaliser - sequential tenant ids spread evenly over the shards
+         */
+        inline shard_t& shard(uint64_t key_id) {
+            key_id ^= key_id >> 33u;
+            key_id *= 0xff51afd7ed558ccdull;
+            key_id ^= key_id >> 33u;
+            return shards_[key_id & (SHARDS - 1)];
+        }
+
+        uint64_t sum(std::atomic<uint64_t> shard_t::* counter) const {
+            uint64_t n{0};
+            for(auto& s: shards_) {
+                n += (s.*counter).load(std::memory_order_relaxed);
+            }
+            return n;
+        }
+
+        /**
+         * @brief cache a cipher for _key_ at the front of the shard, recycling the least recently used node when full
+         * @note the shard is locked by the caller
+         */
+        template<class KeySequence>
+        void insert(shard_t& s, uint64_t key_id, const KeySequence& key) {
+            if(s.lru.size() < per_shard_) {
+                s.lru.emplace_front(key_id, key);
+            } else { // recycle the least recently used node
+                auto last = std::prev(s.lru.end());
+                s.index.erase(last->key_id);
+                zeroise(last->cipher);
+                s.evictions.fetch_add(1, std::memory_order_relaxed);
+                last->key_id = key_id;
+                last->cipher.rekey(key);
+                s.lru.splice(s.lru.begin(), s.lru, last);
+            }
+            s.index.emplace(key_id, s.lru.begin());
+        }
+
+        static void zeroise(C& cipher) {
+            secure_wipe(&cipher, sizeof(C));
+        }
+
+        const size_t per_shard_;
+
+        std::array<shard_t, SHARDS> shards_;
+
+    };
+
+}
+
+#endif //AES_CPP17_KEY_SCHEDULE_CACHE_H
@@ -0,0 +1,237 @@
+#ifndef AES_CPP17_MULTI_BUFFER_CTR_H
+#define AES_CPP17_MULTI_BUFFER_CTR_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+
+#include "aes_encrypt.h"
+#include "aes_key_batch.h"
+#include "cpu_features.h"
+
+#ifdef AES_CPP17_X86
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+namespace crypto {
+
+    /**
+     * @brief one message for a multi_buffer_ctr: its key schedule, initial nonce-counter block and buffer, encrypted
+     * in place
+     */
+    struct ctr_job {
+        const uint8_t* round_keys; // round key r at round_keys + r * stride, no alignment required
+        size_t stride;
+        std::array<uint8_t, BLOCK_SIZE> counter;
+        uint8_t* data;
+        size_t size;
+    };
+
+    /**
+     * @brief Multi-key multi-buffer CTR engine - many short messages, each under its own key, in one pass.
+     * A lone small message leaves the AES pipeline mostly idle: every round waits on the previous one. The engine
+     * schedules the jobs into LANES lanes and runs the rounds interleaved across the lanes, each lane with its own round
+     * keys and nonce-counter, so that independent AESENCs are in flight together. A lane whose message is done is
+     * refilled with the next job straight away.
+     * ```
+     * using engine_t = crypto::multi_buffer_ctr<>;
+     * std::vector<aes::encrypt<>> ciphers; // jobs point into the ciphers, which must outlive run()
+     * ciphers.reserve(messages.size());
+     * std::vector<engine_t::job_t> jobs;
+     * for(auto& m: messages) {
+     *     ciphers.emplace_back(tenant_key(m));
+     *     jobs.push_back(engine_t::job(ciphers.back(), m.nonce, m.data(), m.size()));
+     * }
+     * engine_t::run(jobs.begin(), jobs.end());
+     * ```
+     * @note a message may end part way through a block (unlike block_cipher<CTR>::encrypt), decrypting is the same
+     * operation
+     * @note unless AES-NI is the active_kernel() the jobs are run one after another through the portable cipher
+     * @tparam R
+     * @tparam N
+     * @tparam LANES
+     */
+    template<aes::ROUNDS R = aes::R256, aes::KEY_LENGTH N = aes::N256, size_t LANES = 8>
+    class multi_buffer_ctr {
+
+        static_assert(LANES >= 1 && LANES <= 16, "1 to 16 lanes");
+
+    public:
+
+        using block_t = std::array<uint8_t, BLOCK_SIZE>;
+
+        using job_t = ctr_job;
+
+        /**
+         * @brief a job that points at the cipher's round keys, so the cipher must outlive run()
+         */
+        static job_t job(const aes::encrypt<R, N>& cipher, const block_t& counter, uint8_t* data, size_t size) {
+            return {cipher.round_keys(), BLOCK_SIZE, counter, data, size};
+        }
+
+        static job_t job(aes::encrypt<R, N>&&, const block_t&, uint8_t*, size_t) = delete;
+
+        /**
+         * @brief a job that points at lane _lane_ of the batch, so the batch must outlive run()
+         */
+        template<size_t L>
+        static job_t job(const aes::key_batch<R, N, L>& batch, size_t lane, const block_t& counter, uint8_t* data,
+                         size_t size) {
+            return {batch.round(0) + lane * BLOCK_SIZE, L * BLOCK_SIZE, counter, data, size};
+        }
+
+        template<size_t L>
+        static job_t job(aes::key_batch<R, N, L>&&, size_t, const block_t&, uint8_t*, size_t) = delete;
+
+        /**
+         * @brief encrypt (or decrypt) every job in the range
+         * @tparam JobIterator to job_t
+         */
+        template<typename JobIterator>
+        static void run(JobIterator first, JobIterator last) {
+#ifdef AES_CPP17_X86
+            if(active_kernel() == AESNI) {
+                run_aesni(first, last);
+                return;
+            }
+#endif
+            run_portable(first, last);
+        }
+
+        /**
+         * @brief one job at a time through aes::encrypt, the reference for the interleaved kernel
+         */
+        template<typename JobIterator>
+        static void run_portable(JobIterator first, JobIterator last) {
+            for(; first != last; ++first) {
+                job_t job = *first;
+                std::array<uint8_t, R * BLOCK_SIZE> xkey;
+                for(size_t r{0}; r < R; ++r) {
+                    std::copy(job.round_keys + r * job.stride, job.round_keys + r * job.stride + BLOCK_SIZE,
+                              xkey.begin() + r * BLOCK_SIZE);
+                }
+                auto cipher = aes::encrypt<R, N>::from_round_keys(xkey.begin());
+                while(job.size) {
+                    block_t stream = job.counter;
+                    cipher.block(stream.begin());
+                    const size_t n = std::min(job.size, BLOCK_SIZE);
+                    for(size_t i{0}; i < n; ++i) {
+                        job.data[i] ^= stream[i];
+                    }
+                    increment(job.counter);
+                    job.data += n;
+                    job.size -= n;
+                }
+            }
+        }
+
+#ifdef AES_CPP17_X86
+
+        /**
+         * @brief the lanes advance a block per pass, round by round across every lane
+         * @note the round loops always span all LANES (idle lanes, never filled or drained, encrypt a zero block under
+         * a zero key) so that they unroll and the lane states stay in registers
+         * @note only call when can_aesni()
+         */
+        template<typename JobIterator>
+        AES_CPP17_TARGET("aes") static void run_aesni(JobIterator first, JobIterator last) {
+            alignas(16) static const uint8_t idle_keys[BLOCK_SIZE]{};
+            const job_t idle{idle_keys, 0, {}, nullptr, 0};
+            std::array<job_t, LANES> lanes;
+            lanes.fill(idle);
+            size_t active{0};
+            while(active < LANES && next(first, last, lanes[active])) {
+                ++active;
+            }
+            while(active) {
+                __m128i s[LANES];
+                for(size_t l{0}; l < LANES; ++l) {
+                    s[l] = _mm_xor_si128(load(lanes[l].counter.data()), load_key(lanes[l].round_keys));
+                }
+                for(size_t r{1}; r < R - 1; ++r) {
+                    for(size_t l{0}; l < LANES; ++l) {
+                        s[l] = _mm_aesenc_si128(s[l], load_key(lanes[l].round_keys + r * lanes[l].stride));
+                    }
+                }
+                for(size_t l{0}; l < LANES; ++l) {
+                    s[l] = _mm_aesenclast_si128(s[l], load_key(lanes[l].round_keys + (R - 1) * lanes[l].stride));
+                }
+                for(size_t l{0}; l < active;) {
+                    job_t& job = lanes[l];
+                    if(job.size >= BLOCK_SIZE) {
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(job.data), _mm_xor_si128(load(job.data), s[l]));
+                        job.data += BLOCK_SIZE;
+                        job.size -= BLOCK_SIZE;
+                    } else { // the final partial block
+                        alignas(16) uint8_t stream[BLOCK_SIZE];
+                        _mm_store_si128(reinterpret_cast<__m128i*>(stream), s[l]);
+                        for(size_t i{0}; i < job.size; ++i) {
+                            job.data[i] ^= stream[i];
+                        }
+                        job.size = 0;
+                    }
+                    increment(job.counter);
+                    if(job.size || next(first, last, job)) {
+                        ++l;
+                    } else { // no more jobs, move the last active lane (keystream block not yet applied) into the gap
+                        --active;
+                        std::swap(job, lanes[active]);
+                        std::swap(s[l], s[active]);
+                        lanes[active] = idle; // rather than go on encrypting under the finished job's key
+                    }
+                }
+            }
+        }
+
+#endif
+
+    private:
+
+        /**
+         * @brief the next non-empty job, if any
+         */
+        template<typename JobIterator>
+        static bool next(JobIterator& first, JobIterator last, job_t& job) {
+            for(; first != last; ++first) {
+                if(first->size) {
+                    job = *first++;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * @brief the 128 bit big endian nonce-counter + 1
+         */
+        static inline void increment(block_t& counter) {
+            for(size_t i{BLOCK_SIZE}; i-- > 0;) {
+                if(++counter[i]) break;
+            }
+        }
+
+#ifdef AES_CPP17_X86
+
+        AES_CPP17_TARGET("sse2") static inline __m128i load(const uint8_t* p) {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        }
+
+        /**
+         * @brief an unaligned load: ctr_job is a public aggregate, so its round keys may come from any caller's
+         * buffer - on aligned data (the aes::encrypt and key_batch schedules start on a cache line) MOVDQU costs the
+         * same as MOVDQA on every AES-NI core
+         */
+        AES_CPP17_TARGET("sse2") static inline __m128i load_key(const uint8_t* p) {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        }
+
+#endif
+
+    };
+
+}
+
+#endif //AES_CPP17_MULTI_BUFFER_CTR_H
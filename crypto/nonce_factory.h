@@ -2,142 +2,78 @@
 #define AES_CPP17_NONCE_FACTORY_H
 
 #include <cstdint>
+#include <mutex>
 #include <random>
 #include <array>
+#include <vector>
 
 //#define NDEBUG
-//#define __RDSEED__
-
-#if defined(_MSC_VER)
-/* Microsoft C/C++-compatible compiler */
-     #include <intrin.h>
-#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
-/* GCC-compatible compiler, targeting x86/x86-64 */
-#include <x86intrin.h>
-#include <cpuid.h>
-#elif defined(__GNUC__) && defined(__ARM_NEON__)
-/* GCC-compatible compiler, targeting ARM with NEON */
-     #include <arm_neon.h>
-#elif defined(__GNUC__) && defined(__IWMMXT__)
-     /* GCC-compatible compiler, targeting ARM with WMMX */
-     #include <mmintrin.h>
-#elif (defined(__GNUC__) || defined(__xlC__)) && (defined(__VEC__) || defined(__ALTIVEC__))
-     /* XLC or GCC-compatible compiler, targeting PowerPC with VMX/VSX */
-     #include <altivec.h>
-#elif defined(__GNUC__) && defined(__SPE__)
-     /* GCC-compatible compiler, targeting PowerPC with SPE */
-     #include <spe.h>
-#endif
 
 #include "block_cipher_constants.h"
 #include "cipher_exception.h"
+#include "cpu_features.h"
+#include "entropy_pool.h"
 
 namespace crypto {
 
-#ifdef _MSC_VER  // Use MSVC __cpuid
-    /**
-     * @brief test if can use HRNG intrinsic RDRAND
-     * Use the MSVC compiler intrinsic to call the processor supplementary instruction to discover CPU functionality
-     * Specifically the extended feature flags in EBX, ECX, and EDX
-     * @return bool true = HRNG can RDRAND
-     */
-    bool can_rdrand() {
-            int regs[4];
-            __cpuid(regs, 1);
-            return regs[1] & bit_RDRAND;
-        }
-
-    /**
-     * @brief test if can use HRNG intrinsic RDSEED
-     * @note RDSEED is slower but offers greater entropy
-     * Use the MSVC compiler intrinsic to call the processor supplementary instruction to discover CPU functionality
-     * Specifically the extended feature flags in EBX, ECX, and EDX
-     * @return bool true = HRNG can RDSEED
-     */
-    bool can_rdseed() {
-        int regs[4];
-        __cpuid(regs, 7);
-        return regs[1] & bit_RDSEED;
-    }
-#else // Use GNU C cpuid.h
-#include <cpuid.h>
-    /**
-     * @brief test ig can use HRNG intrinsic RDRAND
-     * Use the GNU (et al) compiler intrinsic to call the processor supplementary instruction to discover CPU functionality
-     * Specifically the extended feature flags in EBX, ECX, and EDX
-     * @return bool true = HRNG can RDRAND
-     */
-    bool can_rdrand() {
-        unsigned int regs[4]{};
-        __get_cpuid (1, &regs[0], &regs[1], &regs[2], &regs[3]);
-        return regs[2] & bit_RDRND; //bit_RDRAND predefined in GNU et al
-    }
-
-    /**
-     * @brief test ig can use HRNG intrinsic RDRAND
-     * Use the GNU (et al) compiler intrinsic to call the processor supplementary instruction to discover CPU functionality
-     * Specifically the extended feature flags in EBX, ECX, and EDX
-     * @return bool true = HRNG can RDSEED
-     */
-    bool can_rdseed() {
-        unsigned int regs[4]{};
-        __get_cpuid (7, &regs[0], &regs[1], &regs[2], &regs[3]);
-        return regs[2] & bit_RDSEED; //bit_RDSEED predefined in GNU et al
-    }
-#endif
-
     /**
      * Nonce modes, two basic groups
-     * + Cryptographically secure (for a stream cipher, that is resistant to nonce reuse) using block_t = aes::encrypt<>::block_t;
-        using value_type = aes::encrypt<>::value_type;
+     * + Cryptographically secure (for a stream cipher, that is resistant to nonce reuse)
+     *   + CSPOOL (default) per-thread entropy_pool, secure with or without HRNG by way of the operating system CSPRNG
+     *   + CSSEED64, CSSEED32, CSSEED16 straight from the RDSEED entropy hardware (64 bit x86-64 only)
+     *   + COUNTER deterministic and needs no HRNG at all
      * + Pseudo-random (vulnerable to nonce reuse)
+     *   + PRSEED32
      * @note Given a secure random number generator, one can _(almost)_ guarantee to never repeat a nonce twice in a lifetime.
-     */
-#ifdef __RDSEED__
-    enum nonce_mode_t {
-#ifndef _MSC_VER
-        CSSEED64, CSSEED32, CSSEED16
-#else // as of writing MSCV does not provided a read 64 bit seed intrinsic
-        CSSEED32, CSSEED16
-#endif
-    };
-#else
-    /**
-     * @warning Not cryptographically secure - only for testing
+     * @note The HRNG is detected at run time (cpu_features) so one binary runs everywhere: CSPOOL uses the best source
+     * the CPU has, the CSSEED modes throw doh::HRNG on construction without RDSEED.
      */
     enum nonce_mode_t {
-        PRSEED32
+        CSPOOL, CSSEED64, CSSEED32, CSSEED16, COUNTER, PRSEED32
     };
-#endif
 
+    /**
+      * @note There are a number of problems with writing a nonce factory:
+      * + Only certain later CPUs support hardware entropy as hardware random number generators (HRNG) Intel Ivy Bridge 2012, AMD 2015
+      * + There is no compile time way of knowing the HRNG support of the CPU the binary will eventually run on, hence
+      * the run time detection
+      * + Different compilers implement the intrinsics to read the HRNG differently and incompletely
+      * + A cryptographically secure nonce requires a HRNG or the operating system CSPRNG
+      * + A cryptographically secure nonce must be at least 12 bytes long to effectively mitigate birthday attacks
+      * + A pseudo-random number generator (PRNG) is provided for testing purposed _but it is not secure_
+      * @tparam M
+      * @tparam nonce_size
+      * @tparam T
+      */
+    template<nonce_mode_t M = CSPOOL, size_t nonce_size = NONCE_SIZE, typename T = uint8_t>
+    struct nonce;
 
-#ifdef __RDSEED__
+#ifdef AES_CPP17_X86
 
     /**
-     * @brief Generate large stateless _cryptographically secure_ random nonces from 32 bit entropy hardware.
+     * @brief Generate large stateless _cryptographically secure_ random nonces from the entropy hardware a seed word
+     * at a time.
      * RDSEED, whilst similar to RDRAND, provides higher level access to the entropy hardware.
      * The RDSEED generator and processor instruction rdseed are available with Intel Broadwell CPUs (and later)
      * and AMD Zen CPUs (and later).
-     * @tparam M
+     * @tparam Seed 16, 32 or 64 bit unsigned word
+     * @tparam nonce_size
      * @tparam T
      */
-    template<nonce_mode_t M = CSSEED32, size_t nonce_size = NONCE_SIZE, typename T = uint8_t>
-    /**
-      * @note There are a number of problems with writing a nonce factory:
-      * + Only certain later CPUs support hardware entropy as hardware random number generators (HRNG) Intel Ivy Bridge 2012, AMD 2015
-      * + There does not appear to be any consistent compile time way of detecting HRNG support making conditional compilation impossible
-      * + Different compilers implement the intrinsics to read the HRNG differently and incompletely
-      * + The __RDSEED__ constant is used to select compile time HRNG vs PRNG but must be set manually by using ```can_rdseed``` first to manually test the target system
-      * + A cryptographically secure nonce requires a HRNG
-      * + A cryptographically secure nonce must be at least 12 bytes long to effectively mitigate birthday attacks
-      * + In the abscence of an HRNG a pseudo-random number generator (PRNG) fallback is provided for testing purposed _but it is not secure_
-      * @warning I'm not even sure that providing a PRNG fallback for non-HRNG settings is a good idea?!
-      */
-    struct nonce {
+    template<typename Seed, size_t nonce_size, typename T>
+    struct hrng_nonce {
+
+        static_assert(nonce_size <= BLOCK_SIZE, "nonce_size must fit in a block");
 
         using value_type = T;
         using block_t = std::array<T, crypto::BLOCK_SIZE>;
-        using seed_t = unsigned int;
+        using seed_t = Seed;
+
+        hrng_nonce() {
+            if(!can_rdseed()) {
+                throw doh::cipher_exception(doh::HRNG);
+            }
+        }
 
         /**
          * @brief secure nonce generator
@@ -145,22 +81,13 @@ namespace crypto {
          */
         block_t operator()() {
             block_t block{};
-            size_t p{0};
-            seed_t seed;
-            size_t seed_size = sizeof(seed);
-            for (size_t i{0}; i < nonce_size / seed_size; i ++) {
-                seed = rdseed();
-                for (int j{0}; j < seed_size; ++j) {
-                    p = (i * seed_size) + j;
-                    block[p] = seed & 0xFF;
+            for(size_t i{0}; i < nonce_size; i += sizeof(seed_t)) {
+                seed_t seed = rdseed();
+                for(size_t j{0}; j < sizeof(seed_t) && i + j < nonce_size; ++j) {
+                    block[i + j] = static_cast<T>(seed & 0xFF);
                     seed >>= 8;
                 }
             }
-            seed = rdseed();
-            for(size_t j{0}; j < nonce_size % seed_size; ++j) {
-                block[p + j +1] = seed & 0xFF;
-                seed >>= 8;
-            }
             return block;
         }
 
@@ -169,195 +96,273 @@ namespace crypto {
         seed_t rdseed() {
 #ifdef NDEBUG
             seed_t n;
-            if(_rdseed32_step (&n)) {
-                return n;
+            for(int retry{0}; retry < entropy::HARDWARE_RETRIES; ++retry) {
+                if(entropy::rdseed_step(&n)) {
+                    return n;
+                }
+                _mm_pause();
             }
             throw doh::cipher_exception(doh::DETERMINISTIC);
 #else //return a debug constant for testing against
-            return 0x89ABCDEF;
+            return static_cast<seed_t>(0x0123456789ABCDEFull);
 #endif
         }
 
     };
 
     /**
-     * @brief Generate large stateless _cryptographically secure_ random nonces from 16 bit entropy hardware.
+     * @brief nonces from 32 bit entropy hardware
+     */
+    template<size_t nonce_size, typename T>
+    struct nonce<CSSEED32, nonce_size, T>: hrng_nonce<unsigned int, nonce_size, T> {};
+
+    /**
+     * @brief nonces from 16 bit entropy hardware
+     */
+    template<size_t nonce_size, typename T>
+    struct nonce<CSSEED16, nonce_size, T>: hrng_nonce<unsigned short, nonce_size, T> {};
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+    /**
+     * @brief nonces from 64 bit entropy hardware
+     */
+    template<size_t nonce_size, typename T>
+    struct nonce<CSSEED64, nonce_size, T>: hrng_nonce<unsigned long long, nonce_size, T> {};
+
+#endif
+
+#endif
+
+    /**
+     * @warning Here be cryptographically insecure dragons!
      * @tparam nonce_size
      * @tparam T
      */
     template<size_t nonce_size, typename T>
-    struct nonce<CSSEED16, nonce_size, T> {
+    struct nonce<PRSEED32, nonce_size, T> {
 
         using value_type = T;
         using block_t = std::array<T, crypto::BLOCK_SIZE>;
-        using seed_t = unsigned short;
+        using seed_t = std::random_device::result_type;
 
         /**
-         * @brief secure nonce generator
-         * @return a cryptographically secure nonce block with nonce_size high bytes seeded from hardware entropy source
+         * @brief *in*secure nonce generator
+         * @return a cryptographically useless nonce block
          */
         block_t operator()() {
             block_t block{};
-            size_t p{0};
-            seed_t seed;
-            size_t seed_size = sizeof(seed);
-            for (size_t i{0}; i < nonce_size / seed_size; i ++) {
-                seed = rdseed();
-                for (int j{0}; j < seed_size; ++j) {
-                    p = (i * seed_size) + j;
-                    block[p] = seed & 0xFF;
+            for(size_t i{0}; i < nonce_size; i += sizeof(seed_t)) {
+                seed_t seed = rdseed();
+                for(size_t j{0}; j < sizeof(seed_t) && i + j < nonce_size; ++j) {
+                    block[i + j] = static_cast<T>(seed & 0xFF);
                     seed >>= 8;
                 }
             }
-            seed = rdseed();
-            for(size_t j{0}; j < nonce_size % seed_size; ++j) {
-                block[p + j + 1] = seed & 0xFF;
-                seed >>= 8;
-            }
             return block;
         }
 
+
+        /**
+         * @brief A deterministic random number generator (e.g. a pseudo-random engine) has entropy zero.
+         * @note This function is not fully implemented in some standard libraries.
+         * For example:
+         * + LLVM libc++ always returns zero even though the device _is_ non-deterministic.
+         * + Microsoft Visual C++ implementation always returns 32 guarantees that random_device
+         * is cryptographically secure and non-deterministic:
+         * @link https://msdn.microsoft.com/en-us/library/bb982250.aspx
+         * @return double -
+         */
+        inline double entropy() {
+            return rd.entropy();
+        }
+
     private:
 
         seed_t rdseed() {
 #ifdef NDEBUG
-            seed_t n;
-            if(_rdseed16_step (&n)) {
-                return n;
-            }
-            throw cipher_exception(doh::DETERMINISTIC);
+            return rd();
 #else //return a debug constant for testing against
-            return 0xCDEF;
+            return 0x89ABCDEF;
 #endif
         }
 
-    };
+        std::random_device rd;
 
-    #ifndef _MSC_VER // N.B. MSVC intrin.h does not support _rdseed64_step
+    };
 
     /**
-     * @brief Generate large stateless _cryptographically secure_ random nonces from 64 bit entropy hardware.
+     * @brief Generate _cryptographically secure_ random nonces from a per-thread entropy_pool.
+     * The pool is refilled in bulk (RDSEED, RDRAND then getrandom) so the cost per nonce is a memcpy rather than
+     * several trips to the entropy hardware, and a transiently starved RDSEED no longer throws.
      * @tparam nonce_size
      * @tparam T
      */
     template<size_t nonce_size, typename T>
-    struct nonce<CSSEED64, nonce_size, T> {
+    struct nonce<CSPOOL, nonce_size, T> {
+
+        static_assert(nonce_size <= BLOCK_SIZE, "nonce_size must fit in a block");
 
         using value_type = T;
         using block_t = std::array<T, crypto::BLOCK_SIZE>;
-        using seed_t = unsigned long long;
 
         /**
          * @brief secure nonce generator
-         * @return a cryptographically secure nonce block with nonce_size high bytes seeded from hardware entropy source
+         * @return a cryptographically secure nonce block with nonce_size high bytes from the entropy pool
          */
         block_t operator()() {
+            std::array<uint8_t, nonce_size> bytes;
+            entropy_pool<>::local().fill(bytes.data(), nonce_size);
             block_t block{};
-            size_t p{0};
-            seed_t seed;
-            size_t seed_size = sizeof(seed);
-            for (size_t i{0}; i < nonce_size / seed_size; i ++) {
-                seed = rdseed();
-                for (int j{0}; j < seed_size; ++j) {
-                    p = (i * seed_size) + j;
-                    block[p] = seed & 0xFF;
-                    seed >>= 8;
-                }
-            }
-            seed = rdseed();
-            for(size_t j{0}; j < nonce_size % seed_size; ++j) {
-                block[p + j +1] = seed & 0xFF;
-                seed >>= 8;
-            }
+            std::copy(bytes.begin(), bytes.end(), block.begin());
             return block;
         }
 
+    };
+
+    /**
+     * @brief the state behind nonce<COUNTER>, shared by every instantiation so that they cannot collide
+     * + 48 bit field: a 32 bit per-process random prefix above a 16 bit per-thread index, in separate bits so that
+     * one process's threads can never run into another process's prefix
+     * + 48 bit thread_local counter
+     * A thread's index is leased, not owned: when the thread exits its index goes back on a free list together with
+     * its counter, and the next new thread carries on counting from there. At most THREADS threads can use counter
+     * nonces at once, but any number over the life of the process.
+     * @note within a process nonces never repeat; across _P_ processes sharing a key two collide only if their random
+     * prefixes are equal, with probability at most P(P-1)/2 x 2^-32
+     */
+    struct nonce_counter {
+
+        constexpr static unsigned THREAD_BITS = 16;
+        constexpr static unsigned COUNTER_BITS = 48;
+        constexpr static uint64_t THREADS = uint64_t{1} << THREAD_BITS;
+        constexpr static uint64_t COUNTER_LIMIT = uint64_t{1} << COUNTER_BITS;
+
+        struct state_t {
+            uint64_t field;
+            uint64_t counter;
+        };
+
+        /**
+         * @brief the calling thread's state, leased a thread index on first use
+         * @throws doh::cipher_exception(EXHAUSTED) while THREADS other threads hold an index
+         */
+        static state_t& local() {
+            thread_local lease_t lease;
+            return lease.state;
+        }
+
+        static uint32_t prefix() {
+            static const uint32_t p = entropy_pool<>::local().get<uint32_t>();
+            return p;
+        }
+
     private:
 
-        seed_t rdseed() {
-#ifdef NDEBUG
-            seed_t n;
-            if(_rdseed64_step (&n)) {
-                return n;
+        /**
+         * @brief the indices never handed out yet, and those returned by exited threads with where they stopped
+         */
+        struct registry_t {
+            std::mutex lock;
+            uint64_t next{0};
+            std::vector<state_t> free;
+        };
+
+        /**
+         * @note never destroyed, a detached thread may exit after static destruction and return its lease
+         */
+        static registry_t& registry() {
+            static registry_t* r = new registry_t;
+            return *r;
+        }
+
+        struct lease_t {
+
+            lease_t(): state(acquire()) {}
+
+            lease_t(const lease_t&) = delete;
+            lease_t& operator=(const lease_t&) = delete;
+
+            ~lease_t() {
+                if(state.counter < COUNTER_LIMIT) { // an exhausted index is retired
+                    registry_t& r = registry();
+                    std::lock_guard<std::mutex> guard(r.lock);
+                    r.free.push_back(state);
+                }
             }
-            throw pug::doh::cipher_exception(pug::doh::DETERMINISTIC);
-#else
-            return 0x0123456789ABCDEF;
-#endif;
-        }return rd();
 
-    };
-    #endif
+            state_t state;
+
+        };
 
-#else
+        static state_t acquire() {
+            registry_t& r = registry();
+            std::lock_guard<std::mutex> guard(r.lock);
+            if(!r.free.empty()) { // resume the counter, restarting it would repeat the last holder's nonces
+                const state_t state = r.free.back();
+                r.free.pop_back();
+                return state;
+            }
+            if(r.next >= THREADS) {
+                throw doh::cipher_exception(doh::EXHAUSTED);
+            }
+            return state_t{(uint64_t{prefix()} << THREAD_BITS) | r.next++, 0};
+        }
+
+    };
 
     /**
-     * @warning Here be cryptographically insecure dragons!
-     * @tparam M
+     * @brief Generate deterministic counter nonces - the cheapest nonce that never repeats.
+     * Lays out (big endian) the 12 byte nonce as a 4 byte per-process random prefix, a 2 byte thread index then a 6
+     * byte thread_local counter, the low 4 bytes are left as the CTR block counter. No locks (beyond leasing the thread
+     * index once), no atomics, no entropy hardware per nonce.
+     * @note never repeats within the process, across processes sharing a key uniqueness rests on the random
+     * prefixes differing @see nonce_counter - rekey when that is not good enough, the prefix and thread indices are
+     * drawn afresh by each run so there is no counter worth persisting across a restart
+     * @throws doh::cipher_exception(EXHAUSTED) rather than ever wrapping a counter
      * @tparam nonce_size
      * @tparam T
      */
-    template<nonce_mode_t M = PRSEED32, size_t nonce_size = NONCE_SIZE, typename T = uint8_t>
-    struct nonce {
+    template<size_t nonce_size, typename T>
+    struct nonce<COUNTER, nonce_size, T> {
+
+        static_assert(nonce_size == NONCE_SIZE, "the counter layout is for the 12 byte nonce");
 
         using value_type = T;
         using block_t = std::array<T, crypto::BLOCK_SIZE>;
-        using seed_t = std::random_device::result_type;
 
         /**
-         * @brief *in*secure nonce generator
-         * @return a cryptographically useless nonce block
+         * @brief unique nonce generator
+         * @return the next nonce block for this thread
          */
         block_t operator()() {
-            block_t block{};
-            size_t p{0};
-            seed_t seed;
-            size_t seed_size = sizeof(seed);
-            for (size_t i{0}; i < nonce_size / seed_size; i ++) {
-                seed = rdseed();
-                for (size_t j{0}; j < seed_size; ++j) {
-                    p = (i * seed_size) + j;
-                    block[p] = seed & 0xFF;
-                    seed >>= 8;
-                }
+            auto& state = nonce_counter::local();
+            if(state.counter == nonce_counter::COUNTER_LIMIT) {
+                throw doh::cipher_exception(doh::EXHAUSTED);
             }
-            seed = rdseed();
-            for(size_t j{0}; j < nonce_size % seed_size; ++j) {
-                block[p + j + 1] = seed & 0xFF;
-                seed >>= 8;
+            const uint64_t c = state.counter++;
+            block_t block{};
+            for(size_t i{0}; i < 6; ++i) {
+                block[i] = static_cast<T>(state.field >> (40 - 8 * i));
+                block[6 + i] = static_cast<T>(c >> (40 - 8 * i));
             }
             return block;
         }
 
-
         /**
-         * @brief A deterministic random number generator (e.g. a pseudo-random engine) has entropy zero.
-         * @note This function is not fully implemented in some standard libraries.
-         * For example:
-         * + LLVM libc++ always returns zero even though the device _is_ non-deterministic.
-         * + Microsoft Visual C++ implementation always returns 32 guarantees that random_device
-         * is cryptographically secure and non-deterministic:
-         * @link https://msdn.microsoft.com/en-us/library/bb982250.aspx
-         * @return double -
+         * @brief move this thread's counter forward, setting the next _n_ nonces aside
+         * @note only meaningful within this process, under its prefix and this thread's index
+         * @param n
          */
-        inline double entropy() {
-            return rd.entropy();
-        }
-
-    private:
-
-        seed_t rdseed() {
-#ifdef NDEBUG
-            return rd();
-#else //return a debug constant for testing against
-            return 0x89ABCDEF;
-#endif
+        static void skip(uint64_t n) {
+            auto& state = nonce_counter::local();
+            if(n > nonce_counter::COUNTER_LIMIT - state.counter) {
+                throw doh::cipher_exception(doh::EXHAUSTED);
+            }
+            state.counter += n;
         }
 
-        std::random_device rd;
-
     };
-#endif
 
 }
 
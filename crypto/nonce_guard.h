@@ -0,0 +1,317 @@
+#ifndef AES_CPP17_NONCE_GUARD_H
+#define AES_CPP17_NONCE_GUARD_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+
+#include "block_cipher_factory.h"
+#include "cipher_exception.h"
+#include "entropy_pool.h"
+
+namespace crypto {
+
+    /**
+     * @brief SipHash-2-4 (Aumasson & Bernstein 2012), a keyed PRF over short messages fed as little endian 64 bit words
+     * ```
+     * crypto::siphash24 sip(key);
+     * sip.update(word);                    // every whole 8 bytes
+     * const uint64_t h = sip.final(tail, length); // the last 0 to 7 bytes and the message length in bytes
+     * ```
+     */
+    class siphash24 {
+
+    public:
+
+        using key_t = std::array<uint64_t, 2>;
+
+        explicit siphash24(const key_t& key):
+            v0_(key[0] ^ 0x736f6d6570736575ull),
+            v1_(key[1] ^ 0x646f72616e646f6dull),
+            v2_(key[0] ^ 0x6c7967656e657261ull),
+            v3_(key[1] ^ 0x7465646279746573ull)
+        {}
+
+        /**
+         * @brief absorb the next 8 bytes of the message
+         */
+        inline void update(uint64_t m) {
+            v3_ ^= m;
+            round();
+            round();
+            v0_ ^= m;
+        }
+
+        /**
+         * @param tail the final 0 to 7 bytes of the message as a little endian word
+         * @param length of the whole message in bytes
+         * @return uint64_t the hash
+         */
+        inline uint64_t final(uint64_t tail, size_t length) {
+            update(tail | uint64_t{length & 0xFFu} << 56u);
+            v2_ ^= 0xFF;
+            for(int r{0}; r < 4; ++r) {
+                round();
+            }
+            return v0_ ^ v1_ ^ v2_ ^ v3_;
+        }
+
+    private:
+
+        static inline uint64_t rotl(uint64_t x, unsigned b) {
+            return (x << b) | (x >> (64u - b));
+        }
+
+        /**
+         * @brief SipRound
+         */
+        inline void round() {
+            v0_ += v1_; v1_ = rotl(v1_, 13); v1_ ^= v0_; v0_ = rotl(v0_, 32);
+            v2_ += v3_; v3_ = rotl(v3_, 16); v3_ ^= v2_;
+            v0_ += v3_; v3_ = rotl(v3_, 21); v3_ ^= v0_;
+            v2_ += v1_; v1_ = rotl(v1_, 17); v1_ ^= v2_; v2_ = rotl(v2_, 32);
+        }
+
+        uint64_t v0_, v1_, v2_, v3_;
+
+    };
+
+    /**
+     * @brief Concurrent, lock-free probabilistic record of the (key id, nonce) pairs already used.
+     * A register-blocked Bloom filter: each pair hashes to one 64 bit word and sets K bits within it, so recording a
+     * pair and learning whether it was (probably) seen before is a single atomic fetch_or - exactly one of several
+     * threads racing with the same pair is told it is new.
+     * + no false negatives - a reused pair is always reported
+     * + false positives grow with the load: at 16 bits of filter per recorded pair about 1 in 250, at 32 bits about
+     * 1 in 2500
+     * + memory is fixed at construction, size it per key for the number of messages expected before rekeying
+     * The pair is hashed with SipHash-2-4, a keyed PRF, under a random 128 bit key - without the key, nonces cannot be
+     * chosen to collide with another key's (or another nonce under the same key) and so block its messages.
+     * @tparam K bits set per pair
+     */
+    template<size_t K = 6>
+    class nonce_guard {
+
+        static_assert(K > 0 && K <= 8, "K bit positions are drawn 6 bits at a time from the one 64 bit hash");
+
+    public:
+
+        constexpr static size_t DEFAULT_SIZE = 1 << 20;
+
+        /**
+         * @param bytes memory footprint - rounded down to a power of two 64 bit words
+         */
+        explicit nonce_guard(size_t bytes = DEFAULT_SIZE):
+            nonce_guard(bytes, entropy_pool<>::local().get<siphash24::key_t>()) {}
+
+        /**
+         * @brief a guard hashing under a chosen key e.g. reproducible tests
+         * @warning a key that is known lets nonces be chosen to collide, use the random key in production
+         * @param bytes memory footprint - rounded down to a power of two 64 bit words
+         * @param key SipHash key
+         */
+        nonce_guard(size_t bytes, const siphash24::key_t& key):
+            words_(round_down(std::max(bytes / sizeof(uint64_t), size_t{1}))),
+            filter_(new std::atomic<uint64_t>[words_]),
+            key_(key)
+        {
+            clear();
+        }
+
+        nonce_guard(const nonce_guard&) = delete;
+        nonce_guard& operator=(const nonce_guard&) = delete;
+
+        /**
+         * @brief record the pair
+         * @tparam ConstIterator
+         * @param key_id identifies the key the nonce is used with (0 if the guard is per key)
+         * @param first nonce
+         * @param last
+         * @return bool true if the pair was (probably) recorded before
+         */
+        template<typename ConstIterator>
+        bool insert(uint64_t key_id, ConstIterator first, ConstIterator last) {
+            const uint64_t h = hash(key_id, first, last);
+            const uint64_t mask = bits(h);
+            const uint64_t previous = filter_[index(h)].fetch_or(mask, std::memory_order_relaxed);
+            return (previous & mask) == mask;
+        }
+
+        /**
+         * @brief test for the pair without recording it
+         * @return bool true if the pair was (probably) recorded before
+         */
+        template<typename ConstIterator>
+        bool contains(uint64_t key_id, ConstIterator first, ConstIterator last) const {
+            const uint64_t h = hash(key_id, first, last);
+            const uint64_t mask = bits(h);
+            return (filter_[index(h)].load(std::memory_order_relaxed) & mask) == mask;
+        }
+
+        /**
+         * @brief forget everything e.g. after a rekey
+         * @note not to be called concurrently with insert()
+         */
+        void clear() {
+            for(size_t i{0}; i < words_; ++i) {
+                filter_[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * @return size_t memory footprint in bytes
+         */
+        inline size_t size() const {
+            return words_ * sizeof(uint64_t);
+        }
+
+    private:
+
+        /**
+         * @brief the low 6K hash bits choose the bits within the word, the rest the word
+         */
+        constexpr static size_t INDEX_SHIFT = 6 * K;
+
+        constexpr static size_t MAX_WORDS = size_t{1} << (64 - INDEX_SHIFT);
+
+        static size_t round_down(size_t n) {
+            size_t p{1};
+            while(p <= n / 2 && p < MAX_WORDS) {
+                p <<= 1;
+            }
+            return p;
+        }
+
+        /**
+         * @brief up to 8 bytes as a little endian word, read with fixed size loads - a memcpy of a variable length
+         * compiles to byte stores that the following 8 byte load cannot forward from, stalling every insert
+         */
+        static inline uint64_t load(const uint8_t* p, size_t n) {
+            uint64_t w{0};
+            if(n >= 8) {
+                std::memcpy(&w, p, 8);
+            } else if(n >= 4) { // two overlapping 4 byte loads
+                uint32_t lo, hi;
+                std::memcpy(&lo, p, 4);
+                std::memcpy(&hi, p + n - 4, 4);
+                w = lo | uint64_t{hi} << (8 * (n - 4));
+            } else {
+                for(size_t i{0}; i < n; ++i) {
+                    w |= uint64_t{p[i]} << (8 * i);
+                }
+            }
+            return w;
+        }
+
+        /**
+         * @brief SipHash-2-4 of the message key_id (8 bytes little endian) | nonce
+         * @note the nonce must be contiguous in memory
+         */
+        template<typename ConstIterator>
+        uint64_t hash(uint64_t key_id, ConstIterator first, ConstIterator last) const {
+            const auto n = static_cast<size_t>(std::distance(first, last));
+            const auto* p = reinterpret_cast<const uint8_t*>(&*first);
+            siphash24 sip(key_);
+            sip.update(key_id);
+            size_t i{0};
+            for(; n - i >= sizeof(uint64_t); i += sizeof(uint64_t)) {
+                sip.update(load(p + i, sizeof(uint64_t)));
+            }
+            return sip.final(load(p + i, n - i), sizeof(key_id) + n);
+        }
+
+        inline size_t index(uint64_t h) const {
+            return (h >> INDEX_SHIFT) & (words_ - 1);
+        }
+
+        static inline uint64_t bits(uint64_t h) {
+            uint64_t mask{0};
+            for(size_t i{0}; i < K; ++i) {
+                mask |= uint64_t{1} << ((h >> (6 * i)) & 63u);
+            }
+            return mask;
+        }
+
+        size_t words_;
+
+        std::unique_ptr<std::atomic<uint64_t>[]> filter_;
+
+        siphash24::key_t key_;
+
+    };
+
+    template<typename C, typename G = nonce_guard<>>
+    class guarded_cipher;
+
+    /**
+     * @brief block_cipher<CTR> that refuses to encrypt under a nonce it has (probably) already used
+     * Reusing a CTR nonce hands an attacker the xor of the two plain texts, the guard makes the mistake loud instead.
+     * Only the NONCE_SIZE high bytes of the nonce-counter block are recorded - the low bytes are the block counter.
+     * ```
+     * crypto::nonce_guard<> guard(1 << 20);
+     * crypto::guarded_cipher<crypto::block_cipher<crypto::CTR>> aes(cipher, guard, key_id);
+     * aes.encrypt(data.begin() + 16, data.end()); // throws doh::NONCE_REUSE
+     * ```
+     * @note a false positive costs a fresh nonce and a retry, never a security failure
+     * @tparam T
+     * @tparam U
+     * @tparam G
+     */
+    template<typename T, typename U, typename G>
+    class guarded_cipher<block_cipher<CTR, T, U>, G> {
+
+    public:
+
+        using cipher_t = block_cipher<CTR, T, U>;
+        using block_t = typename cipher_t::block_t;
+        using value_type = typename cipher_t::value_type;
+
+        /**
+         * @param cipher the keyed block cipher
+         * @param guard shared by every cipher under the same key, or by many keys distinguished by _key_id_
+         * @param key_id
+         */
+        guarded_cipher(cipher_t& cipher, G& guard, uint64_t key_id = 0):
+            cipher_(cipher), guard_(guard), key_id_(key_id) {}
+
+        /**
+         * @note predicated on the presence of a nonce prepended to the front
+         * @throws doh::cipher_exception(NONCE_REUSE) before touching the range if the nonce was used before
+         */
+        template<typename Iterator>
+        void encrypt(Iterator front, Iterator back) {
+            if(guard_.insert(key_id_, front - BLOCK_SIZE, front - BLOCK_SIZE + NONCE_SIZE)) {
+                throw doh::cipher_exception(doh::NONCE_REUSE);
+            }
+            cipher_.encrypt(front, back);
+        }
+
+        /**
+         * @brief decryption legitimately reuses the sender's nonce so is not guarded
+         */
+        template<typename Iterator>
+        void decrypt(Iterator front, Iterator back) {
+            cipher_.decrypt(front, back);
+        }
+
+        constexpr static cipher_mode_t mode() {
+            return CTR;
+        }
+
+    private:
+
+        cipher_t& cipher_;
+
+        G& guard_;
+
+        uint64_t key_id_;
+
+    };
+
+}
+
+#endif //AES_CPP17_NONCE_GUARD_H
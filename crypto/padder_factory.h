@@ -1,15 +1,218 @@
 #ifndef AES_CPP17_PADDER_FACTORY_H
 #define AES_CPP17_PADDER_FACTORY_H
 
+#include <algorithm>
+#include <array>
 #include <vector>
 #include <cstdint>
+#include <iterator>
 
 //#include <iostream>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#define AES_CPP17_SSE2
+#endif
+
 #include "cipher_exception.h"
+#include "entropy_pool.h"
 
 namespace crypto {
 
+    /**
+     * @brief Constant time padding checks.
+     * Returning early on the first bad byte tells a padding oracle attacker, through timing alone, how much of a
+     * forged CBC block was right. Instead the final block is checked as a whole - one SSE2 compare-and-mask for 8 and
+     * 16 byte blocks, a branch free byte loop otherwise - and the verdict is only acted upon at the end.
+     */
+    namespace padding {
+
+        enum fill_t {
+            REPEAT, // every padding byte is the pad length (PKCS#7, PKCS#5)
+            ZERO,   // padding bytes are zero save the final pad length (ANSI X9.23)
+            ANY     // padding bytes are random, only the final pad length is checked (ISO 10126)
+        };
+
+        /**
+         * @brief 0xFF if a <= b else 0x00, without a branch
+         */
+        inline uint32_t le_mask(uint32_t a, uint32_t b) {
+            return static_cast<uint32_t>(static_cast<int32_t>(a - b - 1) >> 31) & 0xFF;
+        }
+
+        /**
+         * @brief branch free check of the final block
+         * @return uint32_t zero if the padding is valid
+         */
+        template<fill_t F, size_t B>
+        uint32_t check_scalar(const uint8_t* block) {
+            const uint32_t n = block[B - 1];
+            uint32_t bad = le_mask(n, 0) | le_mask(B + 1, n); // n == 0 or n > B
+            for(size_t i{0}; i < B; ++i) {
+                const auto d = static_cast<uint32_t>(B - i); // distance from the end
+                uint32_t in_pad = le_mask(d, n);
+                uint32_t expected = n;
+                if constexpr (F == ZERO) {
+                    in_pad &= ~le_mask(d, 1);
+                    expected = 0;
+                }
+                if constexpr (F == ANY) {
+                    in_pad = 0;
+                }
+                bad |= (block[i] ^ expected) & in_pad;
+            }
+            return bad;
+        }
+
+#ifdef AES_CPP17_SSE2
+
+        /**
+         * @brief the same check with one 16 byte vector compare, the final block is in the low B lanes
+         */
+        template<fill_t F, size_t B>
+        uint32_t check_sse2(const uint8_t* block) {
+            static_assert(B == 8 || B == 16, "SSE2 check is for 8 or 16 byte blocks");
+            const uint8_t n = block[B - 1];
+            const __m128i v = B == 16 ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(block))
+                                      : _mm_loadl_epi64(reinterpret_cast<const __m128i*>(block));
+            // distance of each lane from the end of the block, unused lanes never fall in the padding
+            const __m128i d = B == 16 ? _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+                                      : _mm_setr_epi8(8, 7, 6, 5, 4, 3, 2, 1, 127, 127, 127, 127, 127, 127, 127, 127);
+            const __m128i nv = _mm_set1_epi8(static_cast<char>(n));
+            const __m128i clamped = _mm_min_epu8(nv, _mm_set1_epi8(B + 1)); // keeps the signed compare honest
+            __m128i out_pad = _mm_cmpgt_epi8(d, clamped);
+            __m128i expected = nv;
+            if constexpr (F == ZERO) {
+                out_pad = _mm_or_si128(out_pad, _mm_cmpeq_epi8(d, _mm_set1_epi8(1)));
+                expected = _mm_setzero_si128();
+            }
+            if constexpr (F == ANY) {
+                out_pad = _mm_set1_epi8(-1);
+            }
+            const __m128i ok = _mm_or_si128(_mm_cmpeq_epi8(v, expected), out_pad);
+            const auto bad_lanes = static_cast<uint32_t>(_mm_movemask_epi8(ok)) ^ 0xFFFFu;
+            return bad_lanes | le_mask(n, 0) | le_mask(B + 1, n);
+        }
+
+#endif
+
+        /**
+         * @brief constant time unpad shared by the padders
+         * @return size_t the number of padding bytes to be stripped
+         * @throws doh::cipher_exception(UNPADDING) _after_ the whole block has been checked
+         */
+        template<fill_t F, size_t B, typename ConstIterator>
+        size_t unpad(ConstIterator first, ConstIterator last) {
+            if(static_cast<size_t>(std::distance(first, last)) < B) {
+                throw doh::cipher_exception(doh::UNPADDING); // the length is public anyway
+            }
+            std::array<uint8_t, B> block;
+            auto it = last - B;
+            for(auto& b: block) {
+                b = static_cast<uint8_t>(*it++);
+            }
+#ifdef AES_CPP17_SSE2
+            uint32_t bad;
+            if constexpr (B == 8 || B == 16) {
+                bad = check_sse2<F, B>(block.data());
+            } else {
+                bad = check_scalar<F, B>(block.data());
+            }
+#else
+            const uint32_t bad = check_scalar<F, B>(block.data());
+#endif
+            if(bad) {
+                throw doh::cipher_exception(doh::UNPADDING);
+            }
+            return block[B - 1];
+        }
+
+
+        /**
+         * @brief branch free ISO/IEC 7816-4 check, the padding is the last non zero byte (0x80) onwards
+         * @return uint32_t zero if the padding is valid, _marker_ set to the position of the 0x80
+         */
+        template<size_t B>
+        uint32_t check_iso7816_scalar(const uint8_t* block, uint32_t& marker) {
+            uint32_t pos{0}, value{0};
+            for(size_t i{0}; i < B; ++i) {
+                const uint32_t non_zero = le_mask(1, block[i]) ? ~0u : 0u;
+                pos = (pos & ~non_zero) | (static_cast<uint32_t>(i) & non_zero);
+                value = (value & ~non_zero) | (block[i] & non_zero);
+            }
+            marker = pos;
+            return value ^ 0x80u;
+        }
+
+#ifdef AES_CPP17_SSE2
+
+        /**
+         * @brief index of the highest set bit of a non zero word - a single BSR/LZCNT whatever the value
+         */
+        inline uint32_t highest_bit(uint32_t x) {
+#if defined(_MSC_VER)
+            unsigned long i;
+            _BitScanReverse(&i, x);
+            return static_cast<uint32_t>(i);
+#else
+            return 31u - static_cast<uint32_t>(__builtin_clz(x));
+#endif
+        }
+
+        /**
+         * @brief the same check with one vector compare, the marker found with a bit scan of the non zero lanes
+         */
+        template<size_t B>
+        uint32_t check_iso7816_sse2(const uint8_t* block, uint32_t& marker) {
+            static_assert(B == 8 || B == 16, "SSE2 check is for 8 or 16 byte blocks");
+            const __m128i v = B == 16 ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(block))
+                                      : _mm_loadl_epi64(reinterpret_cast<const __m128i*>(block));
+            const uint32_t lanes = (1u << B) - 1;
+            const uint32_t non_zero = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())))
+                                      & lanes;
+            const uint32_t pos = highest_bit(non_zero | 1u);
+            marker = pos;
+            return (block[pos] ^ 0x80u) | le_mask(non_zero, 0);
+        }
+
+#endif
+
+        /**
+         * @brief constant time ISO/IEC 7816-4 unpad
+         * @return size_t the number of padding bytes to be stripped
+         */
+        template<size_t B, typename ConstIterator>
+        size_t unpad_iso7816(ConstIterator first, ConstIterator last) {
+            if(static_cast<size_t>(std::distance(first, last)) < B) {
+                throw doh::cipher_exception(doh::UNPADDING);
+            }
+            std::array<uint8_t, B> block;
+            auto it = last - B;
+            for(auto& b: block) {
+                b = static_cast<uint8_t>(*it++);
+            }
+            uint32_t marker;
+#ifdef AES_CPP17_SSE2
+            uint32_t bad;
+            if constexpr (B == 8 || B == 16) {
+                bad = check_iso7816_sse2<B>(block.data(), marker);
+            } else {
+                bad = check_iso7816_scalar<B>(block.data(), marker);
+            }
+#else
+            const uint32_t bad = check_iso7816_scalar<B>(block.data(), marker);
+#endif
+            if(bad) {
+                throw doh::cipher_exception(doh::UNPADDING);
+            }
+            return B - marker;
+        }
+
+    }
+
     /**
      * The difference between the PKCS#5 and PKCS#7 padding mechanisms is the block size:
      * + PKCS#5 padding is defined for 8-byte block sizes
@@ -19,7 +222,7 @@ namespace crypto {
      * @note PKCS#5 padding was only defined with (triple) DES operation in mind.
      */
     enum padder_mode_t {
-        PKCS7, PKCS5, ANSIX923 //ToDo: ISO10126
+        PKCS7, PKCS5, ANSIX923, ISO10126, ISO7816, ZEROS
     };
 
     /**
@@ -34,7 +237,7 @@ namespace crypto {
     template<padder_mode_t M = PKCS7, size_t BLOCK_SIZE = 16, typename T = uint8_t>
     struct padder {
 
-        //ToDo: static_assert BLOCK_SIZE multiple of 8 and less than 2040
+        static_assert(BLOCK_SIZE % 8 == 0 && BLOCK_SIZE < 256, "BLOCK_SIZE multiple of 8 and the pad length a byte");
 
         using value_type  = T;
 
@@ -53,9 +256,7 @@ namespace crypto {
         template<typename ConstIterator, typename Iterator>
         size_t pad(ConstIterator first, ConstIterator last, Iterator out) {
             size_t pv= pad_value(static_cast<size_t>(std::distance(first, last)));
-            for(auto i{pv}; i--;) {
-                *out++ = pv;
-            }
+            std::fill_n(out, pv, static_cast<T>(pv));
             return pv;
         }
 
@@ -71,6 +272,7 @@ namespace crypto {
         /**
          * @brief After decrypting, check that the last N bytes of the decrypted data all have value N with 1 < N ≤ B.
          * If so return number of bytes to strip, otherwise throw a decryption error.
+         * @note constant time, see padding::unpad
          * @tparam Iterator
          * @param first
          * @param last
@@ -78,19 +280,14 @@ namespace crypto {
          */
         template<typename ConstIterator>
         size_t unpad(ConstIterator first, ConstIterator last) {
-            for(auto i{*(last - 1)}; i;) {
-                if(*(last - i--) != *(last - 1)) {
-                    throw doh::cipher_exception(doh::UNPADDING);
-                }
-            }
-            return *(last - 1);
+            return padding::unpad<padding::REPEAT, BLOCK_SIZE>(first, last);
         }
 
         inline static padder_mode_t mode() {
             return M;
         }
 
-        inline static size_t block_size() {
+        constexpr static size_t block_size() {
             return BLOCK_SIZE;
         }
 
@@ -99,7 +296,7 @@ namespace crypto {
     template<size_t BLOCK_SIZE,typename T>
     struct padder<ANSIX923, BLOCK_SIZE, T> {
 
-        //ToDo: static_assert BLOCK_SIZE multiple of 8 and less than 2040
+        static_assert(BLOCK_SIZE % 8 == 0 && BLOCK_SIZE < 256, "BLOCK_SIZE multiple of 8 and the pad length a byte");
 
         using value_type  = T;
 
@@ -117,16 +314,15 @@ namespace crypto {
         template<typename ConstIterator, typename Iterator>
         size_t pad(ConstIterator first, ConstIterator last, Iterator out) {
             size_t tv= terminator(static_cast<size_t>(std::distance(first, last)));
-            for(auto i{tv - 1}; i--;) {
-                *out++ = 0x00;
-            }
-            *out = tv;
+            out = std::fill_n(out, tv - 1, T{0x00});
+            *out = static_cast<T>(tv);
             return tv;
         }
 
         /**
          * @brief After decrypting, check that the last N -1  bytes of the decrypted data all have value 0x00 with 1 < N ≤ B.
          * If so return number of bytes to strip, otherwise throw a decryption error.
+         * @note constant time, see padding::unpad
          * @tparam Iterator
          * @param first
          * @param last
@@ -134,20 +330,14 @@ namespace crypto {
          */
         template<typename ConstIterator>
         size_t unpad(ConstIterator first, ConstIterator last) {
-            int i{*(last - 1)};
-            for(int i{*(last - 1)}; i > 1; i--) {
-                if(*(last - i) != 0x00) {
-                    throw doh::cipher_exception(doh::UNPADDING);
-                }
-            }
-            return *(last - 1);
+            return padding::unpad<padding::ZERO, BLOCK_SIZE>(first, last);
         }
 
         inline static padder_mode_t mode() {
             return ANSIX923;
         }
 
-        inline static size_t block_size() {
+        constexpr static size_t block_size() {
             return BLOCK_SIZE;
         }
 
@@ -173,8 +363,6 @@ namespace crypto {
     template<typename T>
     struct padder<PKCS5, 8, T> {
 
-        //ToDo: static_assert BLOCK_SIZE multiple of 8 and less than 2040
-
         using value_type  = T;
 
         /**
@@ -192,9 +380,7 @@ namespace crypto {
         template<typename ConstIterator, typename Iterator>
         size_t pad(ConstIterator first, ConstIterator last, Iterator out) {
             size_t pv= pad_value(static_cast<size_t>(std::distance(first, last)));
-            for(auto i{pv}; i--;) {
-                *out++ = pv;
-            }
+            std::fill_n(out, pv, static_cast<T>(pv));
             return pv;
         }
 
@@ -210,6 +396,7 @@ namespace crypto {
         /**
          * @brief After decrypting, check that the last N bytes of the decrypted data all have value N with 1 < N ≤ B.
          * If so return number of bytes to strip, otherwise throw a decryption error.
+         * @note constant time, see padding::unpad
          * @tparam Iterator
          * @param first
          * @param last
@@ -217,24 +404,186 @@ namespace crypto {
          */
         template<typename ConstIterator>
         size_t unpad(ConstIterator first, ConstIterator last) {
-            for(auto i{*(last - 1)}; i;) {
-                if(*(last - i--) != *(last - 1)) {
-                    throw doh::cipher_exception(doh::UNPADDING);
-                }
-            }
-            return *(last - 1);
+            return padding::unpad<padding::REPEAT, 8>(first, last);
         }
 
         inline static padder_mode_t mode() {
             return PKCS5;
         }
 
-        inline static size_t block_size() {
+        constexpr static size_t block_size() {
             return 8;
         }
 
     };
 
+    /**
+     * ISO 10126 padding is between 1 and B bytes, random save the last which is the number of bytes added.
+     * @note the random bytes come from the per-thread entropy_pool - a memcpy rather than a trip to the HRNG per byte
+     * @note withdrawn in 2007 but still found in the wild
+     * @tparam BLOCK_SIZE
+     * @tparam T
+     */
+    template<size_t BLOCK_SIZE, typename T>
+    struct padder<ISO10126, BLOCK_SIZE, T> {
+
+        static_assert(BLOCK_SIZE % 8 == 0 && BLOCK_SIZE < 256, "BLOCK_SIZE multiple of 8 and the pad length a byte");
+
+        using value_type  = T;
+
+        /**
+         * @brief ISO 10126 padding scheme for writing pad values to an external container
+         * @tparam Iterator
+         * @param first
+         * @param last
+         * @param out - iterator to a destination container with _at least_ block length space
+         * @return size_t the number of padding bytes written
+         */
+        template<typename ConstIterator, typename Iterator>
+        size_t pad(ConstIterator first, ConstIterator last, Iterator out) {
+            const size_t pv = block_size() - static_cast<size_t>(std::distance(first, last)) % block_size();
+            std::array<uint8_t, BLOCK_SIZE> fill;
+            entropy_pool<>::local().fill(fill.data(), pv - 1);
+            fill[pv - 1] = static_cast<uint8_t>(pv);
+            std::copy(fill.begin(), fill.begin() + pv, out);
+            return pv;
+        }
+
+        /**
+         * @brief After decrypting, check only that the last byte N is 1 ≤ N ≤ B - the rest of the padding is random.
+         * @note constant time, see padding::unpad
+         * @tparam ConstIterator
+         * @param first
+         * @param last
+         * @return size_t the number of padding bytes to be stripped
+         */
+        template<typename ConstIterator>
+        size_t unpad(ConstIterator first, ConstIterator last) {
+            return padding::unpad<padding::ANY, BLOCK_SIZE>(first, last);
+        }
+
+        inline static padder_mode_t mode() {
+            return ISO10126;
+        }
+
+        constexpr static size_t block_size() {
+            return BLOCK_SIZE;
+        }
+
+    };
+
+    /**
+     * ISO/IEC 7816-4 padding (also ISO/IEC 9797-1 method 2) is a single 0x80 byte followed by as many 0x00 bytes
+     * as it takes to fill the block - between 1 and B bytes are always added.
+     * @note used by smart cards, the 0x80 being a 1 bit followed by 0 bits
+     * @tparam BLOCK_SIZE
+     * @tparam T
+     */
+    template<size_t BLOCK_SIZE, typename T>
+    struct padder<ISO7816, BLOCK_SIZE, T> {
+
+        static_assert(BLOCK_SIZE % 8 == 0 && BLOCK_SIZE < 256, "BLOCK_SIZE multiple of 8 and the pad length a byte");
+
+        using value_type  = T;
+
+        /**
+         * @brief ISO/IEC 7816-4 padding scheme for writing pad values to an external container
+         * @tparam Iterator
+         * @param first
+         * @param last
+         * @param out - iterator to a destination container with _at least_ block length space
+         * @return size_t the number of padding bytes written
+         */
+        template<typename ConstIterator, typename Iterator>
+        size_t pad(ConstIterator first, ConstIterator last, Iterator out) {
+            const size_t pv = block_size() - static_cast<size_t>(std::distance(first, last)) % block_size();
+            *out++ = static_cast<T>(0x80);
+            std::fill_n(out, pv - 1, T{0x00});
+            return pv;
+        }
+
+        /**
+         * @brief After decrypting, find the last non zero byte of the final block and check that it is 0x80.
+         * @note constant time, see padding::unpad_iso7816
+         * @tparam ConstIterator
+         * @param first
+         * @param last
+         * @return size_t the number of padding bytes to be stripped
+         */
+        template<typename ConstIterator>
+        size_t unpad(ConstIterator first, ConstIterator last) {
+            return padding::unpad_iso7816<BLOCK_SIZE>(first, last);
+        }
+
+        inline static padder_mode_t mode() {
+            return ISO7816;
+        }
+
+        constexpr static size_t block_size() {
+            return BLOCK_SIZE;
+        }
+
+    };
+
+    /**
+     * Zero padding (ISO/IEC 9797-1 method 1) fills the final block with 0x00 bytes, nothing is added to a message
+     * that is already block aligned.
+     * @warning ambiguous - trailing 0x00 bytes of the message itself are stripped along with the padding, only use it
+     * for data that can not end in 0x00 (e.g. C strings) or whose length is known some other way
+     * @tparam BLOCK_SIZE
+     * @tparam T
+     */
+    template<size_t BLOCK_SIZE, typename T>
+    struct padder<ZEROS, BLOCK_SIZE, T> {
+
+        static_assert(BLOCK_SIZE % 8 == 0 && BLOCK_SIZE < 256, "BLOCK_SIZE multiple of 8 and the pad length a byte");
+
+        using value_type  = T;
+
+        /**
+         * @brief zero padding scheme for writing pad values to an external container
+         * @tparam Iterator
+         * @param first
+         * @param last
+         * @param out - iterator to a destination container with _at least_ block length space
+         * @return size_t the number of padding bytes written, 0 if already block aligned
+         */
+        template<typename ConstIterator, typename Iterator>
+        size_t pad(ConstIterator first, ConstIterator last, Iterator out) {
+            const size_t rem = static_cast<size_t>(std::distance(first, last)) % block_size();
+            const size_t pv = rem ? block_size() - rem : 0;
+            std::fill_n(out, pv, T{0x00});
+            return pv;
+        }
+
+        /**
+         * @brief count the trailing 0x00 bytes of the final block, there is nothing to check
+         * @tparam ConstIterator
+         * @param first
+         * @param last
+         * @return size_t the number of padding bytes to be stripped
+         */
+        template<typename ConstIterator>
+        size_t unpad(ConstIterator first, ConstIterator last) {
+            const auto n = static_cast<size_t>(std::distance(first, last));
+            size_t zeros{0};
+            for(auto it = last - std::min(n, block_size()); it != last; ++it) { // branch free, a non zero byte resets
+                const size_t zero = size_t{0} - (padding::le_mask(static_cast<uint8_t>(*it), 0) & 1u);
+                zeros = (zeros + 1) & zero;
+            }
+            return zeros;
+        }
+
+        inline static padder_mode_t mode() {
+            return ZEROS;
+        }
+
+        constexpr static size_t block_size() {
+            return BLOCK_SIZE;
+        }
+
+    };
+
 
 }
 
@@ -0,0 +1,425 @@
+#ifndef AES_CPP17_STREAM_CONTAINER_H
+#define AES_CPP17_STREAM_CONTAINER_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "aes_encrypt.h"
+#include "aes_kernels.h"
+#include "cipher_exception.h"
+#include "cmac.h"
+
+namespace crypto {
+
+    /**
+     * @brief Chunked authenticated encryption container with a random access index (the STREAM construction).
+     * The payload is split into fixed size segments (64 KiB default), each encrypted with AES-CTR under its own
+     * derived nonce and authenticated with its own AES-CMAC tag (encrypt-then-MAC, independent encryption and MAC keys
+     * derived from the master key). Following Hoang, Reyhanitabar, Rogaway & Vizár (2015) "Online Authenticated-Encryption
+     * and its Nonce-Reuse Misuse-Resistance" the segment nonce is
+     *
+     *     prefix (7 bytes) | segment number (32 bit big endian) | last segment flag (1 byte)
+     *
+     * so segments cannot be reordered, dropped or the stream truncated without a tag failing. Every segment is
+     * independent, so sealing and opening run in parallel and segment _k_ decrypts without touching the others.
+     *
+     * On disk layout, integers big endian:
+     * ```
+     * header   32 bytes  "AESSTRM1" | version (1) | reserved (3) | segment size (4) | nonce prefix (7) | reserved (9)
+     * segment  n times   cipher text (segment size, the last may be shorter) | tag (16)
+     * index    n x 8     byte offset of each segment
+     * footer   32 bytes  plain text length (8) | segment count (4) | reserved (4) | index tag (16)
+     * ```
+     * @note a nonce prefix must never be reused with the same master key
+     * @tparam T block cipher encrypt functor (default AES-256)
+     */
+    template<typename T = aes::encrypt<>>
+    class stream_container {
+
+        using key_t = std::vector<typename T::value_type>;
+
+    public:
+
+        using value_type = typename T::value_type;
+        using block_t = typename T::block_t;
+        using prefix_t = std::array<value_type, 7>;
+
+        /**
+         * @brief ranged read of _n_ bytes at byte _offset_ of the container (a file, a mapping, an HTTP range...)
+         */
+        using reader_t = std::function<void(uint64_t offset, value_type* out, size_t n)>;
+
+        constexpr static size_t HEADER_SIZE = 32;
+        constexpr static size_t FOOTER_SIZE = 32;
+        constexpr static size_t TAG_SIZE = BLOCK_SIZE;
+        constexpr static size_t INDEX_ENTRY_SIZE = 8;
+        constexpr static size_t DEFAULT_SEGMENT_SIZE = 64 * 1024;
+        constexpr static uint8_t VERSION = 1;
+
+        /**
+         * @param kseq master key (the same length as the encrypt functor's key)
+         * @param segment_size plain text bytes per segment when sealing - rounded up to a multiple of the block size
+         * (< 4 GiB), when opening the segment size is read from the container header
+         */
+        template<class KeySequence>
+        explicit stream_container(KeySequence&& kseq, size_t segment_size = DEFAULT_SEGMENT_SIZE):
+            segment_size_(std::clamp<size_t>(((segment_size + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_SIZE,
+                                             BLOCK_SIZE, UINT32_MAX - BLOCK_SIZE + 1))
+        {
+            key_t master(std::begin(kseq), std::end(kseq));
+            T prf(master);
+            enc_key_ = derive(prf, 0x01, master.size());
+            mac_key_ = derive(prf, 0x02, master.size());
+            wipe(master);
+            secure_wipe(&prf, sizeof(prf));
+        }
+
+        stream_container(const stream_container&) = delete;
+        stream_container& operator=(const stream_container&) = delete;
+
+        ~stream_container() {
+            wipe(enc_key_);
+            wipe(mac_key_);
+        }
+
+        /**
+         * @brief encrypt and authenticate the plain text into a new container
+         * @param data
+         * @param n
+         * @param prefix unique per message nonce prefix
+         * @param threads worker threads (0 = hardware concurrency)
+         * @return std::vector<value_type> the container
+         */
+        std::vector<value_type> seal(const value_type* data, size_t n, const prefix_t& prefix, unsigned threads = 0) {
+            const uint64_t count = segment_count(n, segment_size_);
+            if(count > UINT32_MAX) { // the STREAM nonce has a 32 bit segment number
+                throw doh::cipher_exception(doh::MALFORMED);
+            }
+            std::vector<value_type> out(HEADER_SIZE + n + count * (TAG_SIZE + INDEX_ENTRY_SIZE) + FOOTER_SIZE);
+            write_header(out.data(), prefix);
+            parallel(count, threads, [&](uint64_t k, T& cipher, cmac<T>& mac) {
+                const size_t size = segment_size(k, n, segment_size_);
+                value_type* ct = out.data() + segment_offset(k, segment_size_);
+                std::copy(data + k * segment_size_, data + k * segment_size_ + size, ct);
+                const block_t nonce = segment_nonce(prefix, k, k + 1 == count);
+                ctr(cipher, nonce, ct, size);
+                const block_t tag = segment_tag(mac, nonce, ct, size);
+                std::copy(tag.begin(), tag.end(), ct + size);
+            });
+            value_type* index = out.data() + HEADER_SIZE + n + count * TAG_SIZE;
+            for(uint64_t k{0}; k < count; ++k) {
+                store(index + k * INDEX_ENTRY_SIZE, segment_offset(k, segment_size_), 8);
+            }
+            value_type* footer = index + count * INDEX_ENTRY_SIZE;
+            store(footer, n, 8);
+            store(footer + 8, count, 4);
+            cmac<T> mac(mac_key_);
+            const block_t tag = index_tag(mac, out.data(), index, count, footer);
+            std::copy(tag.begin(), tag.end(), footer + 16);
+            return out;
+        }
+
+        /**
+         * @brief the verified table of contents of a container
+         */
+        struct index_t {
+            prefix_t prefix;
+            uint64_t length;                // plain text bytes
+            uint64_t segment_size;
+            std::vector<uint64_t> offsets;  // byte offset of each segment
+
+            inline uint64_t segment_count() const {
+                return offsets.size();
+            }
+        };
+
+        /**
+         * @brief read the header, index & footer and check the index tag
+         * @throw doh::cipher_exception if the container is malformed or the index fails authentication
+         */
+        index_t read_index(const reader_t& read, uint64_t container_size) {
+            if(container_size < HEADER_SIZE + FOOTER_SIZE) {
+                throw doh::cipher_exception(doh::MALFORMED);
+            }
+            std::array<value_type, HEADER_SIZE> header{};
+            std::array<value_type, FOOTER_SIZE> footer{};
+            read(0, header.data(), HEADER_SIZE);
+            read(container_size - FOOTER_SIZE, footer.data(), FOOTER_SIZE);
+            index_t index{};
+            if(std::memcmp(header.data(), MAGIC, sizeof(MAGIC)) != 0 || header[8] != VERSION) {
+                throw doh::cipher_exception(doh::MALFORMED);
+            }
+            index.segment_size = load(header.data() + 12, 4);
+            std::copy(header.begin() + 16, header.begin() + 23, index.prefix.begin());
+            index.length = load(footer.data(), 8);
+            const uint64_t count = load(footer.data() + 8, 4);
+            if(index.segment_size == 0 || index.segment_size % BLOCK_SIZE || index.length > container_size
+               || count != segment_count(index.length, index.segment_size)
+               || container_size != HEADER_SIZE + index.length + count * (TAG_SIZE + INDEX_ENTRY_SIZE) + FOOTER_SIZE) {
+                throw doh::cipher_exception(doh::MALFORMED);
+            }
+            std::vector<value_type> entries(count * INDEX_ENTRY_SIZE);
+            read(container_size - FOOTER_SIZE - entries.size(), entries.data(), entries.size());
+            cmac<T> mac(mac_key_);
+            const block_t tag = index_tag(mac, header.data(), entries.data(), count, footer.data());
+            if(!equal(tag.data(), footer.data() + 16)) {
+                throw doh::cipher_exception(doh::AUTHENTICATION);
+            }
+            index.offsets.resize(count);
+            for(uint64_t k{0}; k < count; ++k) {
+                index.offsets[k] = load(entries.data() + k * INDEX_ENTRY_SIZE, 8);
+            }
+            return index;
+        }
+
+        /**
+         * @brief random access - verify and decrypt segment _k_ alone
+         * @param read
+         * @param index as returned by read_index
+         * @param k segment number
+         * @param out destination with room for at least segment_size bytes
+         * @return size_t plain text bytes written
+         * @throw doh::cipher_exception if the segment fails authentication
+         */
+        size_t open_segment(const reader_t& read, const index_t& index, uint64_t k, value_type* out) {
+            wiped_cipher_t c{kernel::make<T>(enc_key_)};
+            cmac<T> mac(mac_key_);
+            return open_segment(read, index, k, out, c.cipher, mac);
+        }
+
+        /**
+         * @brief verify and decrypt the whole container
+         * @param data the container
+         * @param n container size
+         * @param threads worker threads (0 = hardware concurrency)
+         * @return std::vector<value_type> the plain text
+         * @throw doh::cipher_exception if the container is malformed or any segment fails authentication
+         */
+        std::vector<value_type> open(const value_type* data, size_t n, unsigned threads = 0) {
+            reader_t read = [data](uint64_t offset, value_type* out, size_t size) {
+                std::memcpy(out, data + offset, size);
+            };
+            const index_t index = read_index(read, n);
+            std::vector<value_type> plain(index.length);
+            parallel(index.segment_count(), threads, [&](uint64_t k, T& cipher, cmac<T>& mac) {
+                open_segment(read, index, k, plain.data() + k * index.segment_size, cipher, mac);
+            });
+            return plain;
+        }
+
+        inline size_t segment_size() const {
+            return segment_size_;
+        }
+
+    private:
+
+        constexpr static char MAGIC[8] = {'A', 'E', 'S', 'S', 'T', 'R', 'M', '1'};
+
+        static_assert(std::is_trivially_copyable_v<T>, "the cipher is wiped as raw bytes");
+
+        /**
+         * @brief a cipher keyed with the encryption key, its schedule wiped on the way out whether or not a segment threw
+         */
+        struct wiped_cipher_t {
+
+            T cipher;
+
+            ~wiped_cipher_t() {
+                secure_wipe(&cipher, sizeof(T));
+            }
+
+        };
+
+        size_t open_segment(const reader_t& read, const index_t& index, uint64_t k, value_type* out,
+                            T& cipher, cmac<T>& mac) {
+            if(k >= index.segment_count()) {
+                throw doh::cipher_exception(doh::MALFORMED);
+            }
+            const size_t size = segment_size(k, index.length, index.segment_size);
+            std::vector<value_type> ct(size + TAG_SIZE);
+            read(index.offsets[k], ct.data(), ct.size());
+            const block_t nonce = segment_nonce(index.prefix, k, k + 1 == index.segment_count());
+            const block_t tag = segment_tag(mac, nonce, ct.data(), size);
+            if(!equal(tag.data(), ct.data() + size)) {
+                throw doh::cipher_exception(doh::AUTHENTICATION);
+            }
+            ctr(cipher, nonce, ct.data(), size);
+            std::copy(ct.begin(), ct.begin() + size, out);
+            return size;
+        }
+
+        /**
+         * @brief run fn(k, cipher, mac) for every segment k, segments are handed out dynamically to the workers
+         * each of which keys its own cipher & MAC
+         */
+        template<typename F>
+        void parallel(uint64_t count, unsigned threads, F&& fn) {
+            if(!threads) {
+                threads = std::max(std::thread::hardware_concurrency(), 1u);
+            }
+            threads = static_cast<unsigned>(std::min<uint64_t>(threads, count));
+            std::atomic<uint64_t> next{0};
+            std::vector<std::exception_ptr> errors(threads);
+            auto work = [&](unsigned w) {
+                try {
+                    wiped_cipher_t c{kernel::make<T>(enc_key_)};
+                    cmac<T> mac(mac_key_);
+                    for(uint64_t k; (k = next++) < count;) {
+                        fn(k, c.cipher, mac);
+                    }
+                } catch(...) {
+                    errors[w] = std::current_exception();
+                    next = count;
+                }
+            };
+            std::vector<std::thread> workers;
+            for(unsigned w{1}; w < threads; ++w) {
+                workers.emplace_back(work, w);
+            }
+            if(threads) {
+                work(0);
+            }
+            for(auto& w: workers) {
+                w.join();
+            }
+            for(auto& e: errors) {
+                if(e) std::rethrow_exception(e);
+            }
+        }
+
+        /**
+         * @brief an empty payload is still one (empty, final) segment
+         */
+        static inline uint64_t segment_count(uint64_t n, uint64_t seg) {
+            return n ? (n + seg - 1) / seg : 1;
+        }
+
+        static inline size_t segment_size(uint64_t k, uint64_t n, uint64_t seg) {
+            return static_cast<size_t>(std::min<uint64_t>(seg, n - k * seg));
+        }
+
+        static inline uint64_t segment_offset(uint64_t k, uint64_t seg) {
+            return HEADER_SIZE + k * (seg + TAG_SIZE);
+        }
+
+        /**
+         * @brief STREAM nonce prefix | k | last in the 12 high bytes, zero block counter in the low 4 bytes
+         */
+        static block_t segment_nonce(const prefix_t& prefix, uint64_t k, bool last) {
+            block_t nonce{};
+            std::copy(prefix.begin(), prefix.end(), nonce.begin());
+            store(nonce.data() + 7, k, 4);
+            nonce[11] = last ? 1 : 0;
+            return nonce;
+        }
+
+        static block_t segment_tag(cmac<T>& mac, const block_t& nonce, const value_type* ct, size_t n) {
+            mac.update(nonce.begin(), nonce.end());
+            mac.update(ct, ct + n);
+            return mac.final();
+        }
+
+        static block_t index_tag(cmac<T>& mac, const value_type* header, const value_type* index, uint64_t count,
+                                 const value_type* footer) {
+            mac.update(header, header + HEADER_SIZE);
+            mac.update(index, index + count * INDEX_ENTRY_SIZE);
+            mac.update(footer, footer + 16);
+            return mac.final();
+        }
+
+        /**
+         * @brief in place CTR over a segment, the partial final block simply uses part of the key stream
+         * @note an AES segment is handed whole to the active kernel @see aes_kernels.h
+         */
+        static void ctr(T& cipher, block_t counter, value_type* p, size_t n) {
+            if constexpr (kernel::dispatches_v<T, value_type*>) {
+                kernel::ctr(cipher, counter.data(), p, n);
+                return;
+            }
+            block_t ks;
+            for(size_t i{0}; i < n; i += BLOCK_SIZE) {
+                ks = counter;
+                cipher.block(ks.begin());
+                const size_t m = std::min(BLOCK_SIZE, n - i);
+                for(size_t j{0}; j < m; ++j) {
+                    p[i + j] ^= ks[j];
+                }
+                for(size_t j{BLOCK_SIZE}; j-- && !++counter[j];); // big endian increment
+            }
+        }
+
+        /**
+         * @brief derive a sub key of _size_ bytes as E(master, label | i) for i = 0, 1, ...
+         * @note the key stream blocks and the unused tail are wiped
+         */
+        static key_t derive(T& prf, value_type label, size_t size) {
+            key_t key;
+            key.reserve(size + BLOCK_SIZE); // never reallocated, so no unwiped copy is left on the heap
+            for(value_type i{0}; key.size() < size; ++i) {
+                block_t b{};
+                b[0] = label;
+                b[BLOCK_SIZE - 1] = i;
+                prf.block(b.begin());
+                key.insert(key.end(), b.begin(), b.end());
+                secure_wipe(b.data(), b.size());
+            }
+            secure_wipe(key.data() + size, key.size() - size);
+            key.resize(size);
+            return key;
+        }
+
+        void write_header(value_type* header, const prefix_t& prefix) const {
+            std::memcpy(header, MAGIC, sizeof(MAGIC));
+            header[8] = VERSION;
+            store(header + 12, segment_size_, 4);
+            std::copy(prefix.begin(), prefix.end(), header + 16);
+        }
+
+        /**
+         * @brief constant time tag comparison
+         */
+        static bool equal(const value_type* a, const value_type* b) {
+            value_type d{0};
+            for(size_t i{0}; i < TAG_SIZE; ++i) {
+                d |= a[i] ^ b[i];
+            }
+            return d == 0;
+        }
+
+        static void store(value_type* p, uint64_t v, size_t bytes) {
+            for(size_t i{bytes}; i--; v >>= 8u) {
+                p[i] = static_cast<value_type>(v & 0xFFu);
+            }
+        }
+
+        static uint64_t load(const value_type* p, size_t bytes) {
+            uint64_t v{0};
+            for(size_t i{0}; i < bytes; ++i) {
+                v = (v << 8u) | p[i];
+            }
+            return v;
+        }
+
+        static void wipe(key_t& key) {
+            secure_wipe(key.data(), key.size());
+        }
+
+        const size_t segment_size_;
+
+        key_t enc_key_;
+
+        key_t mac_key_;
+
+    };
+
+}
+
+#endif //AES_CPP17_STREAM_CONTAINER_H
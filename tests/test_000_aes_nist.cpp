@@ -2,11 +2,76 @@
 
 #include "../crypto/aes_encrypt.h"
 #include "../crypto/aes_decrypt.h"
+#include "../crypto/aes_kernels.h"
 #include "../util/phex.h"
 #include "../util/stopwatch.h"
 
 #include <iostream>
 
+using nist_block_t = std::array<uint8_t, crypto::BLOCK_SIZE>;
+
+template<typename C, typename Key>
+constexpr nist_block_t cipher_block(const Key& key, nist_block_t block) {
+    const C cipher(key);
+    cipher.block(block.begin());
+    return block;
+}
+
+constexpr bool equal(const nist_block_t& a, const nist_block_t& b) {
+    for(size_t i{0}; i < a.size(); ++i) {
+        if(a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+// NIST SP 800-38A F.1 ECB known answers, shared with the kernel self-test, checked by the compiler
+using crypto::kernel::NIST_PLAIN;
+using crypto::kernel::NIST_KEY_128;
+using crypto::kernel::NIST_CIPHER_128;
+using crypto::kernel::NIST_KEY_192;
+using crypto::kernel::NIST_CIPHER_192;
+using crypto::kernel::NIST_KEY_256;
+using crypto::kernel::NIST_CIPHER_256;
+
+using aes128_t = crypto::aes::encrypt<crypto::aes::R128, crypto::aes::N128>;
+using aes192_t = crypto::aes::encrypt<crypto::aes::R192, crypto::aes::N192>;
+using inv_aes128_t = crypto::aes::decrypt<crypto::aes::R128, crypto::aes::N128>;
+using inv_aes192_t = crypto::aes::decrypt<crypto::aes::R192, crypto::aes::N192>;
+
+static_assert(equal(cipher_block<aes128_t>(NIST_KEY_128, NIST_PLAIN), NIST_CIPHER_128), "AES-128 encrypt");
+static_assert(equal(cipher_block<aes192_t>(NIST_KEY_192, NIST_PLAIN), NIST_CIPHER_192), "AES-192 encrypt");
+static_assert(equal(cipher_block<crypto::aes::encrypt<>>(NIST_KEY_256, NIST_PLAIN), NIST_CIPHER_256), "AES-256 encrypt");
+static_assert(equal(cipher_block<inv_aes128_t>(NIST_KEY_128, NIST_CIPHER_128), NIST_PLAIN), "AES-128 decrypt");
+static_assert(equal(cipher_block<inv_aes192_t>(NIST_KEY_192, NIST_CIPHER_192), NIST_PLAIN), "AES-192 decrypt");
+static_assert(equal(cipher_block<crypto::aes::decrypt<>>(NIST_KEY_256, NIST_CIPHER_256), NIST_PLAIN), "AES-256 decrypt");
+
+// FIPS-197 appendix A: the last round key of each expansion, w[4R-4..4R-1], so the whole schedule was expanded
+// within bounds - an out of bounds write or read is not a constant expression and fails to compile
+template<crypto::aes::ROUNDS R, crypto::aes::KEY_LENGTH N, typename Key>
+constexpr nist_block_t last_round_key(const Key& key) {
+    const crypto::aes::encrypt<R, N> cipher(key);
+    nist_block_t round_key{};
+    const auto* last = cipher.round_keys() + (R - 1) * crypto::BLOCK_SIZE;
+    for(size_t i{0}; i < round_key.size(); ++i) {
+        round_key[i] = last[i];
+    }
+    return round_key;
+}
+
+constexpr nist_block_t FIPS_LAST_ROUND_KEY_128 = {0xd0, 0x14, 0xf9, 0xa8, 0xc9, 0xee, 0x25, 0x89, 0xe1, 0x3f, 0x0c,
+                                                  0xc8, 0xb6, 0x63, 0x0c, 0xa6};
+constexpr nist_block_t FIPS_LAST_ROUND_KEY_192 = {0xe9, 0x8b, 0xa0, 0x6f, 0x44, 0x8c, 0x77, 0x3c, 0x8e, 0xcc, 0x72,
+                                                  0x04, 0x01, 0x00, 0x22, 0x02};
+constexpr nist_block_t FIPS_LAST_ROUND_KEY_256 = {0xfe, 0x48, 0x90, 0xd1, 0xe6, 0x18, 0x8d, 0x0b, 0x04, 0x6d, 0xf3,
+                                                  0x44, 0x70, 0x6c, 0x63, 0x1e};
+
+static_assert(equal(last_round_key<crypto::aes::R128, crypto::aes::N128>(NIST_KEY_128), FIPS_LAST_ROUND_KEY_128),
+              "AES-128 schedule");
+static_assert(equal(last_round_key<crypto::aes::R192, crypto::aes::N192>(NIST_KEY_192), FIPS_LAST_ROUND_KEY_192),
+              "AES-192 schedule");
+static_assert(equal(last_round_key<crypto::aes::R256, crypto::aes::N256>(NIST_KEY_256), FIPS_LAST_ROUND_KEY_256),
+              "AES-256 schedule");
+
 TEST_CASE("AES encrypt NIST tests", "[.aes_encrypt]") {
 
 #ifdef NDEBUG
@@ -69,11 +134,36 @@ TEST_CASE("AES encrypt NIST tests", "[.aes_encrypt]") {
     }
 
     SECTION("AES192 encrypt-decrypt NIST check") {
-        //Broken :(
+        aes192_t encrypt(NIST_KEY_192);
+        inv_aes192_t decrypt(NIST_KEY_192);
+        block_t test = plain;
+        encrypt.block(test.begin());
+        REQUIRE(test == NIST_CIPHER_192);
+        decrypt.block(test.begin());
+        REQUIRE(test == plain);
     }
 
     SECTION("AES128 encrypt-decrypt NIST check") {
-        //Broken :(
+        aes128_t encrypt(NIST_KEY_128);
+        inv_aes128_t decrypt(NIST_KEY_128);
+        block_t test = plain;
+        encrypt.block(test.begin());
+        REQUIRE(test == NIST_CIPHER_128);
+        decrypt.block(test.begin());
+        REQUIRE(test == plain);
+    }
+
+    SECTION("Each key size should expand to its FIPS-197 schedule at run time") {
+        REQUIRE(last_round_key<crypto::aes::R128, crypto::aes::N128>(NIST_KEY_128) == FIPS_LAST_ROUND_KEY_128);
+        REQUIRE(last_round_key<crypto::aes::R192, crypto::aes::N192>(NIST_KEY_192) == FIPS_LAST_ROUND_KEY_192);
+        REQUIRE(last_round_key<crypto::aes::R256, crypto::aes::N256>(NIST_KEY_256) == FIPS_LAST_ROUND_KEY_256);
+    }
+
+    SECTION("A constant key should be expanded at compile time") {
+        constexpr crypto::aes::encrypt<> encrypt(NIST_KEY_256);
+        block_t test = plain;
+        encrypt.block(test.begin());
+        REQUIRE(test == NIST_CIPHER_256);
     }
 
 }
\ No newline at end of file
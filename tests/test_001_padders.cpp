@@ -1,5 +1,7 @@
 #include "catch2.h"
 
+#include <algorithm>
+#include <array>
 #include <vector>
 
 #include "../crypto/padder_factory.h"
@@ -134,4 +136,153 @@ TEST_CASE("Padder Factory", "[.padder_factory]") {
 
     }
 
-}
\ No newline at end of file
+    SECTION("Malformed padding lengths should be rejected") {
+        std::vector<uint8_t> block(32, 0x00);
+        crypto::padder<> pkcs7;
+        crypto::padder<crypto::ANSIX923> ansi;
+        crypto::padder<crypto::PKCS5, 8> pkcs5;
+        for(int n: {0x00, 0x11, 0x20, 0x80, 0xff}) {
+            block.back() = static_cast<uint8_t>(n);
+            CHECK_THROWS_AS(pkcs7.unpad(block.begin(), block.end()), doh::cipher_exception);
+            CHECK_THROWS_AS(ansi.unpad(block.begin(), block.end()), doh::cipher_exception);
+            CHECK_THROWS_AS(pkcs5.unpad(block.begin(), block.end()), doh::cipher_exception);
+        }
+        block.assign(8, 0x08);
+        REQUIRE(pkcs5.unpad(block.begin(), block.end()) == 8);
+        CHECK_THROWS_AS(pkcs7.unpad(block.begin(), block.end()), doh::cipher_exception); // shorter than a block
+    }
+
+    SECTION("SIMD and scalar padding checks should agree") {
+        using namespace crypto::padding;
+        // every final byte, both fills, each padding byte in turn corrupted
+        auto make = [](size_t size, int n, uint8_t fill, int tamper) {
+            std::array<uint8_t, 16> block{};
+            std::fill(block.begin(), block.begin() + size, fill);
+            block[size - 1] = static_cast<uint8_t>(n);
+            if(tamper >= 0 && static_cast<size_t>(tamper) < size - 1) block[tamper] ^= 0x01;
+            return block;
+        };
+        size_t mismatches{0}, valid{0};
+        for(int n{0}; n < 256; ++n) {
+            for(int tamper{-1}; tamper < 16; ++tamper) {
+                for(auto fill: {uint8_t(0), static_cast<uint8_t>(n)}) {
+                    auto b16 = make(16, n, fill, tamper);
+                    auto b8 = make(8, n, fill, tamper);
+                    const bool r16 = check_scalar<REPEAT, 16>(b16.data()) == 0;
+                    const bool z16 = check_scalar<ZERO, 16>(b16.data()) == 0;
+                    const bool r8 = check_scalar<REPEAT, 8>(b8.data()) == 0;
+                    const bool z8 = check_scalar<ZERO, 8>(b8.data()) == 0;
+                    valid += r16 + z16 + r8 + z8;
+#ifdef AES_CPP17_SSE2
+                    mismatches += (check_sse2<REPEAT, 16>(b16.data()) == 0) != r16;
+                    mismatches += (check_sse2<ZERO, 16>(b16.data()) == 0) != z16;
+                    mismatches += (check_sse2<REPEAT, 8>(b8.data()) == 0) != r8;
+                    mismatches += (check_sse2<ZERO, 8>(b8.data()) == 0) != z8;
+#endif
+                }
+            }
+        }
+        REQUIRE(valid > 0);
+        REQUIRE(mismatches == 0);
+    }
+
+    SECTION("ISO 10126") {
+        crypto::padder<crypto::ISO10126> iso;
+        REQUIRE(iso.mode() == crypto::ISO10126);
+        for(size_t n{0}; n <= 2 * iso.block_size(); ++n) {
+            std::vector<uint8_t> plain(n, 0xAA);
+            std::vector<uint8_t> padded(plain);
+            padded.resize(n + iso.block_size());
+            const size_t k = iso.pad(plain.begin(), plain.end(), padded.begin() + n);
+            padded.resize(n + k);
+            REQUIRE(padded.size() % iso.block_size() == 0);
+            REQUIRE(padded.back() == k);
+            REQUIRE(iso.unpad(padded.begin(), padded.end()) == k);
+        }
+        std::vector<uint8_t> block(16, 0x00);
+        for(int n: {0x00, 0x11, 0xff}) {
+            block.back() = static_cast<uint8_t>(n);
+            CHECK_THROWS_AS(iso.unpad(block.begin(), block.end()), doh::cipher_exception);
+        }
+    }
+
+    SECTION("ISO/IEC 7816-4") {
+        crypto::padder<crypto::ISO7816> iso;
+        REQUIRE(iso.mode() == crypto::ISO7816);
+        std::vector<uint8_t> plain{0x01, 0x02, 0x03};
+        std::vector<uint8_t> expected{0x01, 0x02, 0x03, 0x80, 0x00, 0x00, 0x00, 0x00,
+                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+        std::vector<uint8_t> padded(plain);
+        padded.resize(16);
+        REQUIRE(iso.pad(plain.begin(), plain.end(), padded.begin() + 3) == 13);
+        REQUIRE(padded == expected);
+        REQUIRE(iso.unpad(padded.begin(), padded.end()) == 13);
+        padded.assign(16, 0x00);
+        padded.back() = 0x80;
+        REQUIRE(iso.unpad(padded.begin(), padded.end()) == 1);
+        padded.assign(16, 0x00);
+        padded.front() = 0x80;
+        REQUIRE(iso.unpad(padded.begin(), padded.end()) == 16);
+        padded.assign(16, 0x00); // no marker
+        CHECK_THROWS_AS(iso.unpad(padded.begin(), padded.end()), doh::cipher_exception);
+        padded[10] = 0x81; // wrong marker
+        CHECK_THROWS_AS(iso.unpad(padded.begin(), padded.end()), doh::cipher_exception);
+        padded[10] = 0x80;
+        padded[12] = 0x01; // non zero after the marker
+        CHECK_THROWS_AS(iso.unpad(padded.begin(), padded.end()), doh::cipher_exception);
+    }
+
+    SECTION("Zero padding") {
+        crypto::padder<crypto::ZEROS> zeros;
+        REQUIRE(zeros.mode() == crypto::ZEROS);
+        std::vector<uint8_t> plain(16, 0xAA), padded(32, 0xFF);
+        REQUIRE(zeros.pad(plain.begin(), plain.end(), padded.begin()) == 0); // aligned, nothing added
+        REQUIRE(padded.front() == 0xFF);
+        plain.resize(21, 0xAA);
+        REQUIRE(zeros.pad(plain.begin(), plain.end(), padded.begin()) == 11);
+        REQUIRE(std::all_of(padded.begin(), padded.begin() + 11, [](uint8_t b) { return b == 0; }));
+        plain.resize(32, 0x00);
+        REQUIRE(zeros.unpad(plain.begin(), plain.end()) == 11);
+        plain.assign(16, 0x00); // only the final block is considered
+        plain.resize(32, 0x00);
+        REQUIRE(zeros.unpad(plain.begin(), plain.end()) == 16);
+        plain.clear();
+        REQUIRE(zeros.unpad(plain.begin(), plain.end()) == 0);
+    }
+
+    SECTION("SIMD and scalar ISO/IEC 7816-4 checks should agree") {
+        using namespace crypto::padding;
+        size_t mismatches{0}, valid{0};
+        for(size_t marker{0}; marker < 16; ++marker) {
+            for(int tamper{-1}; tamper < 16; ++tamper) {
+                for(uint8_t m: {uint8_t(0x80), uint8_t(0x81), uint8_t(0x00)}) {
+                    std::array<uint8_t, 16> b16{}, b8{};
+                    b16.fill(0x5A);
+                    b8.fill(0x5A);
+                    std::fill(b16.begin() + marker, b16.end(), 0x00);
+                    std::fill(b8.begin() + marker % 8, b8.begin() + 8, 0x00);
+                    b16[marker] = m;
+                    b8[marker % 8] = m;
+                    if(tamper >= 0) {
+                        b16[tamper] ^= 0x01;
+                        b8[tamper % 8] ^= 0x01;
+                    }
+                    uint32_t p16, p8;
+                    const uint32_t s16 = check_iso7816_scalar<16>(b16.data(), p16);
+                    const uint32_t s8 = check_iso7816_scalar<8>(b8.data(), p8);
+                    valid += (s16 == 0) + (s8 == 0);
+#ifdef AES_CPP17_SSE2
+                    uint32_t q16, q8;
+                    mismatches += (check_iso7816_sse2<16>(b16.data(), q16) == 0) != (s16 == 0);
+                    mismatches += (check_iso7816_sse2<8>(b8.data(), q8) == 0) != (s8 == 0);
+                    mismatches += s16 == 0 && q16 != p16;
+                    mismatches += s8 == 0 && q8 != p8;
+#endif
+                }
+            }
+        }
+        REQUIRE(valid > 0);
+        REQUIRE(mismatches == 0);
+    }
+
+}
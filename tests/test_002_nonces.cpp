@@ -1,5 +1,10 @@
 #include "catch2.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <set>
+#include <thread>
 #include <vector>
 
 #include "../crypto/nonce_factory.h"
@@ -8,12 +13,8 @@
 TEST_CASE("Nonce Factory", "[.nonce_factory]") {
 #ifndef NDEBUG
 
-    #ifndef __RDSEED__
-
-    SECTION("No HRNG :( PRSEED 32 nonce generate 12 byte nonce") {
-
-        REQUIRE(crypto::can_rdseed() == false);
-        crypto::nonce<> n;
+    SECTION("PRSEED 32 nonce generate 12 byte nonce") {
+        crypto::nonce<crypto::PRSEED32> n;
         auto nonce_block = n();
         util::phex(nonce_block);
         std::vector<crypto::nonce<>::value_type> expect{0xef, 0xcd, 0xab, 0x89, 0xef, 0xcd, 0xab, 0x89, 0xef, 0xcd,
@@ -23,46 +24,57 @@ TEST_CASE("Nonce Factory", "[.nonce_factory]") {
         }
     }
 
-    #else
-    SECTION("Yes HRNG :) CSSEED 32 bit generate 12 byte nonce") {
-        REQUIRE(crypto::can_rdseed() == true);
-        crypto::nonce<> n;
-        auto nonce_block = n();
-        util::phex(nonce_block);
-        std::vector<crypto::nonce<>::value_type> expect{0xef, 0xcd, 0xab, 0x89, 0xef, 0xcd, 0xab, 0x89, 0xef, 0xcd,
-                                                        0xab, 0x89, 0x00, 0x00, 0x00, 0x00};
-        for (size_t i{0}; i < 16u; ++i) {
-            REQUIRE(nonce_block[i] == expect[i]);
+    if(crypto::can_rdseed()) {
+
+        SECTION("Yes HRNG :) CSSEED 32 bit generate 12 byte nonce") {
+            crypto::nonce<crypto::CSSEED32> n;
+            auto nonce_block = n();
+            util::phex(nonce_block);
+            std::vector<crypto::nonce<>::value_type> expect{0xef, 0xcd, 0xab, 0x89, 0xef, 0xcd, 0xab, 0x89, 0xef, 0xcd,
+                                                            0xab, 0x89, 0x00, 0x00, 0x00, 0x00};
+            for (size_t i{0}; i < 16u; ++i) {
+                REQUIRE(nonce_block[i] == expect[i]);
+            }
         }
-    }
 
-    SECTION ("Yes HRNG :) CSSEED 16 bit generate 12 byte nonce") {
-        REQUIRE(crypto::can_rdseed() == true);
-        crypto::nonce<> n;
-        auto nonce_block = n();
-        util::phex(nonce_block);
-        //ToDo: correct this down to 16 bits
-        std::vector<crypto::nonce<>::value_type> expect{0xef, 0xcd, 0xab, 0x89, 0xef, 0xcd, 0xab, 0x89, 0xef, 0xcd,
-                                                        0xab, 0x89, 0x00, 0x00, 0x00, 0x00};
-        for (size_t i{0}; i < 16u; ++i) {
-            REQUIRE(nonce_block[i] == expect[i]);
+        SECTION ("Yes HRNG :) CSSEED 16 bit generate 12 byte nonce") {
+            crypto::nonce<crypto::CSSEED16> n;
+            auto nonce_block = n();
+            util::phex(nonce_block);
+            std::vector<crypto::nonce<>::value_type> expect{0xef, 0xcd, 0xef, 0xcd, 0xef, 0xcd, 0xef, 0xcd, 0xef, 0xcd,
+                                                            0xef, 0xcd, 0x00, 0x00, 0x00, 0x00};
+            for (size_t i{0}; i < 16u; ++i) {
+                REQUIRE(nonce_block[i] == expect[i]);
+            }
         }
-    }
 
-    #endif
+    } else {
+
+        SECTION("No HRNG :( CSSEED should refuse to construct") {
+            REQUIRE_THROWS_AS(crypto::nonce<crypto::CSSEED32>(), doh::cipher_exception);
+        }
+
+    }
 
 #else
 
     SECTION("NDEBUG mode just print nonce values") {
 
-        SECTION("Yes HRNG :) CSSEED 32 bit generate 12 byte nonce") {
-            REQUIRE(crypto::can_rdseed() == true);
-            crypto::nonce<> n;
-            util::phex(n());
+        if(crypto::can_rdseed()) {
+
+            SECTION("Yes HRNG :) CSSEED 32 bit generate 12 byte nonce") {
+                crypto::nonce<crypto::CSSEED32> n;
+                util::phex(n());
+            }
+
+            SECTION ("Yes HRNG :) CSSEED 16 bit generate 12 byte nonce") {
+                crypto::nonce<crypto::CSSEED16> n;
+                util::phex(n());
+            }
+
         }
 
-        SECTION ("Yes HRNG :) CSSEED 16 bit generate 12 byte nonce") {
-            REQUIRE(crypto::can_rdseed() == true);
+        SECTION("Default CSPOOL generate 12 byte nonce") {
             crypto::nonce<> n;
             util::phex(n());
         }
@@ -70,4 +82,97 @@ TEST_CASE("Nonce Factory", "[.nonce_factory]") {
     }
 
 #endif
+
+    SECTION("CSPOOL nonces should be drawn from the per-thread entropy pool without repeats") {
+        using pool_nonce = crypto::nonce<crypto::CSPOOL>;
+        std::set<pool_nonce::block_t> seen;
+        pool_nonce n;
+        for(size_t i{0}; i < 10000; ++i) { // several pool refills
+            seen.insert(n());
+        }
+        REQUIRE(seen.size() == 10000);
+        REQUIRE(std::all_of(seen.begin(), seen.end(), [](const auto& block) {
+            return std::all_of(block.begin() + crypto::NONCE_SIZE, block.end(), [](auto b) { return b == 0; });
+        }));
+
+        std::vector<pool_nonce::block_t> other(1000);
+        std::thread t([&other] {
+            pool_nonce n;
+            for(auto& block: other) {
+                block = n();
+            }
+        });
+        t.join();
+        seen.insert(other.begin(), other.end());
+        REQUIRE(seen.size() == 11000);
+    }
+
+    SECTION("Entropy pool should fill across refills") {
+        std::vector<uint8_t> a(3 * crypto::entropy_pool<>::size() + 5), b(a.size());
+        crypto::entropy_pool<>::local().fill(a.data(), a.size());
+        crypto::entropy_pool<>::local().fill(b.data(), b.size());
+        REQUIRE(a != b);
+        REQUIRE(std::count(a.begin(), a.end(), 0) < static_cast<long>(a.size() / 64));
+    }
+
+    SECTION("COUNTER nonces should count per thread under distinct thread fields") {
+        using counter_nonce = crypto::nonce<crypto::COUNTER>;
+        counter_nonce n;
+        auto first = n();
+        auto second = n();
+        util::phex(first);
+        util::phex(second);
+        REQUIRE(std::equal(first.begin(), first.begin() + 6, second.begin())); // same prefix and thread index
+        REQUIRE(second[11] == static_cast<uint8_t>(first[11] + 1));
+        REQUIRE(std::all_of(second.begin() + crypto::NONCE_SIZE, second.end(), [](auto b) { return b == 0; }));
+
+        counter_nonce::block_t other;
+        std::thread t([&other] { other = counter_nonce()(); });
+        t.join();
+        REQUIRE(std::equal(first.begin(), first.begin() + 4, other.begin())); // one prefix per process
+        REQUIRE(!std::equal(first.begin() + 4, first.begin() + 6, other.begin() + 4)); // in its own bits
+
+        bool exhausted{false};
+        std::thread exhaust([&exhausted] { // Catch assertions are not thread safe so just record the outcome
+            counter_nonce n;
+            // the thread may have taken over an exited thread's index, so skip from wherever its counter resumes
+            counter_nonce::skip(crypto::nonce_counter::COUNTER_LIMIT - 1 - crypto::nonce_counter::local().counter);
+            n();
+            try {
+                n();
+            } catch(const doh::cipher_exception&) {
+                exhausted = true;
+            }
+        });
+        exhaust.join();
+        REQUIRE(exhausted);
+    }
+
+    SECTION("COUNTER nonces should outlast more threads than there are thread indices") {
+        using counter_nonce = crypto::nonce<crypto::COUNTER>;
+        constexpr size_t BATCH = 8;
+        const size_t threads = crypto::nonce_counter::THREADS + 1000;
+        std::vector<std::array<uint8_t, crypto::NONCE_SIZE>> nonces(threads);
+        std::atomic<size_t> failures{0};
+        for(size_t i{0}; i < threads; i += BATCH) { // short lived, a few at once, as a thread per connection would be
+            std::vector<std::thread> batch;
+            for(size_t j{i}; j < std::min(threads, i + BATCH); ++j) {
+                batch.emplace_back([&nonces, &failures, j] {
+                    try {
+                        const auto block = counter_nonce()();
+                        std::copy(block.begin(), block.begin() + crypto::NONCE_SIZE, nonces[j].begin());
+                    } catch(const doh::cipher_exception&) {
+                        ++failures;
+                    }
+                });
+            }
+            for(auto& t: batch) {
+                t.join();
+            }
+        }
+        REQUIRE(failures == 0);
+        // a recycled thread index carries on from its last holder's counter, so no nonce repeats
+        std::sort(nonces.begin(), nonces.end());
+        REQUIRE(std::adjacent_find(nonces.begin(), nonces.end()) == nonces.end());
+    }
 }
\ No newline at end of file
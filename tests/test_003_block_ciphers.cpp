@@ -1,6 +1,8 @@
 #include "catch2.h"
 
+#include <algorithm>
 #include <array>
+#include <type_traits>
 #include <vector>
 
 #ifdef NDEBUG
@@ -13,6 +15,48 @@
 
 static const size_t SAMPLES = 1'000;
 
+namespace {
+
+    /**
+     * @brief a stand-in third party cipher pair (XOR with the key) whose constructors forward any key sequence, as
+     * pluggable ciphers usually do - neither opts in to derives_from_encrypt
+     */
+    template<typename Tag>
+    struct xor_cipher {
+
+        using value_type = uint8_t;
+        using block_t = std::array<uint8_t, crypto::BLOCK_SIZE>;
+
+        template<class Sequence, typename = crypto::enable_if_key_t<Sequence, xor_cipher>>
+        explicit xor_cipher(const Sequence& seq) {
+            rekey(seq);
+        }
+
+        template<class Sequence>
+        void rekey(const Sequence& seq) {
+            std::copy_n(std::begin(seq), key.size(), key.begin()); // would not compile if handed the encrypt cipher
+        }
+
+        template<typename Iterator>
+        void block(Iterator it) const {
+            for(size_t i{0}; i < key.size(); ++i) {
+                *(it + i) ^= key[i];
+            }
+        }
+
+        constexpr static size_t block_size() {
+            return crypto::BLOCK_SIZE;
+        }
+
+        block_t key{};
+
+    };
+
+    struct xor_encrypt_tag {};
+    struct xor_decrypt_tag {};
+
+}
+
 TEST_CASE("AES block cipher modes", "[.block_cipher_factory]") {
 
     using aes_t = crypto::block_cipher<>;
@@ -245,4 +289,181 @@ TEST_CASE("AES block cipher modes", "[.block_cipher_factory]") {
 #endif
     }
 
-}
\ No newline at end of file
+    SECTION("fused pad-and-encrypt should match padding then encrypting\n") {
+        using key_t = std::array<aes_t::value_type, 32>;
+        key_t key = {0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+                     0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4};
+        block_t iv = {0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff};
+
+        crypto::block_cipher<crypto::CBC> cbc(key);
+        crypto::block_cipher<crypto::ECB> ecb(key);
+
+        for(size_t n{0}; n <= 40; ++n) {
+            std::vector<uint8_t> plain(n);
+            for(size_t i{0}; i < n; ++i) {
+                plain[i] = static_cast<uint8_t>(i * 13 + 1);
+            }
+
+            // the documented way: grow the container by the padding then encrypt in place
+            std::vector<uint8_t> expect(iv.begin(), iv.end());
+            expect.insert(expect.end(), plain.begin(), plain.end());
+            std::vector<uint8_t> padding(16);
+            const size_t k = crypto::padder<crypto::ANSIX923>().pad(plain.begin(), plain.end(), padding.begin());
+            expect.insert(expect.end(), padding.begin(), padding.begin() + k);
+            cbc.encrypt(expect.begin() + 16, expect.end());
+
+            std::vector<uint8_t> out(16 + crypto::block_cipher<crypto::CBC>::padded_size(n));
+            std::copy(iv.begin(), iv.end(), out.begin());
+            REQUIRE(cbc.encrypt_padded<crypto::padder<crypto::ANSIX923>>(plain.begin(), plain.end(), out.begin() + 16)
+                    == out.size() - 16);
+            REQUIRE(out == expect);
+            REQUIRE(cbc.decrypt_and_unpad<crypto::padder<crypto::ANSIX923>>(out.begin() + 16, out.end()) == n);
+            REQUIRE(std::equal(plain.begin(), plain.end(), out.begin() + 16));
+
+            // in place with room reserved up front, default PKCS7
+            std::vector<uint8_t> in_place(plain);
+            in_place.resize(crypto::block_cipher<>::padded_size(n));
+            const auto data = in_place.data();
+            REQUIRE(ecb.encrypt_padded(in_place.begin(), in_place.begin() + n, in_place.begin()) == in_place.size());
+            REQUIRE(in_place.data() == data);
+            in_place.resize(ecb.decrypt_and_unpad(in_place.begin(), in_place.end()));
+            REQUIRE(in_place == plain);
+        }
+
+        std::vector<uint8_t> ragged(17);
+        REQUIRE_THROWS_AS(ecb.decrypt_and_unpad(ragged.begin(), ragged.end()), doh::cipher_exception);
+    }
+
+    SECTION("fused pad-and-encrypt should round trip every padding scheme\n") {
+        using key_t = std::array<aes_t::value_type, 32>;
+        key_t key{};
+        crypto::block_cipher<crypto::CBC> cbc(key);
+
+        auto round_trip = [&cbc](auto padder, size_t n, size_t expected_size) {
+            using padder_t = decltype(padder);
+            std::vector<uint8_t> plain(n, 0x5A);
+            std::vector<uint8_t> out(16 + crypto::block_cipher<crypto::CBC>::padded_size(n));
+            const size_t written = cbc.encrypt_padded<padder_t>(plain.begin(), plain.end(), out.begin() + 16);
+            out.resize(16 + written);
+            const size_t size = cbc.decrypt_and_unpad<padder_t>(out.begin() + 16, out.end());
+            return written == expected_size && size == n && std::equal(plain.begin(), plain.end(), out.begin() + 16);
+        };
+
+        for(size_t n{0}; n <= 40; ++n) {
+            const size_t padded = crypto::block_cipher<crypto::CBC>::padded_size(n);
+            REQUIRE(round_trip(crypto::padder<crypto::ISO10126>(), n, padded));
+            REQUIRE(round_trip(crypto::padder<crypto::ISO7816>(), n, padded));
+            REQUIRE(round_trip(crypto::padder<crypto::ZEROS>(), n, n % 16 ? padded : n)); // plain text is non zero
+        }
+    }
+
+    SECTION("ciphers should copy, move and rekey without re-expanding\n") {
+        static_assert(std::is_copy_constructible_v<crypto::block_cipher<crypto::CBC>>);
+        static_assert(std::is_nothrow_move_constructible_v<crypto::block_cipher<crypto::CTR>>);
+        static_assert(std::is_copy_assignable_v<crypto::aes::decrypt<>>);
+
+        using key_t = std::array<aes_t::value_type, 32>;
+        key_t k1{}, k2{};
+        for(size_t i{0}; i < k1.size(); ++i) {
+            k1[i] = static_cast<uint8_t>(i);
+            k2[i] = static_cast<uint8_t>(0xFF - i);
+        }
+        std::vector<uint8_t> data(16 + 64, 0x00), expect1(data), expect2(data);
+        crypto::block_cipher<crypto::CBC>(k1).encrypt(expect1.begin() + 16, expect1.end());
+        crypto::block_cipher<crypto::CBC>(k2).encrypt(expect2.begin() + 16, expect2.end());
+
+        // a pool of ready ciphers, copied from one expanded key
+        crypto::block_cipher<crypto::CBC> proto(k1);
+        std::vector<crypto::block_cipher<crypto::CBC>> pool(4, proto);
+        pool.push_back(std::move(proto));
+        for(auto& cipher: pool) {
+            std::vector<uint8_t> out(data);
+            cipher.encrypt(out.begin() + 16, out.end());
+            REQUIRE(out == expect1);
+        }
+
+        // rotate the key of one without disturbing the rest
+        pool.front().rekey(k2);
+        std::vector<uint8_t> out(data);
+        pool.front().encrypt(out.begin() + 16, out.end());
+        REQUIRE(out == expect2);
+        pool.front().decrypt(out.begin() + 16, out.end());
+        REQUIRE(out == data);
+        out = data;
+        pool.back().encrypt(out.begin() + 16, out.end());
+        REQUIRE(out == expect1);
+
+        pool.back() = pool.front();
+        out = data;
+        pool.back().encrypt(out.begin() + 16, out.end());
+        REQUIRE(out == expect2);
+    }
+
+    SECTION("expanded keys should start a cache line, heap copies included\n") {
+        static_assert(alignof(crypto::aes::encrypt<>) == crypto::CACHE_LINE);
+        static_assert(alignof(crypto::block_cipher<crypto::CBC>) == crypto::CACHE_LINE);
+
+        std::array<aes_t::value_type, 32> key{};
+        std::vector<crypto::aes::encrypt<>> ciphers(3, crypto::aes::encrypt<>(key));
+        for(auto& cipher: ciphers) {
+            REQUIRE(reinterpret_cast<uintptr_t>(cipher.round_keys()) % crypto::CACHE_LINE == 0);
+        }
+    }
+
+    SECTION("the decrypt schedule should be derived from the encrypt schedule\n") {
+        static_assert(sizeof(crypto::block_cipher<crypto::CTR>) == sizeof(crypto::aes::encrypt<>),
+                      "CTR carries no decrypt schedule");
+        using key_t = std::array<aes_t::value_type, 32>;
+        key_t key{};
+        for(size_t i{0}; i < key.size(); ++i) {
+            key[i] = static_cast<uint8_t>(i * 7);
+        }
+        crypto::aes::encrypt<> enc(key);
+        crypto::aes::decrypt<> expanded(key), derived(enc);
+        block_t block{}, a{}, b{};
+        for(size_t i{0}; i < block.size(); ++i) {
+            block[i] = static_cast<uint8_t>(i);
+        }
+        enc.block(block.begin());
+        a = block;
+        b = block;
+        expanded.block(a.begin());
+        derived.block(b.begin());
+        REQUIRE(a == b);
+        derived.rekey(crypto::aes::encrypt<>(key_t{}));
+        b = block;
+        derived.block(b.begin());
+        REQUIRE(a != b);
+    }
+
+    SECTION("a pluggable decrypt cipher that does not derive should be keyed from the key\n") {
+        using enc_t = xor_cipher<xor_encrypt_tag>;
+        using dec_t = xor_cipher<xor_decrypt_tag>;
+        static_assert(crypto::derives_from_encrypt_v<crypto::aes::decrypt<>, crypto::aes::encrypt<>>);
+        static_assert(!crypto::derives_from_encrypt_v<dec_t, enc_t>);
+        std::array<uint8_t, 16> key{}, other{};
+        for(size_t i{0}; i < key.size(); ++i) {
+            key[i] = static_cast<uint8_t>(0x11 * i + 1);
+            other[i] = static_cast<uint8_t>(0xF0 ^ i);
+        }
+        std::vector<uint8_t> plain(16 * 3), test;
+        for(size_t i{0}; i < plain.size(); ++i) {
+            plain[i] = static_cast<uint8_t>(i);
+        }
+        crypto::block_cipher<crypto::ECB, enc_t, dec_t> ecb(key);
+        crypto::block_cipher<crypto::CBC, enc_t, dec_t> cbc(key);
+        for(int pass{0}; pass < 2; ++pass) {
+            test = plain;
+            ecb.encrypt(test.begin(), test.end());
+            REQUIRE(test != plain);
+            ecb.decrypt(test.begin(), test.end());
+            REQUIRE(test == plain);
+            cbc.encrypt(test.begin() + 16, test.end());
+            cbc.decrypt(test.begin() + 16, test.end());
+            REQUIRE(test == plain);
+            ecb.rekey(other);
+            cbc.rekey(other);
+        }
+    }
+
+}
@@ -0,0 +1,212 @@
+#include "catch2.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "../crypto/block_cipher_factory.h"
+#include "../crypto/nonce_factory.h"
+#include "../crypto/nonce_guard.h"
+#include "../util/benchmark.h"
+
+#include "kokke_aes.h"
+#undef ECB // tiny-AES-c configures itself with macros that would otherwise clobber crypto::ECB
+
+/**
+ * Throughput of every mode x key size x message size x kernel, written to benchmark.csv for stats/benchmark.R
+ * Run on demand, it takes minutes: ```./tests "[.benchmark]"```
+ * + AES_CPP17_BENCH_MAX - largest message in bytes (default 64 MiB), messages grow by 4x from 16 bytes
+ * + AES_CPP17_BENCH_REPS - timed repetitions per benchmark (default 5)
+ * + AES_CPP17_BENCH_MIN_MS - minimum duration of each repetition (default 20)
+ * + AES_CPP17_BENCH_CPU - CPU to pin the benchmark thread to (default the one it starts on)
+ * Cycles/byte are time stamp counter ticks, core cycles/byte, IPC and misses come from perf_event_open where allowed
+ * nonce_guard_insert times one nonce_guard::insert per iteration, its median_ns column is the ns per insert
+ * @note tiny-AES-c (kokke) is kept as the ECB AES-256 baseline the project started from
+ */
+namespace {
+
+    constexpr size_t MIN_MESSAGE = 16;
+    constexpr size_t MAX_MESSAGE = 64 << 20;
+
+    struct row_t {
+        const char* mode;
+        size_t key_bits;
+        const char* kernel;
+        util::bench::result_t result;
+    };
+
+    void record(std::vector<row_t>& rows, row_t row) {
+        const auto& r = row.result;
+        std::cout << std::left << std::setw(12) << row.mode << std::right << std::setw(4) << row.key_bits
+                  << std::setw(10) << row.kernel << std::setw(10) << r.bytes << std::fixed << std::setprecision(3)
+                  << std::setw(12) << r.gb_per_s() << " GB/s" << std::setw(10) << r.cycles_per_byte() << " cycles/byte"
+                  << std::setw(8) << std::setprecision(1) << 100 * r.ns.stddev / r.ns.mean << "% cv";
+        if(r.counters.ipc() > 0) {
+            std::cout << std::setw(8) << std::setprecision(2) << r.counters.ipc() << " ipc";
+        }
+        std::cout << '\n';
+        rows.push_back(std::move(row));
+    }
+
+    /**
+     * @brief a message buffer with a leading block for the CBC iv or CTR nonce, aligned as a heap buffer would be
+     */
+    std::vector<uint8_t> message(size_t size) {
+        std::vector<uint8_t> m(crypto::BLOCK_SIZE + size);
+        for(size_t i{0}; i < m.size(); ++i) {
+            m[i] = static_cast<uint8_t>(i * 131 + 7);
+        }
+        return m;
+    }
+
+    template<crypto::aes::ROUNDS R, crypto::aes::KEY_LENGTH N>
+    void bench_key_size(const char* kernel, const util::bench::options_t& options, size_t max_message,
+                        std::vector<row_t>& rows) {
+        using encrypt_t = crypto::aes::encrypt<R, N>;
+        using decrypt_t = crypto::aes::decrypt<R, N>;
+        constexpr size_t key_bits = N * crypto::WORD_SIZE * 8;
+
+        std::array<uint8_t, N * crypto::WORD_SIZE> key{};
+        for(size_t i{0}; i < key.size(); ++i) {
+            key[i] = static_cast<uint8_t>(0x60 + i);
+        }
+        crypto::block_cipher<crypto::ECB, encrypt_t, decrypt_t> ecb(key);
+        crypto::block_cipher<crypto::CBC, encrypt_t, decrypt_t> cbc(key);
+        crypto::block_cipher<crypto::CTR, encrypt_t, decrypt_t> ctr(key);
+
+        for(size_t size{MIN_MESSAGE}; size <= max_message; size *= 4) {
+            auto m = message(size);
+            const auto plain = m;
+            auto front = m.begin() + crypto::BLOCK_SIZE;
+            auto add = [&](const char* mode, auto&& f) {
+                record(rows, {mode, key_bits, kernel, util::bench::run(mode, size, [&] {
+                    f();
+                    util::bench::do_not_optimize(m.data());
+                }, options)});
+            };
+            add("ecb_encrypt", [&] { ecb.encrypt(front, m.end()); });
+            add("ecb_decrypt", [&] { ecb.decrypt(front, m.end()); });
+            add("cbc_encrypt", [&] { cbc.encrypt(front, m.end()); });
+            add("cbc_decrypt", [&] { cbc.decrypt(front, m.end()); });
+            add("ctr", [&] { ctr.encrypt(front, m.end()); });
+
+            // whatever state the timed loops left the buffer in, each mode must still round trip
+            auto check = plain;
+            ecb.encrypt(check.begin() + crypto::BLOCK_SIZE, check.end());
+            ecb.decrypt(check.begin() + crypto::BLOCK_SIZE, check.end());
+            cbc.encrypt(check.begin() + crypto::BLOCK_SIZE, check.end());
+            cbc.decrypt(check.begin() + crypto::BLOCK_SIZE, check.end());
+            ctr.encrypt(check.begin() + crypto::BLOCK_SIZE, check.end());
+            ctr.decrypt(check.begin() + crypto::BLOCK_SIZE, check.end());
+            REQUIRE(check == plain);
+        }
+    }
+
+    /**
+     * @brief nonce_guard::insert of a 12 byte counter nonce, reported in ns per insert - the target is well under 50
+     * @note cycles through a pool of counter nonces larger than the guard, an insert costs the same seen or not
+     */
+    void bench_nonce_guard(const util::bench::options_t& options, std::vector<row_t>& rows) {
+        crypto::nonce_guard<> guard;
+        crypto::nonce<crypto::COUNTER> n;
+        std::vector<std::array<uint8_t, crypto::NONCE_SIZE>> nonces(1 << 18);
+        for(auto& nonce: nonces) {
+            const auto block = n();
+            std::copy(block.begin(), block.begin() + crypto::NONCE_SIZE, nonce.begin());
+        }
+        size_t i{0};
+        size_t seen{0};
+        auto r = util::bench::run("nonce_guard_insert", crypto::NONCE_SIZE, [&] {
+            const auto& nonce = nonces[i++ & (nonces.size() - 1)];
+            seen += guard.insert(0, nonce.begin(), nonce.end());
+        }, options);
+        util::bench::do_not_optimize(&seen);
+        std::cout << "nonce_guard insert " << std::fixed << std::setprecision(1) << r.ns.median << " ns (min "
+                  << r.ns.min << " ns)\n";
+        record(rows, {"nonce_guard_insert", 0, "-", std::move(r)});
+    }
+
+    void bench_kokke(const util::bench::options_t& options, size_t max_message, std::vector<row_t>& rows) {
+        uint8_t key[] = {0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+                         0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4};
+        uint8_t in[] = {0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a};
+        const uint8_t out[] = {0xf3, 0xee, 0xd1, 0xbd, 0xb5, 0xd2, 0xa0, 0x3c, 0x06, 0x4b, 0x5a, 0x7e, 0x3d, 0xb1, 0x81,
+                               0xf8};
+        AES_ctx ctx;
+        AES_init_ctx(&ctx, key);
+        AES_ECB_encrypt(&ctx, in);
+        REQUIRE(std::memcmp(in, out, sizeof(out)) == 0);
+
+        for(size_t size{MIN_MESSAGE}; size <= max_message; size *= 4) {
+            auto m = message(size);
+            auto each_block = [&](void (*f)(const AES_ctx*, uint8_t*)) {
+                return [&, f] {
+                    for(size_t i{crypto::BLOCK_SIZE}; i < m.size(); i += crypto::BLOCK_SIZE) {
+                        f(&ctx, m.data() + i);
+                    }
+                    util::bench::do_not_optimize(m.data());
+                };
+            };
+            record(rows, {"ecb_encrypt", 256, "kokke",
+                          util::bench::run("ecb_encrypt", size, each_block(AES_ECB_encrypt), options)});
+            record(rows, {"ecb_decrypt", 256, "kokke",
+                          util::bench::run("ecb_decrypt", size, each_block(AES_ECB_decrypt), options)});
+        }
+    }
+
+}
+
+TEST_CASE("Benchmark", "[.benchmark]") {
+
+    util::bench::options_t options;
+    options.repetitions = std::max<size_t>(util::bench::env_size("AES_CPP17_BENCH_REPS", 5), 1);
+    options.min_time = std::chrono::milliseconds(util::bench::env_size("AES_CPP17_BENCH_MIN_MS", 20));
+    const size_t max_message = util::bench::env_size("AES_CPP17_BENCH_MAX", MAX_MESSAGE);
+    const auto cpu = util::bench::env_size("AES_CPP17_BENCH_CPU", static_cast<size_t>(-1));
+    const util::bench::pin_thread pin(static_cast<int>(cpu)); // unpinned again at the end of the test case
+    const bool counted = util::perf::counters().available(util::perf::CYCLES);
+    std::cout << "\npinned: " << (pin.pinned() ? "yes" : "no") << ", TSC " << util::tsc_clock::ticks_per_ns() << " GHz"
+              << (util::tsc_clock::invariant() ? " invariant" : "") << ", hardware counters: "
+              << (counted ? "yes" : "no") << '\n';
+
+    const crypto::kernel_t initial = crypto::active_kernel();
+    std::vector<row_t> rows;
+    for(auto kernel: {crypto::PORTABLE, crypto::AESNI}) {
+        if(!crypto::select_kernel(kernel)) {
+            continue;
+        }
+        const char* name = crypto::kernel_name(kernel);
+        bench_key_size<crypto::aes::R128, crypto::aes::N128>(name, options, max_message, rows);
+        bench_key_size<crypto::aes::R192, crypto::aes::N192>(name, options, max_message, rows);
+        bench_key_size<crypto::aes::R256, crypto::aes::N256>(name, options, max_message, rows);
+    }
+    crypto::select_kernel(initial);
+    bench_kokke(options, max_message, rows);
+    bench_nonce_guard(options, rows);
+
+    std::ofstream df{"benchmark.csv"};
+    df << "mode,key_bits,kernel,bytes,iterations,repetitions,min_ns,median_ns,mean_ns,stddev_ns,gb_per_s,"
+          "cycles_per_byte,core_cycles_per_byte,ipc,l1d_misses,branch_misses\n";
+    for(const auto& row: rows) {
+        const auto& r = row.result;
+        df << row.mode << ',' << row.key_bits << ',' << row.kernel << ',' << r.bytes << ',' << r.iterations << ','
+           << r.samples.size() << ',' << r.ns.min << ',' << r.ns.median << ',' << r.ns.mean << ',' << r.ns.stddev
+           << ',' << r.gb_per_s() << ',' << r.cycles_per_byte() << ',';
+        // the counters are per iteration, left empty (NA) where they could not be read
+        if(r.counters.has(util::perf::CYCLES)) df << r.core_cycles_per_byte();
+        df << ',';
+        if(r.counters.ipc() > 0) df << r.counters.ipc();
+        for(auto counter: {util::perf::L1D_MISSES, util::perf::BRANCH_MISSES}) {
+            df << ',';
+            if(r.counters.has(counter)) df << static_cast<double>(r.counters[counter]) / r.iterations;
+        }
+        df << '\n';
+    }
+    REQUIRE(df.good());
+
+}
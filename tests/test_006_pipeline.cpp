@@ -0,0 +1,137 @@
+#include "catch2.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include "../crypto/block_cipher_pipeline.h"
+#include "../util/phex.h"
+
+TEST_CASE("Block cipher pipeline", "[.block_cipher_pipeline]") {
+
+    using key_t = std::array<uint8_t, 32>;
+
+    key_t key = {0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+                 0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4};
+
+    std::array<uint8_t, 16> iv = {0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd,
+                                  0xfe, 0xff};
+
+    std::vector<uint8_t> plain(16 * 1000);
+    for(size_t i{0}; i < plain.size(); ++i) {
+        plain[i] = static_cast<uint8_t>(i * 7 + 3);
+    }
+
+    // memory backed reader & writer that hand out deliberately short reads
+    auto source = [](const std::vector<uint8_t>& in, size_t& pos) {
+        return [&in, &pos](uint8_t* p, size_t n) {
+            n = std::min({n, in.size() - pos, size_t{100}});
+            std::memcpy(p, in.data() + pos, n);
+            pos += n;
+            return n;
+        };
+    };
+    auto sink = [](std::vector<uint8_t>& out) {
+        return [&out](const uint8_t* p, size_t n) {
+            out.insert(out.end(), p, p + n);
+        };
+    };
+
+    SECTION("CBC pipeline should match one shot encryption") {
+        using cipher_t = crypto::block_cipher<crypto::CBC>;
+        cipher_t aes(key);
+
+        std::vector<uint8_t> expect(iv.begin(), iv.end());
+        expect.insert(expect.end(), plain.begin(), plain.end());
+        aes.encrypt(expect.begin() + 16, expect.end());
+        expect.erase(expect.begin(), expect.begin() + 16);
+
+        crypto::pipeline<cipher_t> pipe(aes, 250, 3);
+        REQUIRE(pipe.chunk_size() == 256);
+
+        std::vector<uint8_t> cipher, test;
+        size_t pos{0};
+        REQUIRE(pipe.encrypt(source(plain, pos), sink(cipher), iv) == plain.size());
+        REQUIRE(cipher == expect);
+
+        pos = 0;
+        REQUIRE(pipe.decrypt(source(cipher, pos), sink(test), iv) == plain.size());
+        REQUIRE(test == plain);
+    }
+
+    SECTION("CTR pipeline should match one shot encryption with a partial final block") {
+        using cipher_t = crypto::block_cipher<crypto::CTR>;
+        cipher_t aes(key);
+
+        plain.resize(plain.size() - 5);
+        std::vector<uint8_t> expect(iv.begin(), iv.end());
+        expect.insert(expect.end(), plain.begin(), plain.end());
+        expect.resize(expect.size() + 5);
+        aes.encrypt(expect.begin() + 16, expect.end());
+        expect.erase(expect.begin(), expect.begin() + 16);
+        expect.resize(plain.size());
+
+        crypto::pipeline<cipher_t> pipe(aes, 4096);
+
+        std::vector<uint8_t> cipher, test;
+        size_t pos{0};
+        REQUIRE(pipe.encrypt(source(plain, pos), sink(cipher), iv) == plain.size());
+        REQUIRE(cipher == expect);
+
+        pos = 0;
+        REQUIRE(pipe.decrypt(source(cipher, pos), sink(test), iv) == plain.size());
+        REQUIRE(test == plain);
+    }
+
+    SECTION("CTR chunks of unaligned sizes should carry the keystream across partial blocks") {
+        using cipher_t = crypto::block_cipher<crypto::CTR>;
+        cipher_t aes(key);
+
+        std::vector<uint8_t> expect(iv.begin(), iv.end());
+        expect.insert(expect.end(), plain.begin(), plain.end());
+        aes.encrypt(expect.begin() + 16, expect.end());
+        expect.erase(expect.begin(), expect.begin() + 16);
+
+        for(size_t step: {1, 5, 15, 17, 33, 100}) {
+            std::vector<uint8_t> data(16 + plain.size()); // BLOCK_SIZE headroom then the message
+            std::copy(plain.begin(), plain.end(), data.begin() + 16);
+            crypto::chained_cipher<cipher_t> chain(aes, iv);
+            for(size_t i{0}, n{step}; i < plain.size(); i += n, n = n % 23 + step) { // varying chunk sizes
+                n = std::min(n, plain.size() - i);
+                chain.encrypt(data.begin() + 16 + i, data.begin() + 16 + i + n);
+            }
+            INFO("step " << step);
+            REQUIRE(std::equal(expect.begin(), expect.end(), data.begin() + 16));
+
+            crypto::chained_cipher<cipher_t> back(aes, iv);
+            for(size_t i{0}, n{step + 3}; i < plain.size(); i += n) {
+                n = std::min(step + 3, plain.size() - i);
+                back.decrypt(data.begin() + 16 + i, data.begin() + 16 + i + n);
+            }
+            REQUIRE(std::equal(plain.begin(), plain.end(), data.begin() + 16));
+        }
+    }
+
+    SECTION("unaligned CBC input should throw and not hang") {
+        using cipher_t = crypto::block_cipher<crypto::CBC>;
+        cipher_t aes(key);
+        crypto::pipeline<cipher_t> pipe(aes, 64);
+
+        plain.resize(plain.size() - 1);
+        std::vector<uint8_t> cipher;
+        size_t pos{0};
+        CHECK_THROWS_AS(pipe.encrypt(source(plain, pos), sink(cipher), iv), doh::cipher_exception);
+    }
+
+    SECTION("a failing writer should propagate its exception") {
+        using cipher_t = crypto::block_cipher<crypto::CTR>;
+        cipher_t aes(key);
+        crypto::pipeline<cipher_t> pipe(aes, 64);
+
+        size_t pos{0};
+        auto broken = [](const uint8_t*, size_t) { throw std::runtime_error("broken pipe"); };
+        CHECK_THROWS_AS(pipe.encrypt(source(plain, pos), broken, iv), std::runtime_error);
+    }
+
+}
@@ -0,0 +1,127 @@
+#include "catch2.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdlib>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../crypto/file_cipher.h"
+
+TEST_CASE("File cipher", "[.file_cipher]") {
+
+    using cipher_t = crypto::block_cipher<crypto::CTR>;
+    using file_cipher_t = crypto::file_cipher<cipher_t>;
+    using key_t = std::array<cipher_t::value_type, 32>;
+
+    key_t key = {0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+                 0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4};
+
+    cipher_t::block_t nonce = {0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd,
+                               0xfe, 0xff};
+
+    cipher_t aes(key);
+
+    // deliberately not a multiple of either the block or the chunk size
+    std::vector<uint8_t> plain(100'003);
+    for(size_t i{0}; i < plain.size(); ++i) {
+        plain[i] = static_cast<uint8_t>(i * 13 + 1);
+    }
+
+    // one shot CTR over the nonce then the plain text padded to whole blocks
+    std::vector<uint8_t> expect(16 + ((plain.size() + 15) / 16) * 16);
+    std::copy(nonce.begin(), nonce.end(), expect.begin());
+    std::copy(plain.begin(), plain.end(), expect.begin() + 16);
+    aes.encrypt(expect.begin() + 16, expect.end());
+    expect.erase(expect.begin(), expect.begin() + 16);
+    expect.resize(plain.size());
+
+    auto temp_file = [](const std::vector<uint8_t>& data) {
+        char name[] = "/tmp/aes_file_cipherXXXXXX";
+        int fd = mkstemp(name);
+        REQUIRE(fd >= 0);
+        unlink(name);
+        REQUIRE(pwrite(fd, data.data(), data.size(), 0) == static_cast<ssize_t>(data.size()));
+        return fd;
+    };
+    auto slurp = [](int fd, size_t n) {
+        std::vector<uint8_t> data(n);
+        REQUIRE(pread(fd, data.data(), n, 0) == static_cast<ssize_t>(n));
+        return data;
+    };
+
+    for(bool use_io_uring: {true, false}) {
+
+        SECTION(use_io_uring ? "io_uring (if available) should match one shot CTR" : "pread/pwrite should match one shot CTR") {
+            file_cipher_t files(aes, 4096, 4, use_io_uring);
+            int in = temp_file(plain);
+            int out = temp_file({});
+
+            REQUIRE(files.encrypt(in, out, nonce) == plain.size());
+            if(!use_io_uring) {
+                REQUIRE_FALSE(files.uring());
+            }
+            REQUIRE(slurp(out, plain.size()) == expect);
+
+            // decrypt in place
+            REQUIRE(files.decrypt(out, out, nonce) == plain.size());
+            REQUIRE(slurp(out, plain.size()) == plain);
+
+            close(in);
+            close(out);
+        }
+
+        SECTION(use_io_uring ? "io_uring should report a failed write once the chunks in flight have drained"
+                             : "pread/pwrite should report a failed write") {
+            file_cipher_t files(aes, 4096, 4, use_io_uring);
+            int in = temp_file(plain);
+            char name[] = "/tmp/aes_file_cipherXXXXXX";
+            int writable = mkstemp(name);
+            REQUIRE(writable >= 0);
+            int read_only = open(name, O_RDONLY);
+            unlink(name);
+            REQUIRE(read_only >= 0);
+
+            REQUIRE_THROWS_AS(files.encrypt(in, read_only, nonce), std::system_error);
+            // every read and write has completed, so the same buffers and ring size work again
+            REQUIRE(files.encrypt(in, writable, nonce) == plain.size());
+            REQUIRE(slurp(writable, plain.size()) == expect);
+
+            close(in);
+            close(read_only);
+            close(writable);
+        }
+
+    }
+
+    SECTION("A pipe should be refused rather than read as 0 bytes") {
+        file_cipher_t files(aes);
+        int fds[2];
+        REQUIRE(pipe(fds) == 0);
+        REQUIRE(write(fds[1], plain.data(), 64) == 64);
+        int out = temp_file({});
+        try {
+            files.encrypt(fds[0], out, nonce);
+            FAIL("encrypted a pipe");
+        } catch(const std::system_error& e) {
+            REQUIRE(e.code().value() == ESPIPE);
+        }
+        close(fds[0]);
+        close(fds[1]);
+        close(out);
+    }
+
+    SECTION("A transfer of 0 bytes should fail rather than be retried for ever") {
+        REQUIRE(crypto::transfer_error(16) == 0);
+        REQUIRE(crypto::transfer_error(0) == EIO); // a truncated read or a write the device will not take
+        REQUIRE(crypto::transfer_error(-EINTR) == 0);
+        REQUIRE(crypto::transfer_error(-EAGAIN) == 0);
+        REQUIRE(crypto::transfer_error(-EBADF) == EBADF);
+        REQUIRE(crypto::transfer_error(-ENOSPC) == ENOSPC);
+    }
+
+}
@@ -0,0 +1,102 @@
+#include "catch2.h"
+
+#include <algorithm>
+#include <array>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../crypto/cipher_streambuf.h"
+
+TEST_CASE("Cipher streambuf", "[.cipher_streambuf]") {
+
+    using key_t = std::array<uint8_t, 32>;
+
+    key_t key = {0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+                 0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4};
+
+    std::array<uint8_t, 16> iv = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d,
+                                  0x0e, 0x0f};
+
+    std::string text;
+    for(size_t i{0}; i < 500; ++i) {
+        text += "line " + std::to_string(i) + " of the export\n";
+    }
+
+    SECTION("CBC streambuf should match one shot padded encryption and round trip") {
+        using cipher_t = crypto::block_cipher<crypto::CBC>;
+        cipher_t aes(key);
+
+        std::vector<uint8_t> expect;
+        expect.reserve(16 + text.size() + 16);
+        std::copy(iv.begin(), iv.end(), std::back_inserter(expect));
+        std::copy(text.begin(), text.end(), std::back_inserter(expect));
+        crypto::padder<> pkcs7;
+        std::vector<uint8_t> padding(pkcs7.block_size());
+        size_t n = pkcs7.pad(expect.begin() + 16, expect.end(), padding.begin());
+        expect.insert(expect.end(), padding.begin(), padding.begin() + n);
+        aes.encrypt(expect.begin() + 16, expect.end());
+        expect.erase(expect.begin(), expect.begin() + 16);
+
+        std::stringbuf sink;
+        {
+            crypto::encrypting_streambuf<cipher_t> enc(&sink, aes, iv, 100);
+            std::ostream out(&enc);
+            for(size_t i{0}; i < 500; ++i) {
+                out << "line " << i << " of the export\n";
+            }
+            enc.close();
+        }
+        std::string cipher = sink.str();
+        REQUIRE(std::vector<uint8_t>(cipher.begin(), cipher.end()) == expect);
+
+        std::stringbuf source(cipher);
+        crypto::decrypting_streambuf<cipher_t> dec(&source, aes, iv, 64);
+        std::istream in(&dec);
+        std::string test{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+        REQUIRE(test == text);
+    }
+
+    SECTION("CTR streambuf should round trip without padding") {
+        using cipher_t = crypto::block_cipher<crypto::CTR>;
+        cipher_t aes(key);
+
+        std::stringbuf sink;
+        {
+            crypto::encrypting_streambuf<cipher_t> enc(&sink, aes, iv, 48);
+            std::ostream out(&enc);
+            out << text;
+        }
+        std::string cipher = sink.str();
+        REQUIRE(cipher.size() == text.size());
+        REQUIRE(cipher != text);
+
+        std::stringbuf source(cipher);
+        crypto::decrypting_streambuf<cipher_t> dec(&source, aes, iv);
+        std::istream in(&dec);
+        std::string test{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+        REQUIRE(test == text);
+    }
+
+    SECTION("tampered CBC padding should throw on read") {
+        using cipher_t = crypto::block_cipher<crypto::CBC>;
+        cipher_t aes(key);
+
+        std::stringbuf sink;
+        {
+            crypto::encrypting_streambuf<cipher_t> enc(&sink, aes, iv);
+            std::ostream(&enc) << text;
+        }
+        std::string cipher = sink.str();
+        cipher[cipher.size() - 17] ^= 0x01; // flips the last plain text byte i.e. the padding value
+
+        std::stringbuf source(cipher);
+        crypto::decrypting_streambuf<cipher_t> dec(&source, aes, iv);
+        std::vector<char> test(text.size() + 16);
+        CHECK_THROWS_AS(dec.sgetn(test.data(), static_cast<std::streamsize>(test.size())), doh::cipher_exception);
+    }
+
+}
@@ -0,0 +1,124 @@
+#include "catch2.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include "../crypto/cmac.h"
+#include "../crypto/stream_container.h"
+#include "../util/phex.h"
+
+TEST_CASE("Segmented AEAD stream container", "[.stream_container]") {
+
+    using key_t = std::array<uint8_t, 32>;
+    using block_t = crypto::cmac<>::block_t;
+
+    key_t key = {0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+                 0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4};
+
+    SECTION("AES256 CMAC NIST SP 800-38B check") {
+
+        std::vector<uint8_t> plain = {0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73,
+                                      0x93, 0x17, 0x2a,
+                                      0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45,
+                                      0xaf, 0x8e, 0x51,
+                                      0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11};
+
+        block_t empty = {0x02, 0x89, 0x62, 0xf6, 0x1b, 0x7b, 0xf8, 0x9e, 0xfc, 0x6b, 0x55, 0x1f, 0x46, 0x67, 0xd9,
+                         0x83};
+        block_t one = {0x28, 0xa7, 0x02, 0x3f, 0x45, 0x2e, 0x8f, 0x82, 0xbd, 0x4b, 0xf2, 0x8d, 0x8c, 0x37, 0xc3, 0x5c};
+        block_t partial = {0xaa, 0xf3, 0xd8, 0xf1, 0xde, 0x56, 0x40, 0xc2, 0x32, 0xf5, 0xb1, 0x69, 0xb9, 0xc9, 0x11,
+                           0xe6};
+
+        crypto::cmac<> mac(key);
+        REQUIRE(mac(plain.begin(), plain.begin()) == empty);
+        REQUIRE(mac(plain.begin(), plain.begin() + 16) == one);
+        block_t tag = mac(plain.begin(), plain.end());
+        util::phex(tag);
+        REQUIRE(tag == partial);
+
+        // incremental updates must give the same tag
+        mac.update(plain.begin(), plain.begin() + 7);
+        mac.update(plain.begin() + 7, plain.begin() + 16);
+        mac.update(plain.begin() + 16, plain.end());
+        REQUIRE(mac.final() == partial);
+    }
+
+    using container_t = crypto::stream_container<>;
+    container_t::prefix_t prefix = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07};
+
+    std::vector<uint8_t> plain(10'000);
+    for(size_t i{0}; i < plain.size(); ++i) {
+        plain[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+
+    SECTION("seal and open should round trip in parallel") {
+        container_t stream(key, 1024);
+        auto sealed = stream.seal(plain.data(), plain.size(), prefix, 4);
+        REQUIRE(sealed.size() == 32 + plain.size() + 10 * (16 + 8) + 32);
+        REQUIRE(stream.open(sealed.data(), sealed.size(), 3) == plain);
+
+        // the segment size comes from the header not the reader's constructor
+        container_t reader(key);
+        REQUIRE(reader.open(sealed.data(), sealed.size()) == plain);
+
+        auto empty = stream.seal(plain.data(), 0, prefix);
+        REQUIRE(stream.open(empty.data(), empty.size()).empty());
+    }
+
+    SECTION("segment k should open alone via ranged reads") {
+        container_t stream(key, 1024);
+        auto sealed = stream.seal(plain.data(), plain.size(), prefix);
+
+        size_t bytes_read{0};
+        container_t::reader_t read = [&](uint64_t offset, uint8_t* out, size_t n) {
+            std::memcpy(out, sealed.data() + offset, n);
+            bytes_read += n;
+        };
+        auto index = stream.read_index(read, sealed.size());
+        REQUIRE(index.segment_count() == 10);
+        REQUIRE(index.length == plain.size());
+
+        std::vector<uint8_t> segment(index.segment_size);
+        bytes_read = 0;
+        REQUIRE(stream.open_segment(read, index, 9, segment.data()) == plain.size() - 9 * 1024);
+        REQUIRE(bytes_read == plain.size() - 9 * 1024 + 16);
+        REQUIRE(std::equal(plain.begin() + 9 * 1024, plain.end(), segment.begin()));
+        REQUIRE(stream.open_segment(read, index, 3, segment.data()) == 1024);
+        REQUIRE(std::equal(plain.begin() + 3 * 1024, plain.begin() + 4 * 1024, segment.begin()));
+    }
+
+    SECTION("a container sealed on one kernel should open on any other") {
+        const crypto::kernel_t initial = crypto::active_kernel();
+        REQUIRE(crypto::select_kernel(crypto::PORTABLE));
+        container_t stream(key, 1024);
+        const auto portable = stream.seal(plain.data(), plain.size() - 5, prefix, 2); // a partial final block
+        crypto::select_kernel(crypto::best_kernel());
+        REQUIRE(stream.seal(plain.data(), plain.size() - 5, prefix, 2) == portable);
+        const auto opened = stream.open(portable.data(), portable.size());
+        crypto::select_kernel(initial);
+        REQUIRE(std::equal(opened.begin(), opened.end(), plain.begin()));
+        REQUIRE(opened.size() == plain.size() - 5);
+    }
+
+    SECTION("tampering, reordering and truncation should fail authentication") {
+        container_t stream(key, 1024);
+        auto sealed = stream.seal(plain.data(), plain.size(), prefix);
+
+        auto flipped = sealed;
+        flipped[32 + 5 * (1024 + 16) + 100] ^= 0x01;
+        CHECK_THROWS_AS(stream.open(flipped.data(), flipped.size()), doh::cipher_exception);
+
+        auto swapped = sealed;
+        std::swap_ranges(swapped.begin() + 32, swapped.begin() + 32 + 1040, swapped.begin() + 32 + 1040);
+        CHECK_THROWS_AS(stream.open(swapped.data(), swapped.size()), doh::cipher_exception);
+
+        auto truncated = stream.seal(plain.data(), 3 * 1024, prefix);
+        CHECK_THROWS_AS(stream.open(truncated.data(), truncated.size() - 1), doh::cipher_exception);
+
+        container_t other(key_t{});
+        CHECK_THROWS_AS(other.open(sealed.data(), sealed.size()), doh::cipher_exception);
+    }
+
+}
@@ -0,0 +1,98 @@
+#include "catch2.h"
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+
+#include <array>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "../crypto/async_cipher.h"
+#include "../util/thread_pool.h"
+
+namespace {
+
+    // just enough of a coroutine task to co_await from a test
+    struct task {
+        struct promise_type {
+            std::promise<void> done;
+            task get_return_object() { return {done.get_future()}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() { done.set_value(); }
+            void unhandled_exception() { done.set_exception(std::current_exception()); }
+        };
+        std::future<void> result;
+    };
+
+    template<typename C>
+    task encrypt_then_decrypt(C& aes, std::vector<uint8_t>& cipher, std::vector<uint8_t>& test,
+                              util::thread_pool& pool, crypto::async_options options) {
+        co_await crypto::async_encrypt(aes, cipher.begin() + 16, cipher.end(), pool, options);
+        test = cipher;
+        co_await crypto::async_decrypt(aes, test.begin() + 16, test.end(), pool, options);
+    }
+
+}
+
+TEST_CASE("Async cipher", "[.async_cipher]") {
+
+    std::array<uint8_t, 32> key = {0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d,
+                                   0x77, 0x81, 0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3,
+                                   0x09, 0x14, 0xdf, 0xf4};
+
+    std::vector<uint8_t> plain(16 + 16 * 1000);
+    for(size_t i{0}; i < plain.size(); ++i) {
+        plain[i] = static_cast<uint8_t>(i * 7 + 3); // the first block is the IV
+    }
+
+    util::thread_pool pool(2);
+
+    SECTION("Chunked CBC on the pool should match one shot encryption") {
+        crypto::block_cipher<crypto::CBC> aes(key);
+        std::vector<uint8_t> expect = plain;
+        aes.encrypt(expect.begin() + 16, expect.end());
+
+        std::vector<uint8_t> cipher = plain, test;
+        encrypt_then_decrypt(aes, cipher, test, pool, {1000, 0}).result.get();
+        REQUIRE(cipher == expect);
+        REQUIRE(test == plain);
+    }
+
+    SECTION("Chunked CTR with a partial block should match one shot encryption") {
+        crypto::block_cipher<crypto::CTR> aes(key);
+        plain.resize(plain.size() - 5);
+        std::vector<uint8_t> expect = plain;
+        std::array<uint8_t, 16> iv;
+        std::copy(plain.begin(), plain.begin() + 16, iv.begin());
+        crypto::chained_cipher<crypto::block_cipher<crypto::CTR>> one_shot(aes, iv); // handles the partial block
+        one_shot.encrypt(expect.begin() + 16, expect.end());
+
+        std::vector<uint8_t> cipher = plain, test;
+        encrypt_then_decrypt(aes, cipher, test, pool, {256, 0}).result.get();
+        REQUIRE(cipher == expect);
+        REQUIRE(test == plain);
+    }
+
+    SECTION("Small jobs should complete inline without suspending") {
+        crypto::block_cipher<crypto::CTR> aes(key);
+        std::vector<uint8_t> expect = plain;
+        aes.encrypt(expect.begin() + 16, expect.end());
+
+        std::vector<uint8_t> cipher = plain, test;
+        auto t = encrypt_then_decrypt(aes, cipher, test, pool, {64 * 1024, plain.size()});
+        REQUIRE(t.result.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+        REQUIRE(cipher == expect);
+        REQUIRE(test == plain);
+    }
+
+    SECTION("Errors should be rethrown into the awaiting coroutine") {
+        crypto::block_cipher<crypto::CBC> aes(key);
+        std::vector<uint8_t> cipher(plain.begin(), plain.end() - 1), test;
+        REQUIRE_THROWS_AS(encrypt_then_decrypt(aes, cipher, test, pool, {1024, 0}).result.get(),
+                          doh::cipher_exception);
+    }
+
+}
+
+#endif
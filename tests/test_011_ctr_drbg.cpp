@@ -0,0 +1,85 @@
+#include "catch2.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "../crypto/ctr_drbg.h"
+#include "../util/phex.h"
+
+TEST_CASE("CTR DRBG", "[.ctr_drbg]") {
+
+    using drbg_t = crypto::ctr_drbg<>;
+
+    drbg_t::seed_t entropy, reseed_entropy, personalization, additional;
+    for(size_t i{0}; i < drbg_t::SEED_SIZE; ++i) {
+        entropy[i] = static_cast<uint8_t>(i);
+        reseed_entropy[i] = static_cast<uint8_t>(0x80 + i);
+        personalization[i] = static_cast<uint8_t>(0x40 + i);
+        additional[i] = static_cast<uint8_t>(0xc0 + i);
+    }
+
+    SECTION("AES-256 no derivation function should match the OpenSSL CTR-DRBG") {
+        auto drbg = drbg_t::from_entropy(entropy, personalization);
+        std::vector<uint8_t> out(64);
+
+        drbg.generate(out.data(), out.size());
+        REQUIRE(out == std::vector<uint8_t>{
+                0x5d, 0xe6, 0xaa, 0x50, 0x02, 0x2f, 0x01, 0xdf, 0x04, 0x5b, 0x3f, 0xda, 0x58, 0xa2, 0xad, 0x77,
+                0x91, 0x32, 0xf6, 0x6f, 0xb0, 0x4c, 0xe0, 0xc2, 0xb0, 0xfa, 0x07, 0x21, 0xf6, 0x86, 0xd3, 0xe4,
+                0x79, 0xb1, 0x88, 0x65, 0x9e, 0x08, 0xdc, 0x83, 0x10, 0x05, 0x0d, 0x9a, 0x2e, 0xb9, 0x58, 0xdf,
+                0x87, 0x73, 0x0c, 0x9a, 0xe9, 0x46, 0x11, 0x89, 0xc5, 0xef, 0x73, 0x00, 0xde, 0x0f, 0x75, 0x2c});
+
+        drbg.generate(out.data(), out.size());
+        REQUIRE(out == std::vector<uint8_t>{
+                0x7b, 0xcf, 0x87, 0xb8, 0x64, 0xdd, 0xd8, 0xd7, 0x18, 0x57, 0x11, 0x2b, 0x43, 0x95, 0x3d, 0xb4,
+                0xc0, 0x9f, 0x09, 0x85, 0xf3, 0xd4, 0x9e, 0x81, 0x5f, 0x04, 0xb7, 0x96, 0xbc, 0x72, 0x77, 0xdf,
+                0xc3, 0x62, 0x51, 0x2a, 0x53, 0x42, 0x4d, 0x28, 0x76, 0x55, 0x8f, 0x4a, 0xc0, 0x25, 0x4d, 0x94,
+                0x43, 0xc2, 0xe2, 0x72, 0x0d, 0x2b, 0x4a, 0x7a, 0x74, 0xea, 0x8a, 0x35, 0x70, 0xb0, 0x28, 0x80});
+
+        out.resize(37); // partial final block with additional input
+        drbg.generate(out.data(), out.size(), additional);
+        REQUIRE(out == std::vector<uint8_t>{
+                0x52, 0x4b, 0x24, 0xa1, 0x92, 0x88, 0x93, 0xf2, 0xd8, 0x6e, 0x3a, 0x65, 0x72, 0x01, 0xba, 0x94,
+                0x6d, 0xad, 0x52, 0xd0, 0xea, 0x2b, 0xe5, 0x21, 0xca, 0x1b, 0xf7, 0xd1, 0xd3, 0xab, 0x78, 0x38,
+                0x3d, 0x19, 0x54, 0x7d, 0x35});
+
+        drbg.reseed(reseed_entropy, additional);
+        REQUIRE(drbg.reseed_counter() == 1);
+        out.resize(64);
+        drbg.generate(out.data(), out.size());
+        REQUIRE(out == std::vector<uint8_t>{
+                0xcd, 0xee, 0xf7, 0x06, 0xf3, 0x26, 0x85, 0xca, 0x1d, 0x93, 0xae, 0x19, 0xf5, 0x2a, 0xc6, 0x94,
+                0x2b, 0x9c, 0x94, 0xf8, 0x8f, 0x6d, 0xfa, 0x93, 0x89, 0xc4, 0xd0, 0x20, 0xa7, 0x90, 0x13, 0xdb,
+                0x81, 0x64, 0xe0, 0x04, 0x2a, 0xa9, 0x8a, 0x8a, 0xd0, 0xd6, 0xa1, 0xf9, 0xe5, 0x2d, 0x0a, 0x85,
+                0xf8, 0x3c, 0x76, 0x4c, 0x62, 0xf5, 0x84, 0x4f, 0x39, 0x22, 0x94, 0xf8, 0x23, 0x30, 0x6f, 0xde});
+    }
+
+    SECTION("Bulk requests should be split and reseeded on the interval") {
+        auto drbg = drbg_t::from_entropy(entropy, personalization, 2);
+        std::vector<uint8_t> out(3 * drbg_t::MAX_REQUEST + 5);
+        drbg.generate(out.data(), out.size()); // 4 requests, the 3rd reseeds from the entropy pool
+        REQUIRE(drbg.reseed_counter() == 3);
+        REQUIRE(!std::equal(out.begin(), out.begin() + 64, out.begin() + 64));
+    }
+
+    SECTION("An empty personalization should not be ambiguous and additional input should survive a reseed") {
+        auto drbg = drbg_t::from_entropy(entropy, {}, 1);
+        std::vector<uint8_t> out(64);
+        drbg.generate(out.data(), out.size());
+        drbg.generate(out.data(), out.size(), additional); // reseeds first
+        REQUIRE(drbg.reseed_counter() == 2);
+    }
+
+    SECTION("Thread local generators should be independently seeded") {
+        auto block = drbg_t::local().get<drbg_t::block_t>();
+        drbg_t::block_t other;
+        std::thread t([&other] { other = drbg_t::local().get<drbg_t::block_t>(); });
+        t.join();
+        util::phex(block);
+        util::phex(other);
+        REQUIRE(block != other);
+        REQUIRE(block != drbg_t::local().get<drbg_t::block_t>());
+    }
+
+}
@@ -0,0 +1,132 @@
+#include "catch2.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "../crypto/nonce_guard.h"
+#include "../crypto/nonce_factory.h"
+
+TEST_CASE("Nonce guard", "[.nonce_guard]") {
+
+    using nonce_t = crypto::nonce<crypto::COUNTER>;
+
+    SECTION("SipHash-2-4 should match the reference vector") {
+        // key 00..0f, message 00..0e (Aumasson & Bernstein 2012, appendix A)
+        crypto::siphash24 sip({0x0706050403020100ull, 0x0f0e0d0c0b0a0908ull});
+        sip.update(0x0706050403020100ull);
+        REQUIRE(sip.final(0x000e0d0c0b0a0908ull, 15) == 0xa129ca6149be45e5ull);
+    }
+
+    SECTION("Reused nonces should always be reported, fresh ones rarely") {
+        crypto::nonce_guard<> guard(1 << 17, {0x0123456789abcdefull, 0xfedcba9876543210ull}); // 16 bits per nonce
+        nonce_t n;
+        std::vector<nonce_t::block_t> used(1 << 16);
+        size_t false_positives{0};
+        for(auto& block: used) {
+            block = n();
+            false_positives += guard.insert(0, block.begin(), block.begin() + crypto::NONCE_SIZE);
+        }
+        REQUIRE(std::all_of(used.begin(), used.end(), [&guard](const auto& block) {
+            return guard.contains(0, block.begin(), block.begin() + crypto::NONCE_SIZE)
+                   && guard.insert(0, block.begin(), block.begin() + crypto::NONCE_SIZE);
+        }));
+        INFO("false positives " << false_positives);
+        REQUIRE(false_positives < used.size() / 250); // the documented rate once full, the filling average is lower
+
+        auto& block = used.front(); // the same nonce under another key is fine
+        REQUIRE(!guard.insert(1, block.begin(), block.begin() + crypto::NONCE_SIZE));
+    }
+
+    SECTION("Racing inserts of one nonce should let exactly one through") {
+        crypto::nonce_guard<> guard;
+        auto block = nonce_t()();
+        std::atomic<int> fresh{0};
+        std::vector<std::thread> threads;
+        for(int i{0}; i < 8; ++i) {
+            threads.emplace_back([&] {
+                fresh += !guard.insert(7, block.begin(), block.begin() + crypto::NONCE_SIZE);
+            });
+        }
+        for(auto& t: threads) {
+            t.join();
+        }
+        REQUIRE(fresh == 1);
+    }
+
+    SECTION("Guarded CTR should refuse to encrypt twice under one nonce") {
+        std::array<uint8_t, 32> key = {0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85,
+                                       0x7d, 0x77, 0x81, 0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98,
+                                       0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4};
+        crypto::block_cipher<crypto::CTR> cipher(key);
+        crypto::nonce_guard<> guard;
+        crypto::guarded_cipher<crypto::block_cipher<crypto::CTR>> aes(cipher, guard);
+
+        auto block = nonce_t()();
+        std::vector<uint8_t> a(block.begin(), block.end()), b;
+        a.resize(16 + 64, 0x55);
+        b = a;
+        aes.encrypt(a.begin() + 16, a.end());
+        REQUIRE_THROWS_AS(aes.encrypt(b.begin() + 16, b.end()), doh::cipher_exception);
+        REQUIRE(std::all_of(b.begin() + 16, b.end(), [](auto x) { return x == 0x55; })); // untouched
+
+        aes.decrypt(a.begin() + 16, a.end());
+        REQUIRE(a == b);
+    }
+
+    SECTION("Pairs built to collide under an unkeyed hash should not be reported") {
+        auto mix = [](uint64_t x) { // MurmurHash3 64 bit finaliser
+            x ^= x >> 33u;
+            x *= 0xff51afd7ed558ccdull;
+            x ^= x >> 33u;
+            x *= 0xc4ceb9fe1a85ec53ull;
+            x ^= x >> 33u;
+            return x;
+        };
+        auto word = [](const auto& a, size_t i) {
+            uint64_t w{0};
+            std::memcpy(&w, a.data() + i, sizeof(w));
+            return w;
+        };
+        crypto::nonce_guard<> guard;
+        for(uint64_t k{0}; k < 64; ++k) {
+            std::array<uint8_t, 16> a{};
+            for(size_t i{0}; i < a.size(); ++i) {
+                a[i] = static_cast<uint8_t>(k * 131 + i * 7);
+            }
+            REQUIRE_FALSE(guard.insert(0, a.begin(), a.end()));
+
+            auto b = a; // the key id folded into the first nonce byte
+            b[0] ^= 5;
+            REQUIRE_FALSE(guard.contains(5, b.begin(), b.end()));
+
+            const uint64_t w0 = word(a, 0), w1 = word(a, 8), w1_ = ~w1 ^ k;
+            const uint64_t w0_ = w0 ^ mix(w1 + 0x9e3779b97f4a7c15ull) ^ mix(w1_ + 0x9e3779b97f4a7c15ull);
+            auto c = a; // the second word's mix cancelled through the first
+            std::memcpy(c.data(), &w0_, sizeof(w0_));
+            std::memcpy(c.data() + 8, &w1_, sizeof(w1_));
+            REQUIRE_FALSE(guard.contains(0, c.begin(), c.end()));
+        }
+    }
+
+    SECTION("Every byte of a nonce of any length should count") {
+        crypto::nonce_guard<> guard;
+        std::array<uint8_t, 24> a{}, b{};
+        for(size_t n{1}; n <= a.size(); ++n) {
+            for(size_t i{0}; i < n; ++i) {
+                a[i] = static_cast<uint8_t>(n * 31 + i);
+            }
+            REQUIRE_FALSE(guard.insert(0, a.begin(), a.begin() + n));
+            for(size_t i{0}; i < n; ++i) { // the same nonce but for one byte
+                b = a;
+                b[i] ^= 0x01;
+                REQUIRE_FALSE(guard.contains(0, b.begin(), b.begin() + n));
+            }
+            REQUIRE(guard.insert(0, a.begin(), a.begin() + n));
+        }
+    }
+
+}
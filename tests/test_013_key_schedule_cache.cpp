@@ -0,0 +1,108 @@
+#include "catch2.h"
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "../crypto/key_schedule_cache.h"
+
+TEST_CASE("Key schedule cache", "[.key_schedule_cache]") {
+
+    using cipher_t = crypto::block_cipher<crypto::CBC>;
+    using key_t = std::array<uint8_t, 32>;
+
+    auto tenant_key = [](uint64_t id) {
+        key_t key{};
+        for(size_t i{0}; i < key.size(); ++i) {
+            key[i] = static_cast<uint8_t>(id * 31 + i);
+        }
+        return key;
+    };
+
+    auto same = [](cipher_t a, cipher_t b) {
+        std::vector<uint8_t> x(16 + 32, 0x5A), y(x);
+        a.encrypt(x.begin() + 16, x.end());
+        b.encrypt(y.begin() + 16, y.end());
+        return x == y;
+    };
+
+    SECTION("Hits should skip key expansion and return the same schedule") {
+        crypto::key_schedule_cache<cipher_t, 4> cache(64);
+        REQUIRE(!cache.find(7));
+        REQUIRE(same(cache.get(7, tenant_key(7)), cipher_t(tenant_key(7))));
+        REQUIRE(same(cache.get(7, key_t{}), cipher_t(tenant_key(7)))); // cached, the key is not looked at
+        auto hit = cache.find(7);
+        REQUIRE(hit);
+        REQUIRE(same(*hit, cipher_t(tenant_key(7))));
+        REQUIRE(cache.hits() == 2);
+        REQUIRE(cache.misses() == 1);
+        REQUIRE(cache.size() == 1);
+    }
+
+    SECTION("The key should only be fetched on a miss") {
+        crypto::key_schedule_cache<cipher_t, 4> cache(64);
+        size_t fetches{0};
+        auto fetch = [&](uint64_t id) {
+            return [&fetches, &tenant_key, id] {
+                ++fetches;
+                return tenant_key(id);
+            };
+        };
+        REQUIRE(!cache.find(9));
+        REQUIRE(same(cache.get(9, fetch(9)), cipher_t(tenant_key(9))));
+        REQUIRE(same(cache.get(9, fetch(9)), cipher_t(tenant_key(9))));
+        REQUIRE(fetches == 1);
+        REQUIRE(cache.hits() == 1);
+        REQUIRE(cache.misses() == 1);
+    }
+
+    SECTION("The least recently used schedule should be evicted") {
+        crypto::key_schedule_cache<cipher_t, 1> cache(3);
+        for(uint64_t id: {1, 2, 3}) {
+            cache.get(id, tenant_key(id));
+        }
+        cache.find(1); // 2 is now the least recently used
+        cache.get(4, tenant_key(4));
+        REQUIRE(cache.size() == 3);
+        REQUIRE(cache.evictions() == 1);
+        REQUIRE(!cache.find(2));
+        REQUIRE(cache.find(1));
+        REQUIRE(same(*cache.find(4), cipher_t(tenant_key(4))));
+    }
+
+    SECTION("Erase and wipe should evict") {
+        crypto::key_schedule_cache<cipher_t> cache(100);
+        for(uint64_t id{0}; id < 50; ++id) {
+            cache.get(id, tenant_key(id));
+        }
+        REQUIRE(cache.size() == 50);
+        REQUIRE(cache.erase(10));
+        REQUIRE(!cache.erase(10));
+        REQUIRE(!cache.find(10));
+        cache.wipe();
+        REQUIRE(cache.size() == 0);
+        REQUIRE(!cache.find(0));
+    }
+
+    SECTION("Concurrent tenants should get their own schedules") {
+        crypto::key_schedule_cache<cipher_t> cache(256);
+        std::atomic<size_t> wrong{0};
+        std::vector<std::thread> threads;
+        for(int t{0}; t < 4; ++t) {
+            threads.emplace_back([&, t] {
+                for(uint64_t i{0}; i < 2000; ++i) {
+                    const uint64_t id = (i * 7 + static_cast<uint64_t>(t)) % 300; // more tenants than capacity
+                    wrong += !same(cache.get(id, tenant_key(id)), cipher_t(tenant_key(id)));
+                }
+            });
+        }
+        for(auto& t: threads) {
+            t.join();
+        }
+        REQUIRE(wrong == 0);
+        REQUIRE(cache.size() <= cache.capacity());
+        REQUIRE(cache.hits() + cache.misses() == 8000);
+    }
+
+}
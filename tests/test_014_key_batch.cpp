@@ -0,0 +1,89 @@
+#include "catch2.h"
+
+#include <array>
+#include <vector>
+
+#include "../crypto/aes_key_batch.h"
+#include "../crypto/block_cipher_factory.h"
+
+TEST_CASE("Batch key expansion", "[.key_batch]") {
+
+    using namespace crypto::aes;
+
+    std::vector<std::array<uint8_t, 32>> keys(16);
+    for(size_t l{0}; l < keys.size(); ++l) {
+        for(size_t j{0}; j < 32; ++j) {
+            keys[l][j] = static_cast<uint8_t>(l * 37 + j * 11 + 1);
+        }
+    }
+
+    SECTION("The last round keys should match FIPS-197 appendix A") {
+        std::array<uint8_t, 32> fips = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88,
+                                        0x09, 0xcf, 0x4f, 0x3c};
+        key_batch<R128, N128, 4> k128(&fips, &fips + 1);
+        REQUIRE(k128.size() == 1);
+        REQUIRE(k128.round_key(10, 0) == key_batch<>::block_t{0xd0, 0x14, 0xf9, 0xa8, 0xc9, 0xee, 0x25, 0x89,
+                                                               0xe1, 0x3f, 0x0c, 0xc8, 0xb6, 0x63, 0x0c, 0xa6});
+        fips = {0x8e, 0x73, 0xb0, 0xf7, 0xda, 0x0e, 0x64, 0x52, 0xc8, 0x10, 0xf3, 0x2b, 0x80, 0x90, 0x79, 0xe5,
+                0x62, 0xf8, 0xea, 0xd2, 0x52, 0x2c, 0x6b, 0x7b};
+        key_batch<R192, N192, 4> k192(&fips, &fips + 1);
+        REQUIRE(k192.round_key(12, 0) == key_batch<>::block_t{0xe9, 0x8b, 0xa0, 0x6f, 0x44, 0x8c, 0x77, 0x3c,
+                                                               0x8e, 0xcc, 0x72, 0x04, 0x01, 0x00, 0x22, 0x02});
+        fips = {0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+                0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4};
+        key_batch<R256, N256, 4> k256(&fips, &fips + 1);
+        REQUIRE(k256.round_key(14, 0) == key_batch<>::block_t{0xfe, 0x48, 0x90, 0xd1, 0xe6, 0x18, 0x8d, 0x0b,
+                                                               0x04, 0x6d, 0xf3, 0x44, 0x70, 0x6c, 0x63, 0x1e});
+    }
+
+    SECTION("Every lane should match a single key expansion") {
+        key_batch<R256, N256, 16> batch(keys.begin(), keys.end());
+        REQUIRE(batch.size() == 16);
+        size_t mismatches{0};
+        for(size_t l{0}; l < batch.size(); ++l) {
+            std::array<uint8_t, 16> a{}, b{};
+            encrypt<>(keys[l]).block(a.begin());
+            batch.cipher(l).block(b.begin());
+            mismatches += a != b;
+        }
+        REQUIRE(mismatches == 0);
+
+        // a lane as a keyed block cipher, the NIST SP 800-38A AES-128 ECB vector
+        std::array<uint8_t, 16> nist = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88,
+                                        0x09, 0xcf, 0x4f, 0x3c};
+        key_batch<R128, N128, 4> k128(&nist, &nist + 1);
+        crypto::block_cipher<crypto::ECB, encrypt<R128, N128>, decrypt<R128, N128>> ecb(k128.cipher(0));
+        std::vector<uint8_t> data = {0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11,
+                                     0x73, 0x93, 0x17, 0x2a};
+        ecb.encrypt(data.begin(), data.end());
+        REQUIRE(data == std::vector<uint8_t>{0x3a, 0xd7, 0x7b, 0xb4, 0x0d, 0x7a, 0x36, 0x60, 0xa8, 0x9e, 0xca, 0xf3,
+                                             0x24, 0x66, 0xef, 0x97});
+        ecb.decrypt(data.begin(), data.end());
+        REQUIRE(data[0] == 0x6b);
+    }
+
+    SECTION("The portable and AES-NI kernels should agree") {
+        std::array<const uint8_t*, 8> p;
+        for(size_t l{0}; l < p.size(); ++l) {
+            p[l] = keys[l].data();
+        }
+        key_schedule::store_t<R128, 8> a128{}, b128{};
+        key_schedule::store_t<R192, 8> a192{}, b192{};
+        key_schedule::store_t<R256, 8> a256{}, b256{};
+        key_schedule::expand_portable<R128, N128, 8>(p.data(), 7, a128);
+        key_schedule::expand_portable<R192, N192, 8>(p.data(), 7, a192);
+        key_schedule::expand_portable<R256, N256, 8>(p.data(), 7, a256);
+#ifdef AES_CPP17_X86
+        if(crypto::can_aesni()) {
+            key_schedule::expand_aesni<R128, N128, 8>(p.data(), 7, b128);
+            key_schedule::expand_aesni<R192, N192, 8>(p.data(), 7, b192);
+            key_schedule::expand_aesni<R256, N256, 8>(p.data(), 7, b256);
+            REQUIRE(a128 == b128);
+            REQUIRE(a192 == b192);
+            REQUIRE(a256 == b256);
+        }
+#endif
+        REQUIRE(a256[0][7] == key_batch<>::block_t{}); // lanes past _count_ are untouched
+    }
+
+}
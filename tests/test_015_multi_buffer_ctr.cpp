@@ -0,0 +1,125 @@
+#include "catch2.h"
+
+#include <algorithm>
+#include <array>
+#include <type_traits>
+#include <vector>
+
+#include "../crypto/multi_buffer_ctr.h"
+
+namespace {
+
+    template<typename C, typename = void>
+    struct job_binds : std::false_type {};
+
+    template<typename C>
+    struct job_binds<C, std::void_t<decltype(crypto::multi_buffer_ctr<>::job(
+            std::declval<C>(), crypto::multi_buffer_ctr<>::block_t{}, nullptr, 0))>> : std::true_type {};
+
+    // a job keeps a pointer to the round keys, so a temporary cipher would leave it dangling
+    static_assert(job_binds<const crypto::aes::encrypt<>&>::value);
+    static_assert(!job_binds<crypto::aes::encrypt<>>::value);
+
+}
+
+TEST_CASE("Multi-buffer CTR", "[.multi_buffer_ctr]") {
+
+    using engine_t = crypto::multi_buffer_ctr<>;
+    using block_t = engine_t::block_t;
+
+    // 40 tenants, messages of every length from 0 to 3 blocks and a bit
+    const size_t tenants = 40;
+    std::vector<std::array<uint8_t, 32>> keys(tenants);
+    std::vector<block_t> nonces(tenants);
+    std::vector<std::vector<uint8_t>> messages(tenants);
+    for(size_t t{0}; t < tenants; ++t) {
+        for(size_t j{0}; j < 32; ++j) {
+            keys[t][j] = static_cast<uint8_t>(t * 13 + j);
+        }
+        for(size_t j{0}; j < crypto::BLOCK_SIZE; ++j) {
+            nonces[t][j] = static_cast<uint8_t>(t + j * 3);
+        }
+        nonces[t][15] = 0xFE; // the counter carries into the nonce
+        messages[t].resize((t * 7) % 53);
+        for(size_t j{0}; j < messages[t].size(); ++j) {
+            messages[t][j] = static_cast<uint8_t>(t ^ j);
+        }
+    }
+
+    // the keystream one block at a time
+    auto reference = [&](size_t t) {
+        crypto::aes::encrypt<> cipher(keys[t]);
+        std::vector<uint8_t> out(messages[t]);
+        block_t counter = nonces[t];
+        for(size_t i{0}; i < out.size(); i += crypto::BLOCK_SIZE) {
+            block_t stream = counter;
+            cipher.block(stream.begin());
+            for(size_t j{i}; j < std::min(out.size(), i + crypto::BLOCK_SIZE); ++j) {
+                out[j] ^= stream[j - i];
+            }
+            for(size_t k{crypto::BLOCK_SIZE}; k-- > 0;) {
+                if(++counter[k]) break;
+            }
+        }
+        return out;
+    };
+
+    std::vector<crypto::aes::encrypt<>> ciphers;
+    for(auto& key: keys) {
+        ciphers.emplace_back(key);
+    }
+
+    SECTION("Every job should match encrypting its message alone") {
+        auto data = messages;
+        std::vector<engine_t::job_t> jobs;
+        for(size_t t{0}; t < tenants; ++t) {
+            jobs.push_back(engine_t::job(ciphers[t], nonces[t], data[t].data(), data[t].size()));
+        }
+        engine_t::run(jobs.begin(), jobs.end());
+        size_t mismatches{0};
+        for(size_t t{0}; t < tenants; ++t) {
+            mismatches += data[t] != reference(t);
+        }
+        REQUIRE(mismatches == 0);
+
+        engine_t::run_portable(jobs.begin(), jobs.end()); // and back again
+        REQUIRE(data == messages);
+    }
+
+    SECTION("Jobs keyed from a key batch should match") {
+        auto data = messages;
+        std::vector<engine_t::job_t> jobs;
+        std::vector<crypto::aes::key_batch<>> batches;
+        for(size_t t{0}; t < tenants; t += 8) {
+            batches.emplace_back(keys.begin() + t, keys.begin() + std::min(tenants, t + 8));
+        }
+        for(size_t t{0}; t < tenants; ++t) {
+            jobs.push_back(engine_t::job(batches[t / 8], t % 8, nonces[t], data[t].data(), data[t].size()));
+        }
+        crypto::multi_buffer_ctr<crypto::aes::R256, crypto::aes::N256, 4>::run(jobs.begin(), jobs.end());
+        size_t mismatches{0};
+        for(size_t t{0}; t < tenants; ++t) {
+            mismatches += data[t] != reference(t);
+        }
+        REQUIRE(mismatches == 0);
+    }
+
+    SECTION("Jobs built by hand from an unaligned schedule should match") {
+        auto data = messages;
+        const size_t bytes = crypto::aes::R256 * crypto::BLOCK_SIZE;
+        std::vector<uint8_t> schedules(1 + tenants * bytes); // one byte in, so no schedule is 16 byte aligned
+        std::vector<engine_t::job_t> jobs;
+        for(size_t t{0}; t < tenants; ++t) {
+            uint8_t* copy = schedules.data() + 1 + t * bytes;
+            std::copy(ciphers[t].round_keys(), ciphers[t].round_keys() + bytes, copy);
+            jobs.push_back({copy, crypto::BLOCK_SIZE, nonces[t], data[t].data(), data[t].size()});
+        }
+        engine_t::run(jobs.begin(), jobs.end());
+        size_t mismatches{0};
+        for(size_t t{0}; t < tenants; ++t) {
+            mismatches += data[t] != reference(t);
+        }
+        REQUIRE(mismatches == 0);
+    }
+
+}
@@ -0,0 +1,197 @@
+#include "catch2.h"
+
+#include <array>
+#include <deque>
+#include <vector>
+
+#include "../crypto/block_cipher_factory.h"
+
+namespace {
+
+    void good_expand(const uint8_t* key, uint8_t* round_keys) {
+        crypto::kernel::table<crypto::aes::R256, crypto::aes::N256>(crypto::PORTABLE).expand(key, round_keys);
+    }
+
+    template<crypto::aes::ROUNDS R, crypto::aes::KEY_LENGTH N>
+    void require_kernels_agree(crypto::kernel_t kernel) {
+        const auto& reference = crypto::kernel::table<R, N>(crypto::PORTABLE);
+        const auto& candidate = crypto::kernel::table<R, N>(kernel);
+        REQUIRE(candidate.kernel == (crypto::kernel_available(kernel) ? kernel : crypto::PORTABLE));
+
+        std::array<uint8_t, N * crypto::WORD_SIZE> key{};
+        for(size_t i{0}; i < key.size(); ++i) {
+            key[i] = static_cast<uint8_t>(i * 7 + R);
+        }
+        std::array<uint8_t, R * crypto::BLOCK_SIZE> expect{}, actual{};
+        reference.expand(key.data(), expect.data());
+        candidate.expand(key.data(), actual.data());
+        REQUIRE(actual == expect);
+
+        const crypto::aes::encrypt<R, N> encrypt(key);
+        const crypto::aes::decrypt<R, N> decrypt(encrypt);
+        for(size_t blocks: {1, 3, 4, 5, 9}) { // either side of the interleave width
+            std::vector<uint8_t> plain(blocks * crypto::BLOCK_SIZE);
+            for(size_t i{0}; i < plain.size(); ++i) {
+                plain[i] = static_cast<uint8_t>(i ^ blocks);
+            }
+            std::vector<uint8_t> a(plain), b(plain);
+            reference.encrypt(encrypt, a.data(), blocks);
+            candidate.encrypt(encrypt, b.data(), blocks);
+            REQUIRE(b == a);
+            candidate.decrypt(decrypt, b.data(), blocks);
+            REQUIRE(b == plain);
+            a = plain;
+            b = plain;
+            reference.cbc_encrypt(encrypt, key.data(), a.data(), blocks);
+            candidate.cbc_encrypt(encrypt, key.data(), b.data(), blocks);
+            REQUIRE(b == a);
+        }
+        for(size_t size: {0, 1, 16, 17, 63, 64, 65, 100}) { // partial final blocks
+            std::vector<uint8_t> a(size, 0x5A), b(a);
+            std::array<uint8_t, crypto::BLOCK_SIZE> ca{}, cb{};
+            ca.fill(0xFF); // the counter carries across all 128 bits
+            ca[0] = 0x01;
+            cb = ca;
+            reference.ctr(encrypt, ca.data(), a.data(), a.size());
+            candidate.ctr(encrypt, cb.data(), b.data(), b.size());
+            REQUIRE(b == a);
+            REQUIRE(cb == ca);
+        }
+    }
+
+}
+
+TEST_CASE("Kernel dispatch", "[.kernel_dispatch]") {
+
+    const crypto::kernel_t initial = crypto::active_kernel();
+
+    SECTION("every kernel should agree with the portable kernel for every key size") {
+        for(auto kernel: {crypto::PORTABLE, crypto::AESNI}) {
+            require_kernels_agree<crypto::aes::R128, crypto::aes::N128>(kernel);
+            require_kernels_agree<crypto::aes::R192, crypto::aes::N192>(kernel);
+            require_kernels_agree<crypto::aes::R256, crypto::aes::N256>(kernel);
+        }
+    }
+
+    SECTION("the selection should default to the best kernel and refuse one the CPU lacks") {
+        REQUIRE(crypto::kernel_available(crypto::PORTABLE));
+        REQUIRE(crypto::kernel_available(crypto::best_kernel()));
+        REQUIRE(crypto::select_kernel(crypto::PORTABLE));
+        REQUIRE(crypto::active_kernel() == crypto::PORTABLE);
+        REQUIRE(crypto::select_kernel(crypto::AESNI) == crypto::can_aesni());
+        REQUIRE(crypto::active_kernel() == crypto::best_kernel());
+    }
+
+    SECTION("the environment override should name an available kernel or fall back to the best") {
+        REQUIRE(crypto::kernel_from_env(nullptr) == crypto::best_kernel());
+        REQUIRE(crypto::kernel_from_env("") == crypto::best_kernel());
+        REQUIRE(crypto::kernel_from_env("portable") == crypto::PORTABLE);
+        REQUIRE(crypto::kernel_from_env("aesni") == (crypto::can_aesni() ? crypto::AESNI : crypto::PORTABLE));
+        REQUIRE(crypto::kernel_from_env("AESNI") == crypto::best_kernel());
+        REQUIRE(crypto::kernel_from_env("portable ") == crypto::best_kernel());
+        REQUIRE(crypto::kernel_from_env("vaes") == crypto::best_kernel());
+        // a refused kernel is as unavailable as one the CPU lacks
+        const unsigned refusals = crypto::kernel_refusals().load();
+        crypto::kernel_refusals().fetch_or(1u << crypto::AESNI);
+        REQUIRE(crypto::kernel_from_env("aesni") == crypto::PORTABLE);
+        REQUIRE(crypto::kernel_from_env("portable") == crypto::PORTABLE);
+        crypto::kernel_refusals().store(refusals);
+    }
+
+    SECTION("block ciphers should give the same result whichever kernel is selected") {
+        std::array<uint8_t, 32> key{};
+        for(size_t i{0}; i < key.size(); ++i) {
+            key[i] = static_cast<uint8_t>(0xA0 + i);
+        }
+        std::vector<uint8_t> data(16 + 16 * 21);
+        for(size_t i{0}; i < data.size(); ++i) {
+            data[i] = static_cast<uint8_t>(i * 31);
+        }
+        auto run = [&](crypto::kernel_t kernel) {
+            REQUIRE(crypto::select_kernel(kernel));
+            std::vector<std::vector<uint8_t>> out(3, data);
+            crypto::block_cipher<crypto::ECB> ecb(key);
+            ecb.encrypt(out[0].begin() + 16, out[0].end());
+            crypto::block_cipher<crypto::CBC> cbc(key);
+            cbc.encrypt(out[1].begin() + 16, out[1].end());
+            crypto::block_cipher<crypto::CTR> ctr(key);
+            ctr.encrypt(out[2].begin() + 16, out[2].end());
+            // a non-contiguous range takes the block at a time loop, whatever the kernel
+            std::deque<uint8_t> a(data.begin(), data.end()), b(a), c(a);
+            ecb.encrypt(a.begin() + 16, a.end());
+            cbc.encrypt(b.begin() + 16, b.end());
+            ctr.encrypt(c.begin() + 16, c.end());
+            REQUIRE(std::equal(a.begin(), a.end(), out[0].begin()));
+            REQUIRE(std::equal(b.begin(), b.end(), out[1].begin()));
+            REQUIRE(std::equal(c.begin(), c.end(), out[2].begin()));
+            std::vector<uint8_t> check(out[1]);
+            cbc.decrypt(check.begin() + 16, check.end());
+            REQUIRE(check == data);
+            ecb.decrypt(out[0].data() + 16, out[0].data() + out[0].size());
+            REQUIRE(out[0] == data);
+            ecb.encrypt(out[0].begin() + 16, out[0].end());
+            return out;
+        };
+        const auto portable = run(crypto::PORTABLE);
+        if(crypto::can_aesni()) {
+            REQUIRE(run(crypto::AESNI) == portable);
+        }
+    }
+
+    SECTION("the power-on self-test should pass every supported kernel and leave the selection alone") {
+        REQUIRE(crypto::kernel::power_on_self_test());
+        REQUIRE_FALSE(crypto::kernel_refused(crypto::PORTABLE));
+        REQUIRE_FALSE(crypto::kernel_refused(crypto::AESNI));
+        REQUIRE(crypto::active_kernel() == initial);
+        crypto::refuse_kernel(crypto::PORTABLE); // the reference cannot be refused
+        REQUIRE(crypto::kernel_available(crypto::PORTABLE));
+    }
+
+    SECTION("the differential check should catch a kernel that disagrees") {
+        using table_t = crypto::kernel::table_t<crypto::aes::R256, crypto::aes::N256>;
+        const table_t good = crypto::kernel::table<crypto::aes::R256, crypto::aes::N256>(crypto::best_kernel());
+        REQUIRE(crypto::kernel::agrees(good));
+
+        table_t broken = good;
+        broken.expand = [](const uint8_t* key, uint8_t* round_keys) {
+            good_expand(key, round_keys);
+            round_keys[200] ^= 0x01;
+        };
+        REQUIRE_FALSE(crypto::kernel::agrees(broken));
+
+        broken = good;
+        broken.decrypt = [](const table_t::decrypt_t& cipher, uint8_t* data, size_t blocks) {
+            crypto::kernel::table<crypto::aes::R256, crypto::aes::N256>(crypto::PORTABLE).decrypt(cipher, data, blocks);
+            if(blocks == 1) { // only the single block tail is wrong
+                data[0] ^= 0x80;
+            }
+        };
+        REQUIRE_FALSE(crypto::kernel::agrees(broken));
+
+        broken = good;
+        broken.ctr = [](const table_t::encrypt_t& cipher, uint8_t* counter, uint8_t* data, size_t size) {
+            crypto::kernel::table<crypto::aes::R256, crypto::aes::N256>(crypto::PORTABLE).ctr(cipher, counter, data,
+                                                                                              size);
+            counter[15] ^= 0x01; // the keystream is right but the counter is left in the wrong place
+        };
+        REQUIRE_FALSE(crypto::kernel::agrees(broken));
+
+        broken = good;
+        broken.cbc_encrypt = [](const table_t::encrypt_t& cipher, const uint8_t*, uint8_t* data, size_t blocks) {
+            crypto::kernel::table<crypto::aes::R256, crypto::aes::N256>(crypto::PORTABLE).encrypt(cipher, data, blocks);
+        }; // ECB, the chaining is dropped
+        REQUIRE_FALSE(crypto::kernel::agrees(broken));
+    }
+
+    SECTION("the equivalent inverse schedule should be the round keys reversed with InvMixColumns between") {
+        std::array<uint8_t, 16> key = crypto::kernel::NIST_KEY_128;
+        const crypto::aes::decrypt<crypto::aes::R128, crypto::aes::N128> decrypt(key);
+        // FIPS-197 A.1 round keys 10 and 0 are the first and last of the inverse schedule, the rest are checked by AESDEC
+        const std::array<uint8_t, 16> first = {0xd0, 0x14, 0xf9, 0xa8, 0xc9, 0xee, 0x25, 0x89, 0xe1, 0x3f, 0x0c, 0xc8,
+                                               0xb6, 0x63, 0x0c, 0xa6};
+        REQUIRE(std::equal(first.begin(), first.end(), decrypt.inverse_round_keys()));
+        REQUIRE(std::equal(key.begin(), key.end(), decrypt.inverse_round_keys() + 10 * crypto::BLOCK_SIZE));
+    }
+
+    crypto::select_kernel(initial);
+}
@@ -0,0 +1,123 @@
+#include "catch2.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#include "../util/perf_counters.h"
+#include "../util/stopwatch.h"
+
+namespace {
+
+    /**
+     * @brief a loop the optimiser has to keep, about @p n instructions long
+     */
+    uint64_t busy(uint64_t n) {
+        volatile uint64_t x{0};
+        for(uint64_t i{0}; i < n; ++i) {
+            x = x + i;
+        }
+        return x;
+    }
+
+    /**
+     * @brief spin rather than sleep so the descheduled time cannot differ between the clocks being compared
+     */
+    void spin(std::chrono::milliseconds d) {
+        const auto until = std::chrono::steady_clock::now() + d;
+        while(std::chrono::steady_clock::now() < until);
+    }
+
+}
+
+TEST_CASE("Stopwatch", "[.stopwatch]") {
+
+    SECTION("the TSC clock should be calibrated and never run backwards") {
+        if(!util::tsc_clock::available()) {
+            REQUIRE(util::tsc_clock::ticks_per_ns() == 0);
+            return;
+        }
+        REQUIRE(util::tsc_clock::ticks_per_ns() > 0.1);
+        REQUIRE(util::tsc_clock::ticks_per_ns() < 10);
+        auto last = util::tsc_clock::now();
+        for(int i{0}; i < 10'000; ++i) {
+            const auto t = util::tsc_clock::now();
+            REQUIRE(t >= last);
+            last = t;
+        }
+        const uint64_t a = util::tsc_clock::ticks();
+        const uint64_t b = util::tsc_clock::ticks();
+        REQUIRE(b > a);
+    }
+
+    SECTION("the TSC clock should keep time with steady_clock") {
+        util::tsc_clock::now(); // calibrate outside the timed region
+        util::stopwatch<std::chrono::microseconds> steady;
+        util::stopwatch<std::chrono::microseconds, util::tsc_clock> tsc;
+        // the closest of several spins, so one preemption or frequency step between the clock reads cannot fail it
+        double closest{1e9};
+        for(int i{0}; i < 5; ++i) {
+            steady.start();
+            tsc.start();
+            spin(std::chrono::milliseconds(20));
+            tsc.stop();
+            steady.stop();
+            const double error = static_cast<double>(tsc.elapsed() - steady.elapsed()) / steady.elapsed();
+            closest = std::min(closest, error < 0 ? -error : error);
+        }
+        REQUIRE(closest < 0.1);
+    }
+
+    SECTION("a stopwatch should report the cycles it timed whatever its clock") {
+        util::stopwatch<std::chrono::nanoseconds, util::tsc_clock> tsc;
+        tsc.start();
+        busy(100'000);
+        tsc.stop();
+        REQUIRE(tsc.cycles() == Approx(tsc.elapsed() * util::tsc_clock::ticks_per_ns()).epsilon(0.01));
+
+        util::stopwatch<> steady;
+        steady.start();
+        busy(100'000);
+        steady.stop();
+        REQUIRE(steady.cycles() == Approx(steady.elapsed() * util::tsc_clock::ticks_per_ns()).epsilon(0.001));
+    }
+
+    SECTION("the TSC clock should time a region of a few dozen nanoseconds") {
+        if(!util::tsc_clock::available()) {
+            return;
+        }
+        util::stopwatch<util::tsc_clock::duration, util::tsc_clock> tsc;
+        int64_t shortest{INT64_MAX};
+        for(int i{0}; i < 1000; ++i) { // an empty region costs only the fenced reads
+            tsc.start();
+            tsc.stop();
+            shortest = std::min(shortest, tsc.elapsed());
+        }
+        REQUIRE(shortest < 1'000'000); // under a microsecond in picoseconds
+    }
+
+    SECTION("hardware counters should count a region, or report they cannot") {
+        util::perf::counters pmc;
+        const auto sample = pmc.measure([] { busy(1'000'000); });
+        for(auto counter: {util::perf::CYCLES, util::perf::INSTRUCTIONS, util::perf::L1D_MISSES,
+                           util::perf::BRANCH_MISSES}) {
+            if(!pmc.available(counter)) { // no PMU in this VM or container, or perf_event_paranoid forbids it
+                REQUIRE_FALSE(sample.has(counter));
+                REQUIRE(sample[counter] == 0);
+            }
+        }
+        if(sample.has(util::perf::INSTRUCTIONS)) {
+            REQUIRE(sample[util::perf::INSTRUCTIONS] > 1'000'000);
+        }
+        if(sample.has(util::perf::CYCLES)) {
+            REQUIRE(sample[util::perf::CYCLES] > 0);
+            REQUIRE(sample.ipc() >= 0);
+        }
+        // counting starts from zero each time
+        const auto again = pmc.measure([] { busy(1'000); });
+        if(again.has(util::perf::INSTRUCTIONS)) {
+            REQUIRE(again[util::perf::INSTRUCTIONS] < sample[util::perf::INSTRUCTIONS]);
+        }
+    }
+
+}
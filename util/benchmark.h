@@ -0,0 +1,239 @@
+#ifndef AES_CPP17_BENCHMARK_H
+#define AES_CPP17_BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#include "perf_counters.h"
+#include "stopwatch.h"
+
+namespace util {
+
+    namespace bench {
+
+        /**
+         * @brief tell the optimiser the pointee is read and written so a benchmarked loop cannot be elided
+         */
+        inline void do_not_optimize(const void* p) {
+#if defined(__GNUC__)
+            asm volatile("" : : "g"(p) : "memory");
+#elif defined(_MSC_VER)
+            (void)p;
+            _ReadWriteBarrier();
+#else
+            static volatile const void* sink;
+            sink = p;
+#endif
+        }
+
+        /**
+         * @brief read an environment override, @p fallback when it is unset or not a number
+         */
+        inline size_t env_size(const char* name, size_t fallback) {
+            const char* value = std::getenv(name);
+            if(!value || !*value) {
+                return fallback;
+            }
+            char* end{nullptr};
+            const auto n = std::strtoull(value, &end, 10);
+            return (*end == '\0') ? static_cast<size_t>(n) : fallback;
+        }
+
+        /**
+         * @brief pins the calling thread to one CPU, so the scheduler cannot migrate it between samples, and restores
+         * the thread's previous affinity on destruction - later tests, and threads they spawn, inherit the mask
+         * Linux only, elsewhere pinned() is false.
+         */
+        class pin_thread {
+
+        public:
+
+            /**
+             * @param cpu defaults to the CPU the thread is running on now
+             */
+            explicit pin_thread(int cpu = -1) {
+#if defined(__linux__)
+                if(sched_getaffinity(0, sizeof(saved), &saved) != 0) {
+                    return;
+                }
+                if(cpu < 0) {
+                    cpu = sched_getcpu();
+                }
+                if(cpu < 0 || cpu >= CPU_SETSIZE) {
+                    return;
+                }
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                pinned_ = sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+                (void)cpu;
+#endif
+            }
+
+            pin_thread(const pin_thread&) = delete;
+            pin_thread& operator=(const pin_thread&) = delete;
+
+            ~pin_thread() {
+#if defined(__linux__)
+                if(pinned_) {
+                    sched_setaffinity(0, sizeof(saved), &saved);
+                }
+#endif
+            }
+
+            bool pinned() const {
+                return pinned_;
+            }
+
+        private:
+
+            bool pinned_{false};
+#if defined(__linux__)
+            cpu_set_t saved;
+#endif
+
+        };
+
+        /**
+         * @brief summary statistics of the per iteration time of each repetition
+         */
+        struct statistics_t {
+            double min{0};
+            double median{0};
+            double mean{0};
+            double stddev{0};
+        };
+
+        inline statistics_t summarise(std::vector<double> samples) {
+            statistics_t s;
+            if(samples.empty()) {
+                return s;
+            }
+            std::sort(samples.begin(), samples.end());
+            const size_t n = samples.size();
+            s.min = samples.front();
+            s.median = (n % 2) ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+            for(auto x: samples) {
+                s.mean += x;
+            }
+            s.mean /= n;
+            if(n > 1) {
+                for(auto x: samples) {
+                    s.stddev += (x - s.mean) * (x - s.mean);
+                }
+                s.stddev = std::sqrt(s.stddev / (n - 1));
+            }
+            return s;
+        }
+
+        /**
+         * @brief the outcome of one benchmark, times in nanoseconds per iteration
+         * @note counters are from one further repetition and are empty without perf_event_open access
+         */
+        struct result_t {
+            std::string name;
+            size_t bytes{0};
+            size_t iterations{0};
+            std::vector<double> samples;
+            statistics_t ns;
+            perf::sample_t counters;
+
+            double gb_per_s() const {
+                return ns.median > 0 ? bytes / ns.median : 0;
+            }
+
+            /**
+             * @brief time stamp counter (reference) cycles per byte
+             */
+            double cycles_per_byte() const {
+                return bytes ? ns.median * tsc_clock::ticks_per_ns() / bytes : 0;
+            }
+
+            /**
+             * @brief core clock cycles per byte from the hardware counters, 0 if they could not be read
+             */
+            double core_cycles_per_byte() const {
+                return (bytes && counters.has(perf::CYCLES))
+                       ? static_cast<double>(counters[perf::CYCLES]) / (static_cast<double>(bytes) * iterations) : 0;
+            }
+        };
+
+        /**
+         * @brief options shared by every benchmark in a run
+         * + min_time - each repetition runs enough iterations to last at least this long
+         * + repetitions - timed repetitions the statistics are drawn from
+         * + warmups - untimed repetitions first, to fault in the buffer and settle caches, predictors and clocks
+         * + counters - count cycles, instructions, L1D and branch misses over one more repetition
+         */
+        struct options_t {
+            std::chrono::nanoseconds min_time{std::chrono::milliseconds(20)};
+            size_t repetitions{5};
+            size_t warmups{1};
+            bool counters{true};
+        };
+
+        /**
+         * @brief Google Benchmark style harness: the iteration count is grown until a run outlasts the minimum
+         * time, then the warm-up and timed repetitions are made at that count
+         * @tparam F callable taking no arguments, one iteration of the code under test
+         * @param name
+         * @param bytes processed per iteration, for the throughput figures
+         * @param f
+         * @param options
+         * @return result_t
+         */
+        template<typename F>
+        result_t run(std::string name, size_t bytes, F&& f, const options_t& options = {}) {
+            using stopwatch_t = util::stopwatch<std::chrono::nanoseconds, tsc_clock>;
+            stopwatch_t sw;
+            auto time = [&](size_t iterations) {
+                sw.start();
+                for(size_t i{0}; i < iterations; ++i) {
+                    f();
+                }
+                sw.stop();
+                return std::max<int64_t>(sw.elapsed(), 1);
+            };
+
+            const auto min_ns = static_cast<double>(options.min_time.count());
+            size_t iterations{1};
+            for(;;) {
+                const auto elapsed = static_cast<double>(time(iterations));
+                if(elapsed >= min_ns) {
+                    break;
+                }
+                // overshoot a little and grow at most tenfold at a time, as Google Benchmark does
+                const double scale = std::min(10.0, std::max(1.4 * min_ns / elapsed, 2.0));
+                iterations = static_cast<size_t>(std::ceil(iterations * scale));
+            }
+
+            for(size_t i{0}; i < options.warmups; ++i) {
+                time(iterations);
+            }
+            result_t r{std::move(name), bytes, iterations, {}, {}, {}};
+            for(size_t i{0}; i < options.repetitions; ++i) {
+                r.samples.push_back(static_cast<double>(time(iterations)) / iterations);
+            }
+            r.ns = summarise(r.samples);
+            if(options.counters) {
+                perf::counters pmc;
+                r.counters = pmc.measure([&] { time(iterations); });
+            }
+            return r;
+        }
+
+    }
+
+}
+
+#endif //AES_CPP17_BENCHMARK_H
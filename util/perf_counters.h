@@ -0,0 +1,194 @@
+#ifndef AES_CPP17_PERF_COUNTERS_H
+#define AES_CPP17_PERF_COUNTERS_H
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#if defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace util {
+
+    namespace perf {
+
+        /**
+         * @brief the hardware events counted around a region
+         */
+        enum counter_t {
+            CYCLES, INSTRUCTIONS, L1D_MISSES, BRANCH_MISSES, COUNTERS
+        };
+
+        inline const char* counter_name(counter_t counter) {
+            switch(counter) {
+                case CYCLES: return "cycles";
+                case INSTRUCTIONS: return "instructions";
+                case L1D_MISSES: return "l1d_misses";
+                case BRANCH_MISSES: return "branch_misses";
+                default: return "unknown";
+            }
+        }
+
+        /**
+         * @brief counts for one region, scaled up if the kernel multiplexed the counters
+         * @note an event the CPU, hypervisor or perf_event_paranoid would not let us open is marked invalid
+         */
+        struct sample_t {
+
+            std::array<uint64_t, COUNTERS> value{};
+            std::array<bool, COUNTERS> valid{};
+
+            bool has(counter_t counter) const {
+                return valid[counter];
+            }
+
+            uint64_t operator[](counter_t counter) const {
+                return value[counter];
+            }
+
+            /**
+             * @brief instructions per core cycle, 0 unless both were counted
+             */
+            double ipc() const {
+                return (has(CYCLES) && has(INSTRUCTIONS) && value[CYCLES])
+                       ? static_cast<double>(value[INSTRUCTIONS]) / value[CYCLES] : 0;
+            }
+
+        };
+
+        /**
+         * @brief Linux perf_event_open(2) counters for the calling thread, user space only, opened as one group so
+         * they are scheduled onto the PMU together and cover exactly the same instructions
+         * Usage:
+         * @code
+         * util::perf::counters pmc;
+         * auto sample = pmc.measure([&]{ cipher.encrypt(data.begin() + 16, data.end()); });
+         * if(sample.has(util::perf::CYCLES)) std::cout << sample[util::perf::CYCLES] / data.size() << " cycles/byte";
+         * @endcode
+         * @note elsewhere, or where no event can be opened (no PMU passed through to a VM, perf_event_paranoid > 2),
+         * available() is false and every sample is empty: callers fall back to tsc_clock
+         */
+        class counters {
+
+        public:
+
+            counters() {
+#if defined(__linux__)
+                for(size_t i{0}; i < COUNTERS; ++i) {
+                    perf_event_attr attr;
+                    std::memset(&attr, 0, sizeof(attr));
+                    attr.size = sizeof(attr);
+                    attr.type = EVENTS[i].first;
+                    attr.config = EVENTS[i].second;
+                    attr.disabled = (leader < 0); // members follow the leader
+                    attr.exclude_kernel = 1;
+                    attr.exclude_hv = 1;
+                    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+                    const auto fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+                    if(fd < 0) {
+                        continue;
+                    }
+                    if(leader < 0) {
+                        leader = fd;
+                    }
+                    fds[opened] = fd;
+                    order[opened++] = static_cast<counter_t>(i);
+                }
+#endif
+            }
+
+            counters(const counters&) = delete;
+            counters& operator=(const counters&) = delete;
+
+            ~counters() {
+#if defined(__linux__)
+                for(size_t i{0}; i < opened; ++i) {
+                    close(fds[i]);
+                }
+#endif
+            }
+
+            bool available() const {
+                return opened > 0;
+            }
+
+            bool available(counter_t counter) const {
+                for(size_t i{0}; i < opened; ++i) {
+                    if(order[i] == counter) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            void start() {
+#if defined(__linux__)
+                if(available()) {
+                    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+                }
+#endif
+            }
+
+            sample_t stop() {
+                sample_t sample;
+#if defined(__linux__)
+                if(!available()) {
+                    return sample;
+                }
+                ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+                // { nr, time_enabled, time_running, value[nr] }
+                std::array<uint64_t, 3 + COUNTERS> buffer{};
+                const auto got = read(leader, buffer.data(), sizeof(buffer));
+                if(got < static_cast<ssize_t>(3 * sizeof(uint64_t)) || buffer[2] == 0) {
+                    return sample; // never scheduled onto the PMU
+                }
+                const double scale = static_cast<double>(buffer[1]) / buffer[2];
+                for(size_t i{0}; i < buffer[0] && i < opened; ++i) {
+                    sample.value[order[i]] = static_cast<uint64_t>(buffer[3 + i] * scale);
+                    sample.valid[order[i]] = true;
+                }
+#endif
+                return sample;
+            }
+
+            /**
+             * @brief count the events while @p f runs
+             */
+            template<typename F>
+            sample_t measure(F&& f) {
+                start();
+                std::forward<F>(f)();
+                return stop();
+            }
+
+        private:
+
+#if defined(__linux__)
+            static constexpr std::pair<uint32_t, uint64_t> EVENTS[COUNTERS] = {
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8u) |
+                                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16u)},
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}
+            };
+#endif
+
+            int leader{-1};
+            size_t opened{0};
+            std::array<int, COUNTERS> fds{};
+            std::array<counter_t, COUNTERS> order{};
+
+        };
+
+    }
+
+}
+
+#endif //AES_CPP17_PERF_COUNTERS_H
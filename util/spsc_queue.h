@@ -0,0 +1,87 @@
+#ifndef AES_CPP17_SPSC_QUEUE_H
+#define AES_CPP17_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace util {
+
+    /**
+     * @brief bounded lock-free single producer single consumer ring buffer
+     * Exactly one thread may push and exactly one (other) thread may pop, the head and tail indices live on their own
+     * cache lines so that the producer and consumer do not false-share.
+     * @note capacity is rounded up to the next power of 2 so that wrapping is a mask not a modulus
+     * @tparam T trivially copyable payload e.g. a buffer index
+     */
+    template<typename T>
+    class spsc_queue {
+
+        constexpr static size_t CACHE_LINE = 64;
+
+    public:
+
+        using value_type = T;
+
+        explicit spsc_queue(size_t capacity): mask(round_up(capacity) - 1), ring(mask + 1) {}
+
+        spsc_queue(const spsc_queue&) = delete;
+        spsc_queue& operator=(const spsc_queue&) = delete;
+
+        /**
+         * @brief producer side
+         * @param value
+         * @return false if the queue is full
+         */
+        bool try_push(const T& value) {
+            const size_t t = tail.load(std::memory_order_relaxed);
+            if(t - head.load(std::memory_order_acquire) > mask) {
+                return false;
+            }
+            ring[t & mask] = value;
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief consumer side
+         * @param value
+         * @return false if the queue is empty
+         */
+        bool try_pop(T& value) {
+            const size_t h = head.load(std::memory_order_relaxed);
+            if(h == tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            value = ring[h & mask];
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        inline size_t capacity() const {
+            return mask + 1;
+        }
+
+    private:
+
+        static size_t round_up(size_t n) {
+            size_t p{1};
+            while(p < n) {
+                p <<= 1u;
+            }
+            return p;
+        }
+
+        const size_t mask;
+
+        std::vector<T> ring;
+
+        alignas(CACHE_LINE) std::atomic<size_t> head{0};
+
+        alignas(CACHE_LINE) std::atomic<size_t> tail{0};
+
+    };
+
+}
+
+#endif //AES_CPP17_SPSC_QUEUE_H
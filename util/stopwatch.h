@@ -2,13 +2,191 @@
 #define AES_CPP17_STOPWATCH_H
 
 #include <chrono>
+#include <cstdint>
+#include <ratio>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define AES_CPP17_TSC
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#endif
 
 namespace util {
 
+    /**
+     * @brief Chrono clock on the processor time stamp counter, for regions of a few dozen nanoseconds where the call
+     * overhead and granularity of steady_clock swamp the measurement
+     * + RDTSCP waits for every earlier instruction to execute and the LFENCE after it stops later ones starting early,
+     * so nothing leaks into or out of the timed region (LFENCE; RDTSC; LFENCE without RDTSCP)
+     * + ticks are converted with a once per process calibration: the frequency CPUID leaf 0x15 reports if it does,
+     * otherwise measured against steady_clock
+     * + picosecond resolution keeps the conversion from rounding away whole ticks
+     * @note the TSC ticks at the nominal frequency whatever the core clock is doing, for core cycles and IPC
+     * @see perf_counters.h
+     * @note steady_clock stands in where there is no TSC
+     */
+    struct tsc_clock {
+
+        using rep = int64_t;
+        using period = std::pico;
+        using duration = std::chrono::duration<rep, period>;
+        using time_point = std::chrono::time_point<tsc_clock>;
+        static constexpr bool is_steady = true;
+
+        /**
+         * @brief the CPU has a TSC - read with RDTSCP where the CPU has it, else with RDTSC fenced by LFENCE @see ticks
+         */
+        static bool available() {
+            return features().tsc;
+        }
+
+        /**
+         * @brief the TSC rate is constant through frequency changes and deep sleep, so ticks measure wall time
+         */
+        static bool invariant() {
+            return features().invariant;
+        }
+
+        /**
+         * @brief fenced read of the raw time stamp counter, 0 without one
+         */
+        static uint64_t ticks() {
+#if defined(AES_CPP17_TSC)
+            if(features().rdtscp) {
+                unsigned int aux;
+                const uint64_t t = __rdtscp(&aux);
+                _mm_lfence();
+                return t;
+            }
+            if(features().tsc) {
+                _mm_lfence();
+                const uint64_t t = __rdtsc();
+                _mm_lfence();
+                return t;
+            }
+#endif
+            return 0;
+        }
+
+        /**
+         * @brief calibrated TSC frequency in ticks per nanosecond (GHz), 0 without a TSC
+         */
+        static double ticks_per_ns() {
+            return calibration().ticks_per_ns;
+        }
+
+        static time_point now() {
+            const auto& c = calibration();
+            if(c.ticks_per_ns > 0) {
+                return time_point(duration(static_cast<rep>(static_cast<int64_t>(ticks() - c.ticks) * c.ps_per_tick)));
+            }
+            return time_point(std::chrono::duration_cast<duration>(std::chrono::steady_clock::now() - c.steady));
+        }
+
+        /**
+         * @brief the TSC ticks in a duration of any clock
+         */
+        template<typename Rep, typename Period>
+        static double cycles(std::chrono::duration<Rep, Period> d) {
+            return std::chrono::duration<double, std::nano>(d).count() * ticks_per_ns();
+        }
+
+    private:
+
+        struct features_t {
+            bool tsc{false};
+            bool rdtscp{false};
+            bool invariant{false};
+            uint64_t hz{0}; // CPUID leaf 0x15 TSC frequency, when reported
+        };
+
+        struct calibration_t {
+            double ticks_per_ns{0};
+            double ps_per_tick{0};
+            uint64_t ticks{0}; // the epochs, keeping time points small enough for a double to hold every tick
+            std::chrono::steady_clock::time_point steady;
+        };
+
+        /**
+         * @note leaf 1 EDX bit 4 TSC, leaf 0x80000001 EDX bit 27 RDTSCP, leaf 0x80000007 EDX bit 8 invariant TSC,
+         * leaf 0x15 EBX/EAX the TSC/crystal ratio and ECX the crystal frequency
+         */
+        static const features_t& features() {
+            static const features_t features = [] {
+                features_t f;
+#if defined(AES_CPP17_TSC)
+                auto cpuid = [](unsigned int leaf, unsigned int (&r)[4]) {
+#if defined(_MSC_VER)
+                    int regs[4];
+                    __cpuid(regs, static_cast<int>(leaf));
+                    for(int i{0}; i < 4; ++i) r[i] = static_cast<unsigned int>(regs[i]);
+#else
+                    __cpuid(leaf, r[0], r[1], r[2], r[3]);
+#endif
+                };
+                unsigned int r[4]{};
+                cpuid(0, r);
+                const unsigned int max_leaf = r[0];
+                cpuid(1, r);
+                f.tsc = r[3] & (1u << 4u);
+                if(max_leaf >= 0x15) {
+                    cpuid(0x15, r);
+                    if(r[0] && r[1] && r[2]) {
+                        f.hz = static_cast<uint64_t>(r[2]) * r[1] / r[0];
+                    }
+                }
+                cpuid(0x80000000, r);
+                const unsigned int max_extended = r[0];
+                if(max_extended >= 0x80000001) {
+                    cpuid(0x80000001, r);
+                    f.rdtscp = r[3] & (1u << 27u);
+                }
+                if(max_extended >= 0x80000007) {
+                    cpuid(0x80000007, r);
+                    f.invariant = r[3] & (1u << 8u);
+                }
+#endif
+                return f;
+            }();
+            return features;
+        }
+
+        static const calibration_t& calibration() {
+            static const calibration_t calibration = [] {
+                using steady_t = std::chrono::steady_clock;
+                calibration_t c;
+                if(features().tsc) {
+                    if(features().hz) {
+                        c.ticks_per_ns = features().hz / 1e9;
+                    } else {
+                        const auto t0 = steady_t::now();
+                        const uint64_t c0 = ticks();
+                        auto t1 = t0;
+                        while(t1 - t0 < std::chrono::milliseconds(20)) {
+                            t1 = steady_t::now();
+                        }
+                        const uint64_t c1 = ticks();
+                        c.ticks_per_ns = (c1 - c0) / std::chrono::duration<double, std::nano>(t1 - t0).count();
+                    }
+                    c.ps_per_tick = 1000 / c.ticks_per_ns;
+                    c.ticks = ticks();
+                }
+                c.steady = steady_t::now();
+                return c;
+            }();
+            return calibration;
+        }
+
+    };
+
     /**
      * @brief stopwatch iodiom high precision timer for measuring software performance
      * @tparam PolicyT - std::chrono::nanoseconds (default), milliseconds, microseconds, seconds
-     * @tparam PolicyClock - std::chrono::steady_clock (default), system_clock, high_resolution_clock
+     * @tparam PolicyClock - std::chrono::steady_clock (default), system_clock, high_resolution_clock, tsc_clock
      */
     template<typename PolicyT = std::chrono::nanoseconds,
             typename PolicyClock = std::chrono::steady_clock>
@@ -32,6 +210,11 @@ namespace util {
 
         int64_t elapsed();
 
+        /**
+         * @brief the last start to stop interval in time stamp counter ticks, exact with tsc_clock
+         */
+        double cycles();
+
     private:
 
         time_point_t before;
@@ -49,6 +232,11 @@ namespace util {
         return diff(before, after);
     }
 
+    template<typename PolicyT, typename PolicyClock>
+    double stopwatch<PolicyT, PolicyClock>::cycles() {
+        return tsc_clock::cycles(after - before);
+    }
+
     template<typename PolicyT, typename PolicyClock>
     typename stopwatch<PolicyT, PolicyClock>::time_point_t stopwatch<PolicyT, PolicyClock>::stop() {
         after = clock_t::now();
@@ -0,0 +1,90 @@
+#ifndef AES_CPP17_THREAD_POOL_H
+#define AES_CPP17_THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+    /**
+     * @brief fixed size worker pool executing posted tasks in FIFO order
+     * Minimal executor for offloading cipher work: anything with a ```post(F&&)``` member will do in its place
+     * (an asio strand, a reactor's own queue etc.)
+     * @note the destructor finishes every task already posted before joining the workers
+     */
+    class thread_pool {
+
+    public:
+
+        explicit thread_pool(unsigned threads = std::thread::hardware_concurrency()) {
+            threads = std::max(threads, 1u);
+            for(unsigned i{0}; i < threads; ++i) {
+                workers.emplace_back([this] { run(); });
+            }
+        }
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        ~thread_pool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            ready.notify_all();
+            for(auto& w: workers) {
+                w.join();
+            }
+        }
+
+        template<typename F>
+        void post(F&& task) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                tasks.emplace_back(std::forward<F>(task));
+            }
+            ready.notify_one();
+        }
+
+        inline size_t size() const {
+            return workers.size();
+        }
+
+    private:
+
+        void run() {
+            for(;;) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+                    if(tasks.empty()) {
+                        return;
+                    }
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+        std::mutex mutex;
+
+        std::condition_variable ready;
+
+        std::deque<std::function<void()>> tasks;
+
+        bool stopping{false};
+
+        std::vector<std::thread> workers;
+
+    };
+
+}
+
+#endif //AES_CPP17_THREAD_POOL_H
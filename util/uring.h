@@ -0,0 +1,199 @@
+#ifndef AES_CPP17_URING_H
+#define AES_CPP17_URING_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define AES_CPP17_HAS_IO_URING
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+// <linux/io_uring.h> drags in <linux/fs.h> whose BLOCK_SIZE (1024) macro would clobber crypto::BLOCK_SIZE
+#undef BLOCK_SIZE
+#undef BLOCK_SIZE_BITS
+#endif
+
+namespace util {
+
+#ifdef AES_CPP17_HAS_IO_URING
+
+    /**
+     * @brief minimal raw syscall io_uring (no liburing dependency)
+     * Just enough of the submission/completion ring protocol for fixed (registered) buffer reads and writes.
+     * @note io_uring is frequently disabled inside containers (seccomp) or by sysctl so construction never throws,
+     * test ok() and fall back to plain pread/pwrite if it is false.
+     */
+    class uring {
+
+    public:
+
+        explicit uring(unsigned entries) {
+            io_uring_params p{};
+            fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+            if(fd < 0) {
+                return;
+            }
+            sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+            cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+            if(p.features & IORING_FEAT_SINGLE_MMAP) {
+                sq_size = cq_size = std::max(sq_size, cq_size);
+            }
+            sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+            if(sq_ptr == MAP_FAILED) {
+                sq_ptr = nullptr;
+                close();
+                return;
+            }
+            if(p.features & IORING_FEAT_SINGLE_MMAP) {
+                cq_ptr = sq_ptr;
+            } else {
+                cq_ptr = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+                if(cq_ptr == MAP_FAILED) {
+                    cq_ptr = nullptr;
+                    close();
+                    return;
+                }
+            }
+            sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+            void* s = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+            if(s == MAP_FAILED) {
+                close();
+                return;
+            }
+            sqes = static_cast<io_uring_sqe*>(s);
+            auto sq = static_cast<char*>(sq_ptr);
+            sq_head = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+            sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+            sq_mask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+            sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+            auto cq = static_cast<char*>(cq_ptr);
+            cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+            cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+            cq_mask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+            sq_entries = p.sq_entries;
+        }
+
+        uring(const uring&) = delete;
+        uring& operator=(const uring&) = delete;
+
+        ~uring() {
+            close();
+        }
+
+        inline bool ok() const {
+            return sqes != nullptr;
+        }
+
+        /**
+         * @brief pin the buffers with the kernel so that fixed reads & writes skip the per I/O page mapping
+         * @return false if the kernel refused (e.g. RLIMIT_MEMLOCK)
+         */
+        bool register_buffers(const iovec* iov, unsigned n) {
+            return syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iov, n) == 0;
+        }
+
+        /**
+         * @brief queue a fixed buffer read or write (submitted by the next call to submit)
+         * @param op IORING_OP_READ_FIXED or IORING_OP_WRITE_FIXED
+         */
+        void prepare(uint8_t op, int file, void* buf, unsigned len, uint64_t offset, unsigned buf_index,
+                     uint64_t user_data) {
+            const unsigned tail = *sq_tail;
+            const unsigned i = tail & sq_mask;
+            io_uring_sqe& sqe = sqes[i];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = op;
+            sqe.fd = file;
+            sqe.addr = reinterpret_cast<uint64_t>(buf);
+            sqe.len = len;
+            sqe.off = offset;
+            sqe.buf_index = static_cast<uint16_t>(buf_index);
+            sqe.user_data = user_data;
+            sq_array[i] = i;
+            __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+            ++pending;
+        }
+
+        /**
+         * @brief submit everything prepared and block until at least _wait_ completions are available
+         * @return false on error (errno set)
+         */
+        bool submit(unsigned wait) {
+            for(;;) {
+                long r = syscall(__NR_io_uring_enter, fd, pending, wait, wait ? IORING_ENTER_GETEVENTS : 0u,
+                                 nullptr, 0);
+                if(r >= 0) {
+                    pending -= static_cast<unsigned>(r);
+                    return true;
+                }
+                if(errno != EINTR) {
+                    return false;
+                }
+            }
+        }
+
+        /**
+         * @brief pop the next completion, if any
+         * @return false if the completion queue is empty
+         */
+        bool next(uint64_t& user_data, int& res) {
+            const unsigned head = *cq_head;
+            if(head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+                return false;
+            }
+            const io_uring_cqe& cqe = cqes[head & cq_mask];
+            user_data = cqe.user_data;
+            res = cqe.res;
+            __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+
+        inline unsigned entries() const {
+            return sq_entries;
+        }
+
+    private:
+
+        void close() {
+            if(sqes) munmap(sqes, sqes_size);
+            if(cq_ptr && cq_ptr != sq_ptr) munmap(cq_ptr, cq_size);
+            if(sq_ptr) munmap(sq_ptr, sq_size);
+            if(fd >= 0) ::close(fd);
+            sqes = nullptr;
+            sq_ptr = cq_ptr = nullptr;
+            fd = -1;
+        }
+
+        int fd{-1};
+        unsigned pending{0};
+        unsigned sq_entries{0};
+
+        void* sq_ptr{nullptr};
+        void* cq_ptr{nullptr};
+        size_t sq_size{0}, cq_size{0}, sqes_size{0};
+
+        io_uring_sqe* sqes{nullptr};
+        unsigned* sq_head{nullptr};
+        unsigned* sq_tail{nullptr};
+        unsigned* sq_array{nullptr};
+        unsigned sq_mask{0};
+
+        io_uring_cqe* cqes{nullptr};
+        unsigned* cq_head{nullptr};
+        unsigned* cq_tail{nullptr};
+        unsigned cq_mask{0};
+
+    };
+
+#endif
+
+}
+
+#endif //AES_CPP17_URING_H